@@ -29,6 +29,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "benchmark.h"
+#include <limits.h>
 
 #define T_BUFSIZE (1024*1024/4)
 #define T_N (200)
@@ -112,5 +113,268 @@ int csdr_benchmark()
 	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
 	fprintf(stderr,"shift_unroll_cc done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
 
+	//fmdemod_quadri_cf
+	float* outbuf_f = (float*)outbuf_c;
+	complexf last_sample = { .i = 0, .q = 0 };
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) last_sample = fmdemod_quadri_cf(buf_c, outbuf_f, T_BUFSIZE, NULL, last_sample);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"fmdemod_quadri_cf done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	//fmdemod_quadri_novect_cf
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) last_sample = fmdemod_quadri_novect_cf(buf_c, outbuf_f, T_BUFSIZE, last_sample);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"fmdemod_quadri_novect_cf done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	//fmdemod_atan_cf vs. fmdemod_atan_fast_cf
+	float max_atan2_error = 0;
+	for(int i=0;i<T_BUFSIZE;i++)
+	{
+		float error = fabs(fast_atan2f(qof(buf_c,i), iof(buf_c,i)) - atan2(qof(buf_c,i), iof(buf_c,i)));
+		if(error>max_atan2_error) max_atan2_error=error;
+	}
+	float* outbuf_f_ref = (float*)malloc(sizeof(float)*T_BUFSIZE);
+	fmdemod_atan_cf(buf_c, outbuf_f_ref, T_BUFSIZE, 0);
+	last_sample.i = last_sample.q = 0;
+	fmdemod_atan_fast_cf(buf_c, outbuf_f, T_BUFSIZE, last_sample);
+	float max_demod_error = 0;
+	for(int i=1;i<T_BUFSIZE;i++) //the first sample depends on the initial state, which is different for the two
+	{
+		//the phase is undefined for a zero sample, and the two may differ in that
+		if((!iof(buf_c,i)&&!qof(buf_c,i))||(!iof(buf_c,i-1)&&!qof(buf_c,i-1))) continue;
+		float error = fabs(outbuf_f[i] - outbuf_f_ref[i]);
+		if(error>1) error = 2-error; //+1 and -1 are the same phase
+		if(error>max_demod_error) max_demod_error=error;
+	}
+	free(outbuf_f_ref);
+
+	float last_phase = 0;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) last_phase = fmdemod_atan_cf(buf_c, outbuf_f, T_BUFSIZE, last_phase);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	float time_atan = TIME_TAKEN(start_time,end_time);
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) last_sample = fmdemod_atan_fast_cf(buf_c, outbuf_f, T_BUFSIZE, last_sample);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	float time_atan_fast = TIME_TAKEN(start_time,end_time);
+
+	fprintf(stderr,"\n%-22s %12s %24s\n", "demodulator", "time [s]", "max. error");
+	fprintf(stderr,"%-22s %12g %24s\n", "fmdemod_atan_cf", time_atan, "(reference)");
+	fprintf(stderr,"%-22s %12g %13g (output)\n", "fmdemod_atan_fast_cf", time_atan_fast, max_demod_error);
+	fprintf(stderr,"%-22s %12s %13g (rad)\n", "fast_atan2f", "", max_atan2_error);
+
+	//amdemod_cf
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) amdemod_cf(buf_c, outbuf_f, T_BUFSIZE);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"\namdemod_cf done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	//amdemod_estimator_cf
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) amdemod_estimator_cf(buf_c, outbuf_f, T_BUFSIZE, 0, 0);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"amdemod_estimator_cf done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	//samdemod_cf (it runs at audio rate, and the PLL can't be vectorized, so we process less samples)
+	samdemod_t sam = samdemod_init(SAMDEMOD_USB, 0.001, 0.02, T_BUFSIZE);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N/10;i++) samdemod_cf(buf_c, outbuf_f, T_BUFSIZE, &sam);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"samdemod_cf (usb) done in %g seconds on %d samples.\n",TIME_TAKEN(start_time,end_time),T_BUFSIZE*(T_N/10));
+
+	//deemphasis_wfm_ff, dcblock_ff
+	float* iir_input = (float*)buf_c;
+	float last_output = 0;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) last_output = deemphasis_wfm_ff(iir_input, outbuf_f, T_BUFSIZE, 50e-6, 48000, last_output);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"\ndeemphasis_wfm_ff done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	dcblock_preserve_t dcblock_preserve = { 0, 0 };
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) dcblock_preserve = dcblock_ff(iir_input, outbuf_f, T_BUFSIZE, 0, dcblock_preserve);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"dcblock_ff done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	//sos_filter_ff, sos_filter_cc (8th order Butterworth lowpass, 4 sections)
+	biquad_t sos_sections[4];
+	iirdes_butterworth(sos_sections, 8, IIR_LOWPASS, 0.1, 0);
+	sos_filter_t sos_f = sos_filter_init(sos_sections, 4, 1);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) sos_filter_ff(&sos_f, iir_input, outbuf_f, T_BUFSIZE);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"sos_filter_ff done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	sos_filter_t sos_c = sos_filter_init(sos_sections, 4, 2);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) sos_filter_cc(&sos_c, buf_c, outbuf_c, T_BUFSIZE);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"sos_filter_cc done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	//fastagc_ff, fastagc_cc
+	fastagc_ff_t fastagc_f = fastagc_init(1024, 3, 1.0, 1);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) for(int j=0;j<T_BUFSIZE/1024;j++)
+	{
+		memcpy(fastagc_f.buffer_input, ((float*)buf_c)+j*1024, sizeof(float)*1024);
+		fastagc_ff(&fastagc_f, outbuf_f+j*1024);
+	}
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"\nfastagc_ff done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+	fastagc_free(&fastagc_f);
+
+	fastagc_ff_t fastagc_c = fastagc_init(1024, 3, 1.0, 2);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) for(int j=0;j<T_BUFSIZE/1024;j++)
+	{
+		memcpy(fastagc_c.buffer_input, buf_c+j*1024, sizeof(complexf)*1024);
+		fastagc_cc(&fastagc_c, outbuf_c+j*1024);
+	}
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"fastagc_cc done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+	fastagc_free(&fastagc_c);
+
+	//convert_*: the vectorized versions vs. the *_novect reference versions.
+	//The float input is in -1.5...1.5, so that the clipping is checked, too.
+	float* conv_f = (float*)malloc(sizeof(float)*T_BUFSIZE);
+	unsigned char* conv_int = (unsigned char*)malloc(sizeof(int)*T_BUFSIZE);
+	unsigned char* conv_out = (unsigned char*)malloc(sizeof(int)*T_BUFSIZE);
+	unsigned char* conv_ref = (unsigned char*)malloc(sizeof(int)*T_BUFSIZE);
+	for(int i=0;i<T_BUFSIZE;i++) conv_f[i] = (buf_u8[i]-127.5)/85.0+buf_u8[(i*7)%T_BUFSIZE]/(255.0*85.0);
+	for(int i=0;i<4*T_BUFSIZE;i++) conv_int[i] = buf_u8[i%T_BUFSIZE]^(i>>3);
+	conv_f[0] = 1; conv_f[1] = -1; conv_f[2] = 0;
+	fprintf(stderr,"\n%-16s %12s %12s %24s\n", "conversion", "time [s]", "novect [s]", "difference");
+#define T_CONVERSION(name, call, call_novect, output_bytes, float_output) \
+	{ \
+		clock_gettime(CLOCK_MONOTONIC_RAW, &start_time); \
+		for(int i=0;i<T_N;i++) call; \
+		clock_gettime(CLOCK_MONOTONIC_RAW, &end_time); \
+		double time_vect = TIME_TAKEN(start_time,end_time); \
+		clock_gettime(CLOCK_MONOTONIC_RAW, &start_time); \
+		for(int i=0;i<T_N;i++) call_novect; \
+		clock_gettime(CLOCK_MONOTONIC_RAW, &end_time); \
+		double difference = 0; \
+		if(float_output) for(int i=0;i<T_BUFSIZE;i++) difference = MAX_M(difference, fabs(((float*)conv_out)[i]-((float*)conv_ref)[i])); \
+		else for(int i=0;i<(output_bytes);i++) difference += conv_out[i]!=conv_ref[i]; \
+		fprintf(stderr,"%-16s %12g %12g %13g %s\n", name, time_vect, TIME_TAKEN(start_time,end_time), difference, (float_output)?"(max. abs.)":"(bytes)"); \
+	}
+	T_CONVERSION("convert_u8_f", convert_u8_f(conv_int, (float*)conv_out, T_BUFSIZE), convert_u8_f_novect(conv_int, (float*)conv_ref, T_BUFSIZE), 0, 1);
+	T_CONVERSION("convert_f_u8", convert_f_u8(conv_f, conv_out, T_BUFSIZE), convert_f_u8_novect(conv_f, conv_ref, T_BUFSIZE), T_BUFSIZE, 0);
+	T_CONVERSION("convert_s8_f", convert_s8_f((signed char*)conv_int, (float*)conv_out, T_BUFSIZE), convert_s8_f_novect((signed char*)conv_int, (float*)conv_ref, T_BUFSIZE), 0, 1);
+	T_CONVERSION("convert_f_s8", convert_f_s8(conv_f, (signed char*)conv_out, T_BUFSIZE), convert_f_s8_novect(conv_f, (signed char*)conv_ref, T_BUFSIZE), T_BUFSIZE, 0);
+	T_CONVERSION("convert_s16_f", convert_s16_f((short*)conv_int, (float*)conv_out, T_BUFSIZE), convert_s16_f_novect((short*)conv_int, (float*)conv_ref, T_BUFSIZE), 0, 1);
+	T_CONVERSION("convert_f_s16", convert_f_s16(conv_f, (short*)conv_out, T_BUFSIZE), convert_f_s16_novect(conv_f, (short*)conv_ref, T_BUFSIZE), 2*T_BUFSIZE, 0);
+	T_CONVERSION("convert_s24_f", convert_s24_f(conv_int, (float*)conv_out, T_BUFSIZE, 0), convert_s24_f_novect(conv_int, (float*)conv_ref, T_BUFSIZE, 0), 0, 1);
+	T_CONVERSION("convert_f_s24", convert_f_s24(conv_f, conv_out, T_BUFSIZE, 0), convert_f_s24_novect(conv_f, conv_ref, T_BUFSIZE, 0), 3*T_BUFSIZE, 0);
+	T_CONVERSION("convert_s24_f LE", convert_s24_f(conv_int, (float*)conv_out, T_BUFSIZE, 1), convert_s24_f_novect(conv_int, (float*)conv_ref, T_BUFSIZE, 1), 0, 1);
+	T_CONVERSION("convert_f_s24 LE", convert_f_s24(conv_f, conv_out, T_BUFSIZE, 1), convert_f_s24_novect(conv_f, conv_ref, T_BUFSIZE, 1), 3*T_BUFSIZE, 0);
+	T_CONVERSION("convert_s32_f", convert_s32_f((int*)conv_int, (float*)conv_out, T_BUFSIZE), convert_s32_f_novect((int*)conv_int, (float*)conv_ref, T_BUFSIZE), 0, 1);
+	T_CONVERSION("convert_f_s32", convert_f_s32(conv_f, (int*)conv_out, T_BUFSIZE), convert_f_s32_novect(conv_f, (int*)conv_ref, T_BUFSIZE), 4*T_BUFSIZE, 0);
+#undef T_CONVERSION
+
+	unsigned int dither_index = 0;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) dither_index = dither_tpdf_ff(conv_f, (float*)conv_out, T_BUFSIZE, 1.0f/SHRT_MAX, dither_index);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"dither_tpdf_ff done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	//psk31_varicode_decoder_u8_u8, rtty_baudot_decoder_u8_u8 (on random bits)
+	unsigned char* bits_u8 = buf_u8+T_BUFSIZE;
+	for(int i=0;i<T_BUFSIZE;i++) bits_u8[i] = buf_u8[i]&1;
+	unsigned long long varicode_status = 0;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) psk31_varicode_decoder_u8_u8(&varicode_status, bits_u8, (char*)outbuf_c, T_BUFSIZE);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"\npsk31_varicode_decoder_u8_u8 done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	rtty_baudot_decoder_t baudot_status = { 0 };
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) rtty_baudot_decoder_u8_u8(&baudot_status, bits_u8, (char*)outbuf_c, T_BUFSIZE);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"rtty_baudot_decoder_u8_u8 done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	//convert_u8_f | shift_addfast_cc | fir_decimate_cc vs. frontend_u8_cc
+	complexf* fe_temp = (complexf*)malloc(sizeof(complexf)*T_BUFSIZE);
+	fir_decimate_t fe_decimator = fir_decimate_init(T_DECFACT, 0.05, WINDOW_DEFAULT);
+	starting_phase = 0;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++)
+	{
+		convert_u8_f(buf_u8, (float*)fe_temp, 2*T_BUFSIZE);
+		starting_phase = shift_addfast_cc(fe_temp, fe_temp, T_BUFSIZE, &data_addfast, starting_phase);
+		fir_decimate_cc(fe_temp, outbuf_c, T_BUFSIZE, &fe_decimator);
+	}
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"\nconvert_u8_f + shift_addfast_cc + fir_decimate_cc done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	frontend_t frontend = frontend_init(0.1, T_DECFACT, 0.05, WINDOW_DEFAULT);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) frontend_u8_cc(&frontend, buf_u8, outbuf_c, T_BUFSIZE);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"frontend_u8_cc done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	//encode_sbadpcm_s16_u8, decode_sbadpcm_u8_s16
+	sbadpcm_t sbadpcm_encoder = sbadpcm_init(5, 2, T_BUFSIZE), sbadpcm_decoder = sbadpcm_init(5, 2, T_BUFSIZE);
+	convert_f_s16((float*)buf_c, (short*)fe_temp, T_BUFSIZE);
+	int sbadpcm_bytes = 0;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) sbadpcm_bytes = sbadpcm_encode_s16_u8(&sbadpcm_encoder, (short*)fe_temp, (unsigned char*)outbuf_c, T_BUFSIZE);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"\nencode_sbadpcm_s16_u8 (5+2 bits) done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) sbadpcm_decode_u8_s16(&sbadpcm_decoder, (unsigned char*)outbuf_c, (short*)fe_temp, sbadpcm_bytes);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"decode_sbadpcm_u8_s16 (5+2 bits) done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+#ifdef USE_IMA_ADPCM
+	//encode_ima_adpcm_i16_u8 on many streams vs. encode_ima_adpcm_i16_u8_batch
+	int adpcm_streams = 2*IMA_ADPCM_BATCH_LANES;
+	int adpcm_length = T_BUFSIZE/adpcm_streams;
+	short* adpcm_input[2*IMA_ADPCM_BATCH_LANES];
+	unsigned char* adpcm_output[2*IMA_ADPCM_BATCH_LANES];
+	ima_adpcm_state_t adpcm_states[2*IMA_ADPCM_BATCH_LANES] = { 0 };
+	convert_f_s16((float*)buf_c, (short*)fe_temp, T_BUFSIZE); //the random samples are in [0, 2)
+	for(int j=0;j<adpcm_streams;j++)
+	{
+		adpcm_input[j] = (short*)fe_temp + j*adpcm_length;
+		adpcm_output[j] = (unsigned char*)outbuf_c + j*adpcm_length;
+	}
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++)
+		for(int j=0;j<adpcm_streams;j++)
+			adpcm_states[j] = encode_ima_adpcm_i16_u8(adpcm_input[j], adpcm_output[j], adpcm_length, adpcm_states[j]);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"\nencode_ima_adpcm_i16_u8 (%d streams) done in %g seconds.\n",adpcm_streams,TIME_TAKEN(start_time,end_time));
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) encode_ima_adpcm_i16_u8_batch(adpcm_input, adpcm_output, adpcm_length, adpcm_states, adpcm_streams);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"encode_ima_adpcm_i16_u8_batch (%d streams) done in %g seconds.\n",adpcm_streams,TIME_TAKEN(start_time,end_time));
+#endif
+
+#ifdef LIBCSDR_GPL
+
+	//agc_ff vs. agc_block_ff
+	agc_params agc_p = { 0.8, 0.1, 0.001, 65536, 200, 0, 1.5 };
+	agc_state agc_s = { 1, 0, 0, 0, 0 };
+	float* agc_input = (float*)buf_c;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) agc_ff(agc_input, outbuf_f, T_BUFSIZE, &agc_p, &agc_s);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"\nagc_ff done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+	agc_block_state* agc_b = agc_block_init(&agc_p, 32, 240);
+	agc_s.last_gain = 1;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
+	for(int i=0;i<T_N;i++) agc_block_ff(agc_input, outbuf_f, T_BUFSIZE, &agc_p, &agc_s, agc_b);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end_time);
+	fprintf(stderr,"agc_block_ff (block size = 32, lookahead = 240) done in %g seconds.\n",TIME_TAKEN(start_time,end_time));
+
+#endif
+
 
 }
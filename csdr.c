@@ -45,6 +45,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sys/select.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <time.h>
 #include <stdarg.h>
@@ -58,11 +59,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifdef LIBCSDR_GPL
 #include "fastddc.h"
 #endif
+#include "telemetry.h"
 #include <assert.h>
 #include "benchmark.h"
+#include "csdr_io.h"
 #include <getopt.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <pthread.h>
 
 char usage[]=
 "csdr - a simple commandline tool for Software Defined Radio receiver DSP.\n\n"
@@ -70,13 +74,15 @@ char usage[]=
 "    csdr function_name <function_param1> <function_param2> [optional_param] ...\n\n"
 "list of functions:\n\n"
 "    convert_u8_f\n"
-"    convert_f_u8\n"
+"    convert_f_u8 [--dither]\n"
 "    convert_s8_f\n"
-"    convert_f_s8\n"
-"    convert_f_s16\n"
+"    convert_f_s8 [--dither]\n"
+"    convert_f_s16 [--dither]\n"
 "    convert_s16_f\n"
-"    convert_f_s24 [--bigendian]\n"
+"    convert_f_s24 [--bigendian] [--dither]\n"
 "    convert_s24_f [--bigendian]\n"
+"    convert_f_s32\n"
+"    convert_s32_f\n"
 "    realpart_cf\n"
 "    clipdetect_ff\n"
 "    limit_ff [max_amplitude]\n"
@@ -100,19 +106,29 @@ char usage[]=
 "    dcblock_ff\n"
 "    fastdcblock_ff\n"
 "    fmdemod_atan_cf\n"
+"    fmdemod_atan_fast_cf\n"
 "    fmdemod_quadri_cf\n"
 "    fmdemod_quadri_novect_cf\n"
 "    deemphasis_wfm_ff <sample_rate> <tau>\n"
 "    deemphasis_nfm_ff <one_of_the_predefined_sample_rates>\n"
+"    wfm_stereo_cf <input_rate> <output_rate> [tau]\n"
 "    amdemod_cf\n"
 "    amdemod_estimator_cf\n"
+"    samdemod_cf [dsb|usb|lsb [pll_bandwidth [transition_bw]]]\n"
 "    fir_decimate_cc <decimation_factor> [transition_bw [window]]\n"
+"    frontend_u8_cc <shift_rate> <decimation_factor> [transition_bw [window]] [--fifo <fifo_file>]\n"
+"    frontend_s16_cc <shift_rate> <decimation_factor> [transition_bw [window]] [--fifo <fifo_file>]\n"
 "    fir_interpolate_cc <interpolation_factor> [transition_bw [window]]\n"
 "    firdes_lowpass_f <cutoff_rate> <length> [window [--octave]]\n"
 "    firdes_bandpass_c <low_cut> <high_cut> <length> [window [--octave]]\n"
-"    agc_ff [--profile (slow|fast)] [--hangtime t] [--reference r] [--attack a] [--decay d] [--max m] [--initial i] [--attackwait w] [--alpha l]\n"
-"    agc_s16 [--profile (slow|fast)] [--hangtime t] [--reference r] [--attack a] [--decay d] [--max m] [--initial i] [--attackwait w] [--alpha l]\n"
-"    fastagc_ff [block_size [reference]]\n"
+"    iir_filter_ff (butterworth|chebyshev <ripple_db>) (lowpass|highpass|bandpass|bandstop) <order> <cutoff_rate> [high_cut]\n"
+"    iir_filter_ff notch <rate> <bandwidth>\n"
+"    iir_filter_cc (butterworth|chebyshev <ripple_db>) (lowpass|highpass|bandpass|bandstop) <order> <cutoff_rate> [high_cut]\n"
+"    iir_filter_cc notch <rate> <bandwidth>\n"
+"    agc_ff [--profile (slow|fast)] [--hangtime t] [--reference r] [--attack a] [--decay d] [--max m] [--initial i] [--attackwait w] [--alpha l] [--block b [--lookahead k]]\n"
+"    agc_s16 [--profile (slow|fast)] [--hangtime t] [--reference r] [--attack a] [--decay d] [--max m] [--initial i] [--attackwait w] [--alpha l] [--block b [--lookahead k]]\n"
+"    fastagc_ff [block_size [reference [num_blocks]]]\n"
+"    fastagc_cc [block_size [reference [num_blocks]]]\n"
 "    rational_resampler_ff <interpolation> <decimation> [transition_bw [window]]\n"
 "    fractional_decimator_ff <decimation_rate> [num_poly_points ( [transition_bw [window]] | --prefilter )]\n"
 "    fractional_decimator_cc <decimation_rate> [num_poly_points ( [transition_bw [window]] | --prefilter )]\n"
@@ -126,7 +142,11 @@ char usage[]=
 "    encode_ima_adpcm_s16_u8\n"
 "    decode_ima_adpcm_u8_s16\n"
 #endif
+"    encode_sbadpcm_s16_u8 [low_bits [high_bits]]\n"
+"    decode_sbadpcm_u8_s16 [low_bits [high_bits]]\n"
 "    compress_fft_adpcm_f_u8 <fft_size>\n"
+"    compress_fft_delta_f_u8 <fft_size> [step_db [keyframe_interval]]\n"
+"    decompress_fft_delta_u8_f <fft_size>\n"
 "    flowcontrol <data_rate> <reads_per_second>\n"
 "    through\n"
 "    dsb_fc [q_value]\n"
@@ -135,18 +155,22 @@ char usage[]=
 "    fixed_amplitude_cc <new_amplitude>\n"
 "    mono2stereo_s16\n"
 "    stereo2mono_s16\n"
-"    setbuf <buffer_size>\n"
+"    setbuf <buffer_size> [sample_format [sample_rate [center_frequency]]]\n"
 "    fft_exchange_sides_ff <fft_size>\n"
-"    squelch_and_smeter_cc --fifo <squelch_fifo> --outfifo <smeter_fifo> <use_every_nth> <report_every_nth>\n"
+"    squelch_and_smeter_cc --fifo <squelch_fifo> (--outfifo <smeter_fifo> | --telemetry <shm_file>) <use_every_nth> <report_every_nth> [--hysteresis <db>] [--tail <blocks>] [--closed (zeros|flush|none)] [--telemetry-records <n>]\n"
+"    telemetry_dump <shm_file>\n"
+"    tone_squelch_ff <sample_rate> ctcss <tone_frequency> [threshold]\n"
+"    tone_squelch_ff <sample_rate> dcs <octal_code> [n|i]\n"
 "    fifo <buffer_size> <number_of_buffers>\n"
 "    invert_u8_u8\n"
 "    rtty_line_decoder_u8_u8\n"
 "    rtty_baudot2ascii_u8_u8\n"
 "    serial_line_decoder_f_u8 <samples_per_bits> [databits [stopbits]]\n"
 "    octave_complex_c <samples_to_plot> <out_of_n_samples> [--2d]\n"
-"    timing_recovery_cc <algorithm> <decimation> [mu [max_error [--add_q [--output_error | --output_indexes | --octave <show_every_nth> | --octave_save <show_every_nth> <directory> ]]]] \n"
+"    timing_recovery_cc (GARDNER|EARLYLATE|GARDNER_FARROW|MUELLER_MULLER) <decimation> [mu [max_error [--add_q [--output_error | --output_indexes | --octave <show_every_nth> | --octave_save <show_every_nth> <directory> ]]]] \n"
 "    psk31_varicode_encoder_u8_u8\n"
 "    psk31_varicode_decoder_u8_u8\n"
+"    psk31_skimmer_f_u8 <sample_rate> [low_freq high_freq [threshold_db]]\n"
 "    differential_encoder_u8_u8\n"
 "    differential_decoder_u8_u8\n"
 "    dump_u8\n"
@@ -212,6 +236,7 @@ int env_csdr_fixed_bufsize = 1024;
 int env_csdr_fixed_big_bufsize = 1024*16;
 int env_csdr_dynamic_bufsize_on = 0;
 int env_csdr_print_bufsizes = 0;
+int env_csdr_threads = 0;
 int bigbufs = 0;
 
 //change on on 2015-08-29: we don't yield at all. fread() will do it if it blocks
@@ -250,27 +275,103 @@ int clipdetect_ff(float* input, int input_size)
     return 0;
 }
 
+/*
+  Zero-copy forwarding for the stages that do not modify the data.
+  splice() moves the data from one file descriptor to the other in the kernel, without copying it through a buffer of ours.
+  It needs at least one of them to be a pipe, and it can be switched off by export CSDR_SPLICE=0.
+  As stdio would read ahead from the input, splice_setup() should be called before anything is read through infile.
+*/
+
+#ifdef __linux__
+#define SPLICE_MAX_SIZE (1024*1024)
+#endif
+int env_csdr_splice_on = 1;
+
+int splice_setup(FILE *infile, FILE *outfile)
+{
+#ifdef SPLICE_MAX_SIZE
+    if(!env_csdr_splice_on) return 0;
+    struct stat in_stat, out_stat;
+    if(fstat(fileno(infile), &in_stat) || fstat(fileno(outfile), &out_stat)) return 0;
+    if(!S_ISFIFO(in_stat.st_mode) && !S_ISFIFO(out_stat.st_mode)) return 0;
+    setvbuf(infile, NULL, _IONBF, 0); //so that stdio doesn't keep any input from us
+    csdr_io_no_read_ahead(infile); //neither should the io_uring backend
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+int splice_forward(int in_fd, int out_fd, int size, int exact)
+{
+    //It returns the number of bytes moved, 0 on EOF, and -1 on error (when nothing was moved).
+    //If exact is set, it moves exactly size bytes (except on EOF), otherwise it returns after the first successful splice.
+#ifdef SPLICE_MAX_SIZE
+    int moved = 0;
+    while(moved<size)
+    {
+        ssize_t result = splice(in_fd, NULL, out_fd, NULL, size-moved, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if(result<0 && errno==EINTR) continue;
+        if(result<0) return moved ? moved : -1;
+        if(result==0) break;
+        moved += result;
+        if(!exact) break;
+    }
+    return moved;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+void flush_before_direct_io(FILE *infile, FILE *outfile)
+{
+    //Before going to the file descriptors directly, we pass on the samples given back to infile (see getbufsize()), and the output so far.
+    char unread_buffer[64];
+    size_t unread_size;
+    while((unread_size = csdr_io_unread_size(infile)))
+    {
+        if(unread_size>sizeof(unread_buffer)) unread_size = sizeof(unread_buffer);
+        csdr_fread(unread_buffer, 1, unread_size, infile);
+        csdr_fwrite(unread_buffer, 1, unread_size, outfile);
+    }
+    csdr_fflush(outfile);
+}
+
+int clone_splice(FILE *infile, FILE *outfile)
+{
+    //It returns 0 on EOF, and -1 if splice can't be used on these files (then the caller should copy the data).
+#ifdef SPLICE_MAX_SIZE
+    flush_before_direct_io(infile, outfile);
+    int result;
+    while((result = splice_forward(fileno(infile), fileno(outfile), SPLICE_MAX_SIZE, 0)) > 0) TRY_YIELD;
+    return result;
+#else
+    return -1;
+#endif
+}
+
 int clone_(int bufsize_param, FILE *infile, FILE *outfile)
 {
         unsigned char* clone_buffer;
         clone_buffer = (unsigned char*)malloc(bufsize_param*sizeof(unsigned char));
         for(;;)
         {
-            fread(clone_buffer, sizeof(unsigned char), bufsize_param, infile);
-            fwrite(clone_buffer, sizeof(unsigned char), bufsize_param, outfile);
+            csdr_fread(clone_buffer, sizeof(unsigned char), bufsize_param, infile);
+            csdr_fwrite(clone_buffer, sizeof(unsigned char), bufsize_param, outfile);
             TRY_YIELD;
         }
 }
 
-#define FREAD_U8    fread (input_buffer,    sizeof(unsigned char), the_bufsize, infile)
-#define FWRITE_U8   fwrite (output_buffer,  sizeof(unsigned char), the_bufsize, outfile)
-#define FREAD_S16   fread (input_buffer,    sizeof(short),      the_bufsize, infile)
-#define FWRITE_S16  fwrite (output_buffer,  sizeof(short),      the_bufsize, outfile)
-#define FREAD_R     fread (input_buffer,    sizeof(float),      the_bufsize, infile)
-#define FREAD_C     fread (input_buffer,    sizeof(float)*2,    the_bufsize, infile)
-#define FWRITE_R    fwrite (output_buffer,  sizeof(float),      the_bufsize, outfile)
-#define FWRITE_C    fwrite (output_buffer,  sizeof(float)*2,    the_bufsize, outfile)
-#define FEOF_CHECK  if(feof(infile)) return 0
+#define FREAD_U8    csdr_fread (input_buffer,    sizeof(unsigned char), the_bufsize, infile)
+#define FWRITE_U8   csdr_fwrite (output_buffer,  sizeof(unsigned char), the_bufsize, outfile)
+#define FREAD_S16   csdr_fread (input_buffer,    sizeof(short),      the_bufsize, infile)
+#define FWRITE_S16  csdr_fwrite (output_buffer,  sizeof(short),      the_bufsize, outfile)
+#define FREAD_R     csdr_fread (input_buffer,    sizeof(float),      the_bufsize, infile)
+#define FREAD_C     csdr_fread (input_buffer,    sizeof(float)*2,    the_bufsize, infile)
+#define FWRITE_R    csdr_fwrite (output_buffer,  sizeof(float),      the_bufsize, outfile)
+#define FWRITE_C    csdr_fwrite (output_buffer,  sizeof(float)*2,    the_bufsize, outfile)
+#define FEOF_CHECK  if(csdr_feof(infile)) return 0
 //#define BIG_FREAD_C fread(input_buffer, sizeof(float)*2, BIG_BUFSIZE, infile)
 //#define BIG_FWRITE_C fwrite(output_buffer, sizeof(float)*2, BIG_BUFSIZE, outfile)
 
@@ -401,18 +502,146 @@ int read_fifo_ctl(int fd, char* format, ...)
 
 #define SETBUF_PREAMBLE "csdr"
 #define SETBUF_DEFAULT_BUFSIZE 1024
+#define SETBUF_VERSION_2 -2 //it is in the place of the buffer size of v1, so a v1 reader stops with "Invalid buffer size" instead of taking the rest of the header as samples
+#define SETBUF_MAX_HEADER_SIZE 4096
 #define STRINGIFY_VALUE(x) STRINGIFY_NAME(x)
 #define STRINGIFY_NAME(x) #x
 
+/*
+  Stream header.
+  v1 (CSDR_DYNAMIC_BUFSIZE_ON=1) is the preamble "csdr" and the buffer size as an int.
+  v2 (CSDR_DYNAMIC_BUFSIZE_ON=2) is the stream_header_t below. It also tells the sample format, the sample rate and the center
+  frequency of the stream. Readers accept both versions, and skip the fields of a longer header that they don't know.
+  Each command passes the metadata on to the next one, changing the sample rate and the center frequency if it resamples or shifts
+  the signal. The sample format is taken from the name of the command (e.g. convert_u8_f reads u8 and writes f).
+*/
+
+typedef enum stream_format_e
+{
+    STREAM_FORMAT_UNKNOWN,
+    STREAM_FORMAT_U8,
+    STREAM_FORMAT_S8,
+    STREAM_FORMAT_S16,
+    STREAM_FORMAT_S24,
+    STREAM_FORMAT_S32,
+    STREAM_FORMAT_F,
+    STREAM_FORMAT_C
+} stream_format_t;
+
+char* stream_format_names[] = { "unknown", "u8", "s8", "s16", "s24", "s32", "f", "c" };
+#define STREAM_FORMAT_COUNT (sizeof(stream_format_names)/sizeof(char*))
+
+typedef struct stream_header_s
+{
+    char preamble[4]; //SETBUF_PREAMBLE
+    int version; //SETBUF_VERSION_2
+    int header_size; //in bytes, from the beginning of the preamble
+    int buffer_size; //proposed input buffer size of the next process, in samples
+    int sample_format; //stream_format_t
+    int reserved;
+    double sample_rate; //in Hz, 0 if unknown
+    double center_frequency; //in Hz, of the middle of the band (where a complex stream has 0 frequency)
+} stream_header_t;
+
+stream_header_t stream_in; //what we got from the previous process
+stream_header_t stream_out; //what we send to the next process
+stream_format_t command_input_format = STREAM_FORMAT_UNKNOWN;
+stream_format_t command_output_format = STREAM_FORMAT_UNKNOWN;
+
+stream_format_t stream_format_from_string(char* name)
+{
+    if(!strcmp(name,"i16")) return STREAM_FORMAT_S16;
+    for(int i=1;i<(int)STREAM_FORMAT_COUNT;i++) if(!strcmp(name,stream_format_names[i])) return (stream_format_t)i;
+    return STREAM_FORMAT_UNKNOWN;
+}
+
+char* stream_format_to_string(int format)
+{
+    return (format>=0 && format<(int)STREAM_FORMAT_COUNT) ? stream_format_names[format] : stream_format_names[0];
+}
+
+void stream_command_formats(char* command)
+{
+    //The suffix of the command name tells the formats: either two letters like _cf, or two format names like _f_u8.
+    char* last = strrchr(command, '_');
+    if(!last) return;
+    if(strlen(last+1)==2 && strchr("cf", last[1]) && strchr("cf", last[2]))
+    {
+        command_input_format = (last[1]=='c') ? STREAM_FORMAT_C : STREAM_FORMAT_F;
+        command_output_format = (last[2]=='c') ? STREAM_FORMAT_C : STREAM_FORMAT_F;
+        return;
+    }
+    char* before = last-1;
+    while(before>command && *before!='_') before--;
+    if(*before!='_') return;
+    char input_name[8] = {0};
+    if(last-before-1>=(int)sizeof(input_name)) return;
+    memcpy(input_name, before+1, last-before-1);
+    stream_format_t input = stream_format_from_string(input_name), output = stream_format_from_string(last+1);
+    if(!input || !output) return;
+    command_input_format = input;
+    command_output_format = output;
+}
+
+void stream_print(char* what, stream_header_t* header)
+{
+    errhead();
+    fprintf(stderr,"%s: sample format %s", what, stream_format_to_string(header->sample_format));
+    if(header->sample_rate) fprintf(stderr,", sample rate %g, center frequency %g", header->sample_rate, header->center_frequency);
+    fprintf(stderr,"\n");
+}
+
+void stream_resample(double ratio)
+{
+    //the output has ratio times the sample rate of the input
+    stream_out.sample_rate = stream_in.sample_rate*ratio;
+}
+
+void stream_shift(double rate)
+{
+    //the output is the input shifted by rate (relative to the sample rate of the input), like with shift_addition_cc
+    stream_out.center_frequency = stream_in.center_frequency-rate*stream_in.sample_rate;
+}
+
 int getbufsize(FILE *infile)
 {
     if(!env_csdr_dynamic_bufsize_on) return (bigbufs) ? env_csdr_fixed_big_bufsize : env_csdr_fixed_bufsize;
     int recv_first[2];
-    fread(recv_first, sizeof(int), 2, infile);
-    if(memcmp(recv_first, SETBUF_PREAMBLE, sizeof(char)*4)!=0)
-    { badsyntax("warning! Did not match preamble on the beginning of the stream. You should put \"csdr setbuf <buffer size>\" at the beginning of the chain! Falling back to default buffer size: " STRINGIFY_VALUE(SETBUF_DEFAULT_BUFSIZE)); return SETBUF_DEFAULT_BUFSIZE; }
-    if(recv_first[1]<=0) { badsyntax("warning! Invalid buffer size." ); return 0; }
-    return recv_first[1];
+    size_t recv_size = csdr_fread(recv_first, 1, sizeof(recv_first), infile);
+    if(recv_size<sizeof(recv_first) || memcmp(recv_first, SETBUF_PREAMBLE, sizeof(char)*4)!=0)
+    {
+        //these are already samples, so we give them back to the stream
+        csdr_io_unread(infile, recv_first, recv_size);
+        badsyntax("warning! Did not match preamble on the beginning of the stream. You should put \"csdr setbuf <buffer size>\" at the beginning of the chain! Falling back to default buffer size: " STRINGIFY_VALUE(SETBUF_DEFAULT_BUFSIZE));
+        return SETBUF_DEFAULT_BUFSIZE;
+    }
+    memset(&stream_in, 0, sizeof(stream_in));
+    if(recv_first[1]==SETBUF_VERSION_2)
+    {
+        int header_size;
+        if(csdr_fread(&header_size, sizeof(int), 1, infile)!=1) return 0;
+        if(header_size<(int)(3*sizeof(int)) || header_size>SETBUF_MAX_HEADER_SIZE) { badsyntax("warning! Invalid stream header size."); return 0; }
+        size_t header_rest = (size_t)header_size-3*sizeof(int); //after the preamble, the version and the header size
+        char header[SETBUF_MAX_HEADER_SIZE];
+        memcpy(header, recv_first, sizeof(recv_first));
+        memcpy(header+sizeof(recv_first), &header_size, sizeof(int));
+        if(csdr_fread(header+3*sizeof(int), 1, header_rest, infile)!=header_rest) return 0;
+        memcpy(&stream_in, header, ((size_t)header_size<sizeof(stream_in)) ? (size_t)header_size : sizeof(stream_in));
+        if(env_csdr_print_bufsizes) stream_print("input stream", &stream_in);
+        int input_mismatch = stream_in.sample_format && command_input_format && stream_in.sample_format!=(int)command_input_format;
+        if(input_mismatch && stream_in.sample_format>=STREAM_FORMAT_F && command_input_format>=STREAM_FORMAT_F) input_mismatch = 0; //I/Q is also passed around as interleaved f
+        if(input_mismatch)
+        {
+            errhead();
+            fprintf(stderr,"warning! The input stream is %s, but this command expects %s.\n",
+                stream_format_to_string(stream_in.sample_format), stream_format_to_string(command_input_format));
+        }
+    }
+    else stream_in.buffer_size = recv_first[1];
+    stream_out = stream_in;
+    if(command_output_format || command_input_format) stream_out.sample_format = command_output_format;
+    if(stream_in.buffer_size<=0) { badsyntax("warning! Invalid buffer size." ); return 0; }
+    return stream_in.buffer_size;
 }
 
 
@@ -462,10 +691,20 @@ int sendbufsize(int size, FILE *outfile)
     //If the next csdr process detects it, sets the buffer size according to the second word
     if(!env_csdr_dynamic_bufsize_on) return env_csdr_fixed_bufsize;
     if(env_csdr_print_bufsizes) { errhead(); fprintf(stderr,"next process proposed input buffer size is %d\n", size); }
+    if(env_csdr_dynamic_bufsize_on==2)
+    {
+        memcpy(stream_out.preamble, SETBUF_PREAMBLE, 4*sizeof(char));
+        stream_out.version = SETBUF_VERSION_2;
+        stream_out.header_size = sizeof(stream_header_t);
+        stream_out.buffer_size = size;
+        if(env_csdr_print_bufsizes) stream_print("output stream", &stream_out);
+        csdr_fwrite(&stream_out, sizeof(stream_header_t), 1, outfile);
+        return size;
+    }
     int send_first[2];
     memcpy((char*)send_first, SETBUF_PREAMBLE, 4*sizeof(char));
     send_first[1] = size;
-    fwrite(send_first, sizeof(int), 2, outfile);
+    csdr_fwrite(send_first, sizeof(int), 2, outfile);
     return size;
 }
 
@@ -476,7 +715,7 @@ int parse_env()
     //fprintf(stderr, "envtmp: %s\n",envtmp);
     if(envtmp)
     {
-        env_csdr_dynamic_bufsize_on = !!atoi(envtmp);
+        env_csdr_dynamic_bufsize_on = atoi(envtmp); //2 switches to the v2 stream header
         env_csdr_fixed_bufsize = 0;
     }
     else
@@ -492,6 +731,31 @@ int parse_env()
     {
         env_csdr_print_bufsizes = atoi(envtmp);
     }
+    envtmp=getenv("CSDR_SPLICE");
+    if(envtmp)
+    {
+        env_csdr_splice_on = atoi(envtmp);
+    }
+    envtmp=getenv("CSDR_THREADS");
+    if(envtmp)
+    {
+        env_csdr_threads = atoi(envtmp);
+    }
+    envtmp=getenv("CSDR_IO");
+    if(envtmp)
+    {
+        int result = csdr_io_set_backend(envtmp);
+        if(result==-1) { errhead(); fprintf(stderr,"warning! Unknown I/O backend in CSDR_IO: %s\n", envtmp); }
+        if(result==-2) { errhead(); fprintf(stderr,"warning! I/O backend %s is not available, falling back to fd.\n", envtmp); }
+    }
+}
+
+void start_io_threads(FILE *infile, FILE *outfile, int block_size)
+{
+    //The heavy commands call this before their processing loop: with CSDR_THREADS=1, their input is read and their output is written
+    //on separate threads, so that the computation doesn't have to wait for the pipes.
+    if(!env_csdr_threads) return;
+    if(csdr_io_start_threads(infile, outfile, block_size)) { errhead(); fprintf(stderr,"warning! Could not start the I/O threads, continuing without them.\n"); }
 }
 
 /* TODO simplify with some monolithic operations
@@ -580,6 +844,8 @@ int decimating_shift_addfast_cc(FILE *infile, FILE *outfile, int argc, char *arg
     if(!initialize_buffers(infile,outfile)) return -2;
     //transient buffer probably needs place for the decimator to breathe
     complexf *decimator_buffer =  (complexf *)        malloc((the_bufsize+(factor*2))*sizeof(complexf)); //need the 2× because we might also put complex floats into it
+    stream_shift(rate);
+    stream_resample(1./factor);
     sendbufsize(the_bufsize/factor,outfile); //decimation happens here
 
     /*
@@ -594,9 +860,9 @@ int decimating_shift_addfast_cc(FILE *infile, FILE *outfile, int argc, char *arg
         for(;;)
         {
             FEOF_CHECK;
-            fread(decimator.write_pointer, sizeof(complexf), decimator.input_skip, infile);
+            csdr_fread(decimator.write_pointer, sizeof(complexf), decimator.input_skip, infile);
             output_size = fir_decimate_cc((complexf*)input_buffer, (complexf*)output_buffer, the_bufsize, &decimator);
-            fwrite(output_buffer, sizeof(complexf), output_size, outfile);
+            csdr_fwrite(output_buffer, sizeof(complexf), output_size, outfile);
             TRY_YIELD;
         }
      *
@@ -617,7 +883,7 @@ int decimating_shift_addfast_cc(FILE *infile, FILE *outfile, int argc, char *arg
         for(;;)
         {
 //            if(!FREAD_C) break;
-        	if(!fread (input_buffer, sizeof(complexf), decimator.input_skip, infile)) break;
+        	if(!csdr_fread (input_buffer, sizeof(complexf), decimator.input_skip, infile)) break;
         	remain=decimator.input_skip;
             ibufptr=(complexf *)input_buffer;
             obufptr=decimator.write_pointer;
@@ -630,7 +896,7 @@ int decimating_shift_addfast_cc(FILE *infile, FILE *outfile, int argc, char *arg
                 remain-=current_size;
             }
             int output_size = fir_decimate_cc((complexf*)decimator_buffer, (complexf*)output_buffer, the_bufsize, &decimator);
-            fwrite(output_buffer, sizeof(complexf), output_size, outfile);
+            csdr_fwrite(output_buffer, sizeof(complexf), output_size, outfile);
             if(read_fifo_ctl(fd,"%g\n",&rate)) break;
             TRY_YIELD;
         }
@@ -640,12 +906,94 @@ int decimating_shift_addfast_cc(FILE *infile, FILE *outfile, int argc, char *arg
 
 }
 
+/*
+ * bandpass_fir_fft_cc filter redesign helper
+ *
+ * Designing the filter and doing the FFT on the taps can take a while with a low transition_bw.
+ * If it happened on the processing thread, the output would stall for that time on every change
+ * coming in on the --fifo, so we rather do it on a separate thread into the spare one of two taps_fft
+ * buffers, and the processing loop swaps to it at the next block boundary.
+ */
+
+typedef struct bandpass_redesign_s
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    complexf* taps;
+    complexf* taps_fft[2];
+    fft_plan_t* plan_taps[2];
+    int taps_length;
+    window_t window;
+    float low_cut; //requested parameters, guarded by mutex
+    float high_cut;
+    int request_pending;
+    int active; //index of taps_fft currently used by the processing loop
+    int ready; //index of taps_fft that is ready to be swapped in, -1 if none
+} bandpass_redesign_t;
+
+void* bandpass_redesign_thread(void* arg)
+{
+    bandpass_redesign_t* r = (bandpass_redesign_t*)arg;
+    for(;;)
+    {
+        pthread_mutex_lock(&r->mutex);
+        while(!r->request_pending) pthread_cond_wait(&r->cond, &r->mutex);
+        r->request_pending = 0;
+        float low_cut = r->low_cut;
+        float high_cut = r->high_cut;
+        //If the previous result has not been picked up yet, it is not in use, so we can overwrite it.
+        //Until we are done, nothing is ready, so the processing loop won't swap to a half-written buffer.
+        int target = (r->ready != -1) ? r->ready : !r->active;
+        __atomic_store_n(&r->ready, -1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&r->mutex);
+
+        firdes_bandpass_c(r->taps, r->taps_length, low_cut, high_cut, r->window);
+        fft_execute(r->plan_taps[target]);
+        errhead(); fprintf(stderr,"filter initialized, low_cut = %g, high_cut = %g\n",low_cut,high_cut);
+
+        pthread_mutex_lock(&r->mutex);
+        __atomic_store_n(&r->ready, target, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&r->mutex);
+    }
+    return NULL;
+}
+
+void bandpass_redesign_request(bandpass_redesign_t* r, float low_cut, float high_cut)
+{
+    //if more requests arrive while the helper is busy, only the last one will be designed
+    pthread_mutex_lock(&r->mutex);
+    r->low_cut = low_cut;
+    r->high_cut = high_cut;
+    r->request_pending = 1;
+    pthread_cond_signal(&r->cond);
+    pthread_mutex_unlock(&r->mutex);
+}
+
+complexf* bandpass_redesign_get_taps_fft(bandpass_redesign_t* r)
+{
+    //called at block boundaries: we only take the lock if there is something to swap in
+    if(__atomic_load_n(&r->ready, __ATOMIC_ACQUIRE) != -1)
+    {
+        pthread_mutex_lock(&r->mutex);
+        if(r->ready != -1)
+        {
+            r->active = r->ready;
+            r->ready = -1;
+        }
+        pthread_mutex_unlock(&r->mutex);
+    }
+    return r->taps_fft[r->active];
+}
+
 int main(int argc, char *argv[])
 {
-    parse_env();
     argv_global=argv;
     argc_global=argc;
+    parse_env();
     if(argc<=1) return badsyntax(0);
+    stream_command_formats(argv[1]);
+    stream_out.sample_format = command_output_format;
     if(!strcmp(argv[1],"--help")) return badsyntax(0);
 
     fcntl(STDIN_FILENO, F_SETPIPE_SZ, 65536*32);
@@ -661,13 +1009,21 @@ int main(int argc, char *argv[])
         if(argc<=2) return badsyntax("need required parameter (buffer size)");
         sscanf(argv[2],"%d",&the_bufsize);
         if(the_bufsize<=0) return badsyntax("buffer size <= 0 is invalid");
+        if(argc>3 && !(stream_out.sample_format=stream_format_from_string(argv[3]))) return badsyntax("unknown sample format");
+        if(argc>4) sscanf(argv[4],"%lg",&stream_out.sample_rate);
+        if(argc>5) sscanf(argv[5],"%lg",&stream_out.center_frequency);
+        int use_splice = splice_setup(infile, outfile);
         sendbufsize(the_bufsize,outfile);
-        clone_(the_bufsize, infile, outfile); //After sending the buffer size out, just copy infile to outfile
+        //After sending the buffer size out, just copy infile to outfile
+        if(use_splice && clone_splice(infile, outfile)==0) return 0;
+        clone_(the_bufsize, infile, outfile);
     }
 
     if(!strcmp(argv[1],"clone") || !strcmp(argv[1],"REM"))
     {
+        int use_splice = splice_setup(infile, outfile);
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        if(use_splice && clone_splice(infile, outfile)==0) return 0;
         clone_(the_bufsize, infile, outfile);
     }
 #define SET_NONBLOCK(fd) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK)
@@ -675,6 +1031,7 @@ int main(int argc, char *argv[])
     if(!strcmp(argv[1],"fifo"))
     {
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        flush_before_direct_io(infile, outfile);
 
         int fifo_buffer_size;
         if(argc<=2) return badsyntax("need required parameter (buffer_size)");
@@ -765,21 +1122,24 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread(buffer_u8, sizeof(unsigned char), the_bufsize, infile);
+            csdr_fread(buffer_u8, sizeof(unsigned char), the_bufsize, infile);
             convert_u8_f(buffer_u8, output_buffer, the_bufsize);
             FWRITE_R;
             TRY_YIELD;
         }
     }
-    if(!strcmp(argv[1],"convert_f_u8")) //not tested
+    if(!strcmp(argv[1],"convert_f_u8")) //[--dither]
     {
+        int dither = (argc>2) && (!strcmp(argv[2],"--dither"));
+        unsigned int dither_index = 0;
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
         for(;;)
         {
             FEOF_CHECK;
             FREAD_R;
+            if(dither) dither_index = dither_tpdf_ff(input_buffer, input_buffer, the_bufsize, 1/(UCHAR_MAX/2.0f), dither_index);
             convert_f_u8(input_buffer, buffer_u8, the_bufsize);
-            fwrite(buffer_u8, sizeof(unsigned char), the_bufsize, outfile);
+            csdr_fwrite(buffer_u8, sizeof(unsigned char), the_bufsize, outfile);
             TRY_YIELD;
         }
     }
@@ -789,33 +1149,39 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread((signed char*)buffer_u8, sizeof(signed char), the_bufsize, infile);
+            csdr_fread((signed char*)buffer_u8, sizeof(signed char), the_bufsize, infile);
             convert_s8_f((signed char*)buffer_u8, output_buffer, the_bufsize);
             FWRITE_R;
             TRY_YIELD;
         }
     }
-    if(!strcmp(argv[1],"convert_f_s8")) //not tested
+    if(!strcmp(argv[1],"convert_f_s8")) //[--dither]
     {
+        int dither = (argc>2) && (!strcmp(argv[2],"--dither"));
+        unsigned int dither_index = 0;
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
         for(;;)
         {
             FEOF_CHECK;
             FREAD_R;
+            if(dither) dither_index = dither_tpdf_ff(input_buffer, input_buffer, the_bufsize, 1.0f/SCHAR_MAX, dither_index);
             convert_f_s8(input_buffer, (signed char*)buffer_u8, the_bufsize);
-            fwrite((signed char*)buffer_u8, sizeof(signed char), the_bufsize, outfile);
+            csdr_fwrite((signed char*)buffer_u8, sizeof(signed char), the_bufsize, outfile);
             TRY_YIELD;
         }
     }
-    if((!strcmp(argv[1],"convert_f_i16")) || (!strcmp(argv[1],"convert_f_s16")))
+    if((!strcmp(argv[1],"convert_f_i16")) || (!strcmp(argv[1],"convert_f_s16"))) //[--dither]
     {
+        int dither = (argc>2) && (!strcmp(argv[2],"--dither"));
+        unsigned int dither_index = 0;
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
         for(;;)
         {
             FEOF_CHECK;
             FREAD_R;
+            if(dither) dither_index = dither_tpdf_ff(input_buffer, input_buffer, the_bufsize, 1.0f/SHRT_MAX, dither_index);
             convert_f_i16(input_buffer, buffer_i16, the_bufsize);
-            fwrite(buffer_i16, sizeof(short), the_bufsize, outfile);
+            csdr_fwrite(buffer_i16, sizeof(short), the_bufsize, outfile);
             TRY_YIELD;
         }
     }
@@ -825,23 +1191,31 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread(buffer_i16, sizeof(short), the_bufsize, infile);
+            csdr_fread(buffer_i16, sizeof(short), the_bufsize, infile);
             convert_i16_f(buffer_i16, output_buffer, the_bufsize);
             FWRITE_R;
             TRY_YIELD;
         }
     }
-    if(!strcmp(argv[1],"convert_f_s24"))
+    if(!strcmp(argv[1],"convert_f_s24")) //[--bigendian] [--dither]
     {
-        int bigendian = (argc>2) && (!strcmp(argv[2],"--bigendian"));
+        int bigendian = 0, dither = 0;
+        for(int i=2;i<argc;i++)
+        {
+            if(!strcmp(argv[i],"--bigendian")) bigendian = 1;
+            else if(!strcmp(argv[i],"--dither")) dither = 1;
+            else return badsyntax("unknown option");
+        }
+        unsigned int dither_index = 0;
         unsigned char* s24buffer = (unsigned char*)malloc(sizeof(unsigned char)*the_bufsize*3);
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
         for(;;)
         {
             FEOF_CHECK;
             FREAD_R;
+            if(dither) dither_index = dither_tpdf_ff(input_buffer, input_buffer, the_bufsize, 1.0f/((1<<23)-1), dither_index);
             convert_f_s24(input_buffer, s24buffer, the_bufsize, bigendian);
-            fwrite(s24buffer, sizeof(unsigned char)*3, the_bufsize, outfile);
+            csdr_fwrite(s24buffer, sizeof(unsigned char)*3, the_bufsize, outfile);
             TRY_YIELD;
         }
     }
@@ -853,12 +1227,38 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread(s24buffer, sizeof(unsigned char)*3, the_bufsize, infile);
+            csdr_fread(s24buffer, sizeof(unsigned char)*3, the_bufsize, infile);
             convert_s24_f(s24buffer, output_buffer, the_bufsize, bigendian);
             FWRITE_R;
             TRY_YIELD;
         }
     }
+    if(!strcmp(argv[1],"convert_f_s32"))
+    {
+        if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        int* s32buffer = (int*)malloc(sizeof(int)*the_bufsize);
+        for(;;)
+        {
+            FEOF_CHECK;
+            FREAD_R;
+            convert_f_s32(input_buffer, s32buffer, the_bufsize);
+            csdr_fwrite(s32buffer, sizeof(int), the_bufsize, outfile);
+            TRY_YIELD;
+        }
+    }
+    if(!strcmp(argv[1],"convert_s32_f"))
+    {
+        if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        int* s32buffer = (int*)malloc(sizeof(int)*the_bufsize);
+        for(;;)
+        {
+            FEOF_CHECK;
+            csdr_fread(s32buffer, sizeof(int), the_bufsize, infile);
+            convert_s32_f(s32buffer, output_buffer, the_bufsize);
+            FWRITE_R;
+            TRY_YIELD;
+        }
+    }
     if(!strcmp(argv[1],"realpart_cf"))
     {
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
@@ -879,7 +1279,7 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             FREAD_R;
             clipdetect_ff(input_buffer, the_bufsize);
-            fwrite(input_buffer, sizeof(float), the_bufsize, outfile);
+            csdr_fwrite(input_buffer, sizeof(float), the_bufsize, outfile);
             TRY_YIELD;
         }
     }
@@ -920,10 +1320,38 @@ int main(int argc, char *argv[])
         int buf_times = 0;
         if(argc>=4) sscanf(argv[3],"%d",&buf_times);
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+#ifdef SPLICE_MAX_SIZE
+        struct stat out_stat;
+        if(env_csdr_splice_on && !fstat(fileno(outfile), &out_stat) && S_ISFIFO(out_stat.st_mode))
+        {
+            //The buffer never changes, so its pages can be mapped into the pipe by vmsplice() instead of being copied.
+            long page_size = sysconf(_SC_PAGESIZE);
+            int yes_size = ((the_bufsize*sizeof(float)+page_size-1)/page_size)*page_size;
+            float* yes_buffer;
+            if(!posix_memalign((void**)&yes_buffer, page_size, yes_size))
+            {
+                for(int i=0;i<yes_size/sizeof(float);i++) yes_buffer[i]=to_repeat;
+                csdr_fflush(outfile);
+                for(int i=0;(!buf_times)||i<buf_times;i++)
+                {
+                    for(int written=0;written<the_bufsize*sizeof(float);) //the last block may be shorter than the page aligned buffer
+                    {
+                        struct iovec yes_iovec = { .iov_base = (char*)yes_buffer+written, .iov_len = the_bufsize*sizeof(float)-written };
+                        ssize_t result = vmsplice(fileno(outfile), &yes_iovec, 1, 0);
+                        if(result<0 && errno==EINTR) continue;
+                        if(result<=0) return 0;
+                        written += result;
+                    }
+                    TRY_YIELD;
+                }
+                return 0;
+            }
+        }
+#endif
         for(int i=0;i<the_bufsize;i++) output_buffer[i]=to_repeat;
         for(int i=0;(!buf_times)||i<buf_times;i++)
         {
-            fwrite(output_buffer, sizeof(float), the_bufsize, outfile);
+            csdr_fwrite(output_buffer, sizeof(float), the_bufsize, outfile);
             TRY_YIELD;
         }
         return 0;
@@ -934,7 +1362,9 @@ int main(int argc, char *argv[])
         float starting_phase=0;
         float rate;
         sscanf(argv[2],"%g",&rate);
-        if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        if(!initialize_buffers(infile,outfile)) return -2;
+        stream_shift(rate);
+        sendbufsize(the_bufsize,outfile);
         for(;;)
         {
             if(!FREAD_C) break;
@@ -958,7 +1388,9 @@ int main(int argc, char *argv[])
         int table_size=65536;
         sscanf(argv[2],"%g",&rate);
         if(argc>3) sscanf(argv[3],"%d",&table_size);
-        if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        if(!initialize_buffers(infile,outfile)) return -2;
+        stream_shift(rate);
+        sendbufsize(the_bufsize,outfile);
         shift_table_data_t table_data=shift_table_init(table_size);
         errhead();
         fprintf(stderr,"LUT initialized\n");
@@ -992,7 +1424,9 @@ int main(int argc, char *argv[])
             sscanf(argv[2],"%g",&rate);
         }
 
-        if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        if(!initialize_buffers(infile,outfile)) return -2;
+        stream_shift(rate); //the initial one, if it is controlled through a fifo
+        sendbufsize(the_bufsize,outfile);
         for(;;)
         {
             shift_addfast_data_t data=shift_addfast_init(rate);
@@ -1042,7 +1476,9 @@ int main(int argc, char *argv[])
             sscanf(argv[2],"%g",&rate);
         }
 
-        if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        if(!initialize_buffers(infile,outfile)) return -2;
+        stream_shift(rate); //the initial one, if it is controlled through a fifo
+        sendbufsize(the_bufsize,outfile);
         for(;;)
         {
             shift_unroll_data_t data=shift_unroll_init(rate, 1024);
@@ -1092,6 +1528,8 @@ int main(int argc, char *argv[])
         sscanf(argv[2],"%g",&rate);
         if(argc>3) sscanf(argv[3],"%d",&decimation);
         if(!initialize_buffers(infile,outfile)) return -2;
+        stream_shift(rate);
+        stream_resample(1./decimation);
         sendbufsize(the_bufsize/decimation,outfile);
         shift_addition_data_t d=decimating_shift_addition_init(rate, decimation);
         decimating_shift_addition_status_t s;
@@ -1102,7 +1540,7 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             if(!FREAD_C) break;
             s=decimating_shift_addition_cc((complexf*)input_buffer, (complexf*)output_buffer, the_bufsize, d, decimation, s);
-            fwrite(output_buffer, sizeof(float)*2, s.output_size, outfile);
+            csdr_fwrite(output_buffer, sizeof(float)*2, s.output_size, outfile);
             TRY_YIELD;
         }
         return 0;
@@ -1126,7 +1564,9 @@ int main(int argc, char *argv[])
             sscanf(argv[2],"%g",&rate);
         }
 
-        if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        if(!initialize_buffers(infile,outfile)) return -2;
+        stream_shift(rate); //the initial one, if it is controlled through a fifo
+        sendbufsize(the_bufsize,outfile);
         for(;;)
         {
             shift_addition_data_t data=shift_addition_init(rate);
@@ -1194,9 +1634,9 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread(dcblock_buffer, sizeof(float), dcblock_bufsize, infile);
+            csdr_fread(dcblock_buffer, sizeof(float), dcblock_bufsize, infile);
             last_dc_level=fastdcblock_ff(dcblock_buffer, dcblock_buffer, dcblock_bufsize, last_dc_level);
-            fwrite(dcblock_buffer, sizeof(float), dcblock_bufsize, outfile);
+            csdr_fwrite(dcblock_buffer, sizeof(float), dcblock_bufsize, outfile);
             TRY_YIELD;
         }
     }
@@ -1209,12 +1649,27 @@ int main(int argc, char *argv[])
         {
             FEOF_CHECK;
             FREAD_C;
-            if(feof(infile)) return 0;
+            if(csdr_feof(infile)) return 0;
             last_phase=fmdemod_atan_cf((complexf*)input_buffer, output_buffer, the_bufsize, last_phase);
             FWRITE_R;
             TRY_YIELD;
         }
     }
+    if(!strcmp(argv[1],"fmdemod_atan_fast_cf"))
+    {
+        if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        complexf last_sample;
+        last_sample.i=0.;
+        last_sample.q=0.;
+        for(;;)
+        {
+            FEOF_CHECK;
+            FREAD_C;
+            last_sample=fmdemod_atan_fast_cf((complexf*)input_buffer, output_buffer, the_bufsize, last_sample);
+            FWRITE_R;
+            TRY_YIELD;
+        }
+    }
     if(!strcmp(argv[1],"fmdemod_quadri_cf"))
     {
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
@@ -1265,6 +1720,37 @@ int main(int argc, char *argv[])
         }
     }
 
+    if(!strcmp(argv[1],"wfm_stereo_cf"))
+    {
+        if(argc<=3) return badsyntax("need required parameters (input_rate, output_rate)");
+        int input_rate, output_rate;
+        sscanf(argv[2],"%d",&input_rate);
+        sscanf(argv[3],"%d",&output_rate);
+        float tau = 50e-6;
+        if(argc>=5) sscanf(argv[4],"%g",&tau);
+        if(input_rate<=output_rate) return badsyntax("input_rate should be larger than output_rate");
+        if(input_rate<120000) return badsyntax("input_rate should be at least 120000 to contain the stereo subcarrier");
+        errhead(); fprintf(stderr,"input_rate = %d, output_rate = %d, tau = %g\n",input_rate,output_rate,tau);
+
+        command_output_format = STREAM_FORMAT_S16;
+        if(!initialize_buffers(infile,outfile)) return -2;
+        stream_out.sample_rate = output_rate;
+        stream_out.center_frequency = 0;
+        float rate = (float)input_rate/output_rate;
+        sendbufsize(2*the_bufsize/rate,outfile);
+
+        wfm_stereo_t s = wfm_stereo_init(input_rate, output_rate, tau, the_bufsize);
+        short* stereo_output = (short*)malloc(sizeof(short)*2*(the_bufsize+s.audio_taps_length));
+        for(;;)
+        {
+            FEOF_CHECK;
+            FREAD_C;
+            wfm_stereo_cf((complexf*)input_buffer, stereo_output, the_bufsize, &s);
+            csdr_fwrite(stereo_output, sizeof(short), 2*s.output_size, outfile);
+            TRY_YIELD;
+        }
+    }
+
     if(!strcmp(argv[1],"detect_nan_ff"))
     {
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
@@ -1282,7 +1768,7 @@ int main(int argc, char *argv[])
                 }
             }
             if(nan_detect) { errhead(); fprintf(stderr, "NaN detected!\n"); }
-            fwrite(input_buffer, sizeof(float), the_bufsize, outfile);
+            csdr_fwrite(input_buffer, sizeof(float), the_bufsize, outfile);
             TRY_YIELD;
         }
     }
@@ -1311,11 +1797,11 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread(input_buffer+the_bufsize-processed, sizeof(float), processed, infile);
+            csdr_fread(input_buffer+the_bufsize-processed, sizeof(float), processed, infile);
             processed=deemphasis_nfm_ff(input_buffer, output_buffer, the_bufsize, sample_rate);
             if(!processed) return badsyntax("deemphasis_nfm_ff: invalid sample rate (this function works only with specific sample rates).");
             memmove(input_buffer,input_buffer+processed,(the_bufsize-processed)*sizeof(float)); //memmove lets the source and destination overlap
-            fwrite(output_buffer, sizeof(float), processed, outfile);
+            csdr_fwrite(output_buffer, sizeof(float), processed, outfile);
             TRY_YIELD;
         }
     }
@@ -1345,6 +1831,34 @@ int main(int argc, char *argv[])
         }
     }
 
+    if(!strcmp(argv[1],"samdemod_cf"))
+    {
+        samdemod_sideband_t sideband = SAMDEMOD_DSB;
+        float pll_bandwidth = 0.001;
+        float transition_bw = 0.02;
+        if(argc>2)
+        {
+            if(!strcmp(argv[2],"dsb")) sideband = SAMDEMOD_DSB;
+            else if(!strcmp(argv[2],"usb")) sideband = SAMDEMOD_USB;
+            else if(!strcmp(argv[2],"lsb")) sideband = SAMDEMOD_LSB;
+            else return badsyntax("sideband should be one of: dsb, usb, lsb");
+        }
+        if(argc>3) sscanf(argv[3],"%g",&pll_bandwidth);
+        if(argc>4) sscanf(argv[4],"%g",&transition_bw);
+        errhead(); fprintf(stderr,"sideband = %s, pll_bandwidth = %g, transition_bw = %g\n", (argc>2)?argv[2]:"dsb", pll_bandwidth, transition_bw);
+
+        if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        samdemod_t sam = samdemod_init(sideband, pll_bandwidth, transition_bw, the_bufsize);
+        for(;;)
+        {
+            FEOF_CHECK;
+            FREAD_C;
+            samdemod_cf((complexf*)input_buffer, output_buffer, the_bufsize, &sam);
+            FWRITE_R;
+            TRY_YIELD;
+        }
+    }
+
     if(!strcmp(argv[1],"fir_decimate_cc"))
     {
         bigbufs=1;
@@ -1369,20 +1883,75 @@ int main(int argc, char *argv[])
         while (env_csdr_fixed_big_bufsize < decimator.taps_length*2) env_csdr_fixed_big_bufsize*=2; //temporary fix for buffer size if [transition_bw] is low
 
         if(!initialize_buffers(infile,outfile)) return -2;
+        stream_resample(1./factor);
         sendbufsize(the_bufsize/factor,outfile);
 
         // init function can't have the buffer since it is initialized after, so we set this manually
         // would be better to encapsulate the buffer in fir_decimate_t
         decimator.write_pointer = (complexf*) input_buffer;
         decimator.input_skip = the_bufsize;
+        start_io_threads(infile, outfile, the_bufsize*sizeof(complexf));
 
         int output_size = 0;
         for(;;)
         {
             FEOF_CHECK;
-            fread(decimator.write_pointer, sizeof(complexf), decimator.input_skip, infile);
+            csdr_fread(decimator.write_pointer, sizeof(complexf), decimator.input_skip, infile);
             output_size = fir_decimate_cc((complexf*)input_buffer, (complexf*)output_buffer, the_bufsize, &decimator);
-            fwrite(output_buffer, sizeof(complexf), output_size, outfile);
+            csdr_fwrite(output_buffer, sizeof(complexf), output_size, outfile);
+            TRY_YIELD;
+        }
+    }
+
+    if(!strcmp(argv[1],"frontend_u8_cc") || !strcmp(argv[1],"frontend_s16_cc")) //<shift_rate> <decimation_factor> [transition_bw [window]] [--fifo <fifo_file>]
+    {
+        //the same as (within float rounding): convert_u8_f | shift_addfast_cc <shift_rate> | fir_decimate_cc <decimation_factor> [transition_bw [window]]
+        bigbufs=1;
+        int is_s16 = !strcmp(argv[1],"frontend_s16_cc");
+        command_input_format = (is_s16) ? STREAM_FORMAT_S16 : STREAM_FORMAT_U8; //I/Q samples, interleaved
+
+        //the optional arguments end at --fifo
+        int num_args = argc;
+        for(int i=2;i<argc;i++) if(!strcmp(argv[i],"--fifo")) { num_args = i; break; }
+
+        if(num_args<=3) return badsyntax("need required parameters (shift_rate, decimation_factor)");
+        float shift_rate;
+        sscanf(argv[2],"%g",&shift_rate);
+        int factor;
+        sscanf(argv[3],"%d",&factor);
+        if(factor<1) return badsyntax("decimation_factor should be at least 1");
+
+        float transition_bw = 0.05;
+        if(num_args>=5) sscanf(argv[4],"%g",&transition_bw);
+
+        window_t window = WINDOW_DEFAULT;
+        if(num_args>=6) window=firdes_get_window_from_string(argv[5]);
+        else { errhead(); fprintf(stderr,"window = %s\n",firdes_get_string_from_window(window)); }
+
+        int fd = init_fifo(argc,argv);
+        frontend_t frontend = frontend_init(shift_rate, factor, transition_bw, window);
+
+        if(!initialize_buffers(infile,outfile)) return -2;
+        stream_shift(shift_rate);
+        stream_resample(1./factor);
+        sendbufsize(the_bufsize/factor,outfile);
+
+        //input_buffer has room for the_bufsize complex floats, which is enough for the_bufsize complex u8 or s16 samples
+        int sample_size = (is_s16) ? 2*sizeof(short) : 2*sizeof(unsigned char);
+        complexf* frontend_output = (complexf*)malloc(sizeof(complexf)*(the_bufsize/factor+frontend.buffer_size));
+        for(;;)
+        {
+            FEOF_CHECK;
+            int input_size = csdr_fread(input_buffer, sample_size, the_bufsize, infile);
+            int output_size = (is_s16) ?
+                frontend_s16_cc(&frontend, (short*)input_buffer, frontend_output, input_size) :
+                frontend_u8_cc(&frontend, (unsigned char*)input_buffer, frontend_output, input_size);
+            csdr_fwrite(frontend_output, sizeof(complexf), output_size, outfile);
+            if(read_fifo_ctl(fd,"%g\n",&shift_rate))
+            {
+                frontend_set_shift_rate(&frontend, shift_rate);
+                errhead(); fprintf(stderr,"shift_rate changed to %g\n",shift_rate);
+            }
             TRY_YIELD;
         }
     }
@@ -1416,6 +1985,7 @@ int main(int argc, char *argv[])
         //fprintf(stderr, "env_csdr_fixed_big_bufsize = %d\n", env_csdr_fixed_big_bufsize);
 
         if(!initialize_buffers(infile,outfile)) return -2;
+        stream_resample(factor);
         sendbufsize(the_bufsize*factor,outfile);
         assert(the_bufsize > 0);
 
@@ -1433,11 +2003,11 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             output_size=fir_interpolate_cc((complexf*)input_buffer, (complexf*)interp_output_buffer, the_bufsize, factor, taps, taps_length);
             //fprintf(stderr, "os %d\n",output_size);
-            fwrite(interp_output_buffer, sizeof(complexf), output_size, outfile);
+            csdr_fwrite(interp_output_buffer, sizeof(complexf), output_size, outfile);
             TRY_YIELD;
             input_skip=output_size/factor;
             memmove((complexf*)input_buffer,((complexf*)input_buffer)+input_skip,(the_bufsize-input_skip)*sizeof(complexf)); //memmove lets the source and destination overlap
-            fread(((complexf*)input_buffer)+(the_bufsize-input_skip), sizeof(complexf), input_skip, infile);
+            csdr_fread(((complexf*)input_buffer)+(the_bufsize-input_skip), sizeof(complexf), input_skip, infile);
             //fprintf(stderr,"iskip=%d output_size=%d start=%x target=%x skipcount=%x \n",input_skip,output_size,input_buffer, ((complexf*)input_buffer)+(BIG_BUFSIZE-input_skip),(BIG_BUFSIZE-input_skip));
         }
     }
@@ -1493,7 +2063,7 @@ int main(int argc, char *argv[])
 
         //Wait forever, so that octave won't close just after popping up the window.
         //You can close it with ^C.
-        if(octave) { fflush(outfile); getchar(); }
+        if(octave) { csdr_fflush(outfile); getchar(); }
         return 0;
     }
     if(!strcmp(argv[1],"firdes_bandpass_c"))
@@ -1540,10 +2110,82 @@ int main(int argc, char *argv[])
 
         //Wait forever, so that octave won't close just after popping up the window.
         //You can close it with ^C.
-        if(octave) { fflush(outfile); getchar(); }
+        if(octave) { csdr_fflush(outfile); getchar(); }
         return 0;
     }
 
+    if(!strcmp(argv[1],"iir_filter_ff")||!strcmp(argv[1],"iir_filter_cc"))
+    {
+        int is_complex = !strcmp(argv[1],"iir_filter_cc");
+        if(argc<=2) return badsyntax("need required parameter (butterworth, chebyshev or notch)");
+        biquad_t* sections;
+        int num_sections;
+        if(!strcmp(argv[2],"notch"))
+        {
+            if(argc<=4) return badsyntax("need required parameters (rate, bandwidth)");
+            float rate, bandwidth;
+            sscanf(argv[3],"%g",&rate);
+            sscanf(argv[4],"%g",&bandwidth);
+            sections=(biquad_t*)malloc(sizeof(biquad_t));
+            num_sections=iirdes_notch(sections, rate, bandwidth);
+        }
+        else
+        {
+            int is_chebyshev = !strcmp(argv[2],"chebyshev");
+            if(!is_chebyshev && strcmp(argv[2],"butterworth")) return badsyntax("filter design should be one of: butterworth, chebyshev, notch");
+            int argi = 3;
+            float ripple_db = 0;
+            if(is_chebyshev)
+            {
+                if(argc<=argi) return badsyntax("need required parameter (ripple_db)");
+                sscanf(argv[argi++],"%g",&ripple_db);
+            }
+            if(argc<=argi+2) return badsyntax("need required parameters (type, order, cutoff_rate)");
+            iir_filter_type_t type;
+            if(!strcmp(argv[argi],"lowpass")) type = IIR_LOWPASS;
+            else if(!strcmp(argv[argi],"highpass")) type = IIR_HIGHPASS;
+            else if(!strcmp(argv[argi],"bandpass")) type = IIR_BANDPASS;
+            else if(!strcmp(argv[argi],"bandstop")) type = IIR_BANDSTOP;
+            else return badsyntax("filter type should be one of: lowpass, highpass, bandpass, bandstop");
+            argi++;
+            int order;
+            sscanf(argv[argi++],"%d",&order);
+            if(order<1) return badsyntax("filter order should be at least 1");
+            float cutoff1, cutoff2 = 0;
+            sscanf(argv[argi++],"%g",&cutoff1);
+            if(type==IIR_BANDPASS||type==IIR_BANDSTOP)
+            {
+                if(argc<=argi) return badsyntax("need required parameter (high_cut)");
+                sscanf(argv[argi],"%g",&cutoff2);
+                if(cutoff2<=cutoff1) return badsyntax("high_cut should be greater than low_cut");
+            }
+            sections=(biquad_t*)malloc(sizeof(biquad_t)*iirdes_num_sections(order, type));
+            if(is_chebyshev) num_sections=iirdes_chebyshev1(sections, order, type, cutoff1, cutoff2, ripple_db);
+            else num_sections=iirdes_butterworth(sections, order, type, cutoff1, cutoff2);
+        }
+        errhead(); fprintf(stderr,"number of second order sections = %d\n", num_sections);
+
+        if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        sos_filter_t filter = sos_filter_init(sections, num_sections, (is_complex)?2:1);
+        for(;;)
+        {
+            FEOF_CHECK;
+            if(is_complex)
+            {
+                FREAD_C;
+                sos_filter_cc(&filter, (complexf*)input_buffer, (complexf*)output_buffer, the_bufsize);
+                FWRITE_C;
+            }
+            else
+            {
+                FREAD_R;
+                sos_filter_ff(&filter, input_buffer, output_buffer, the_bufsize);
+                FWRITE_R;
+            }
+            TRY_YIELD;
+        }
+    }
+
 #ifdef LIBCSDR_GPL
     if (!strcmp(argv[1], "agc_ff") || !strcmp(argv[1], "agc_s16")) {
         // store this since getopt will manipulate it
@@ -1582,16 +2224,20 @@ int main(int argc, char *argv[])
             {"initial", required_argument, NULL, 'i'},
             {"attackwait", required_argument, NULL, 'w'},
             {"alpha", required_argument, NULL, 'l'},
+            {"block", required_argument, NULL, 'b'},
+            {"lookahead", required_argument, NULL, 'k'},
             { NULL, 0, NULL, 0 }
         };
 
         char* profile = "fast";
         agc_params collection = {0, 0, 0, 0, 0, 0, 0};
         float initial_gain = 1;
+        int block_size = 0; //0: per-sample AGC
+        int lookahead = 0;
 
         int c;
 
-        while ((c = getopt_long(argc, argv, "hp:t:r:a:d:m:i:w:l:", long_options, NULL)) != -1) {
+        while ((c = getopt_long(argc, argv, "hp:t:r:a:d:m:i:w:l:b:k:", long_options, NULL)) != -1) {
             switch (c) {
                 case 'h':
                     // TODO print_usage();
@@ -1623,6 +2269,12 @@ int main(int argc, char *argv[])
                 case 'l':
                     sscanf(optarg, "%g", &collection.gain_filter_alpha);
                     break;
+                case 'b':
+                    sscanf(optarg, "%d", &block_size);
+                    break;
+                case 'k':
+                    sscanf(optarg, "%d", &lookahead);
+                    break;
             }
         }
 
@@ -1644,7 +2296,19 @@ int main(int argc, char *argv[])
 
         fprintf(stderr, "AGC PARAMS:\n  hang_time = %d\n  reference = %f\n  attack_rate = %f\n  decay_rate = %f\n  max_gain = %f\n  initial_gain = %f\n  attack_wait_time = %d\n  gain_filter_alpha = %f\n", params->hang_time, params->reference, params->attack_rate, params->decay_rate, params->max_gain, initial_gain, params->attack_wait_time, params->gain_filter_alpha);
 
+        if (block_size < 0 || lookahead < 0) return badsyntax("block size and lookahead should not be negative");
+        if (lookahead && !block_size) return badsyntax("--lookahead can only be used with --block");
+        agc_block_state* block = NULL;
+        if (block_size) {
+            block = agc_block_init(params, block_size, lookahead);
+            fprintf(stderr, "  block_size = %d\n  lookahead = %d\n", block->block_size, block->lookahead);
+        }
+
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        if (block && the_bufsize % block->block_size) {
+            fprintf(stderr, "%s: the buffer size (%d) should be a multiple of the block size (%d)\n", mode, the_bufsize, block->block_size);
+            return -2;
+        }
 
         agc_state* state = malloc(sizeof(agc_state));
         state->last_gain = initial_gain;
@@ -1658,7 +2322,8 @@ int main(int argc, char *argv[])
             {
                 FEOF_CHECK;
                 FREAD_R;
-                state = agc_ff(input_buffer, output_buffer, the_bufsize, params, state);
+                if (block) state = agc_block_ff(input_buffer, output_buffer, the_bufsize, params, state, block);
+                else state = agc_ff(input_buffer, output_buffer, the_bufsize, params, state);
                 FWRITE_R;
                 TRY_YIELD;
             }
@@ -1667,7 +2332,8 @@ int main(int argc, char *argv[])
             {
                 FEOF_CHECK;
                 FREAD_S16;
-                state = agc_s16((short*) input_buffer, (short*) output_buffer, the_bufsize, params, state);
+                if (block) state = agc_block_s16((short*) input_buffer, (short*) output_buffer, the_bufsize, params, state, block);
+                else state = agc_s16((short*) input_buffer, (short*) output_buffer, the_bufsize, params, state);
                 FWRITE_S16;
                 TRY_YIELD;
             }
@@ -1677,33 +2343,35 @@ int main(int argc, char *argv[])
     }
 #endif
 
-    if(!strcmp(argv[1],"fastagc_ff"))
+    if(!strcmp(argv[1],"fastagc_ff")||!strcmp(argv[1],"fastagc_cc"))
     {
+        int is_complex = !strcmp(argv[1],"fastagc_cc");
 
-        static fastagc_ff_t input; //is in .bss and gets cleared to zero before main()
-
-        input.input_size=1024;
-        if(argc>=3) sscanf(argv[2],"%d",&input.input_size);
+        int input_size=1024;
+        if(argc>=3) sscanf(argv[2],"%d",&input_size);
 
         getbufsize(infile); //dummy
-        sendbufsize(input.input_size,outfile);
+        sendbufsize(input_size,outfile);
+
+        float reference=1.0;
+        if(argc>=4) sscanf(argv[3],"%g",&reference);
 
-        input.reference=1.0;
-        if(argc>=4) sscanf(argv[3],"%g",&input.reference);
+        int num_blocks=3; //the block going out, and the ones we look ahead into
+        if(argc>=5) sscanf(argv[4],"%d",&num_blocks);
+        if(num_blocks<1) return badsyntax("num_blocks should be at least 1");
 
         //input.max_peak_ratio=12.0;
         //if(argc>=5) sscanf(argv[3],"%g",&input.max_peak_ratio);
 
-        input.buffer_1=(float*)calloc(input.input_size,sizeof(float));
-        input.buffer_2=(float*)calloc(input.input_size,sizeof(float));
-        input.buffer_input=(float*)malloc(sizeof(float)*input.input_size);
-        float* agc_output_buffer=(float*)malloc(sizeof(float)*input.input_size);
+        fastagc_ff_t input=fastagc_init(input_size, num_blocks, reference, (is_complex)?2:1);
+        float* agc_output_buffer=(float*)malloc(sizeof(float)*input_size*input.floats_per_sample);
         for(;;)
         {
             FEOF_CHECK;
-            fread(input.buffer_input, sizeof(float), input.input_size, infile);
-            fastagc_ff(&input, agc_output_buffer);
-            fwrite(agc_output_buffer, sizeof(float), input.input_size, outfile);
+            csdr_fread(input.buffer_input, sizeof(float)*input.floats_per_sample, input.input_size, infile);
+            if(is_complex) fastagc_cc(&input, (complexf*)agc_output_buffer);
+            else fastagc_ff(&input, agc_output_buffer);
+            csdr_fwrite(agc_output_buffer, sizeof(float)*input.floats_per_sample, input.input_size, outfile);
             TRY_YIELD;
         }
     }
@@ -1734,6 +2402,7 @@ int main(int argc, char *argv[])
         if(suboptimal) { errhead(); fprintf(stderr,"note: suboptimal rational resampler chosen.\n"); }
 
         if(!initialize_buffers(infile,outfile)) return -2;
+        stream_resample((double)interpolation/decimation);
 
         if(decimation==1&&interpolation==1) { sendbufsize(the_bufsize,outfile); clone_(the_bufsize,infile,outfile); } //copy input to output in this special case (and stick in this function).
 
@@ -1755,11 +2424,11 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             if(d.input_processed==0) d.input_processed=the_bufsize;
             else memcpy(input_buffer, input_buffer+d.input_processed, sizeof(float)*(the_bufsize-d.input_processed));
-            fread(input_buffer+(the_bufsize-d.input_processed), sizeof(float), d.input_processed, infile);
+            csdr_fread(input_buffer+(the_bufsize-d.input_processed), sizeof(float), d.input_processed, infile);
             //if(suboptimal) d=suboptimal_rational_resampler_ff(input_buffer, resampler_output_buffer, the_bufsize, interpolation, decimation, taps, taps_length, suboptimal_resampler_temp_buffer); else
             d=rational_resampler_ff(input_buffer, resampler_output_buffer, the_bufsize, interpolation, decimation, taps, taps_length, d.last_taps_delay);
             //fprintf(stderr,"resampled %d %d, %d\n",d.output_size, d.input_processed, d.input_processed);
-            fwrite(resampler_output_buffer, sizeof(float), d.output_size, outfile);
+            csdr_fwrite(resampler_output_buffer, sizeof(float), d.output_size, outfile);
             TRY_YIELD;
         }
     }
@@ -1797,6 +2466,7 @@ int main(int argc, char *argv[])
             use_prefilter, num_poly_points, transition_bw, firdes_get_string_from_window(window));
 
         if(!initialize_buffers(infile,outfile)) return -2;
+        stream_resample(1./rate);
         sendbufsize(the_bufsize / rate,outfile);
 
         if(rate==1) clone_(the_bufsize, infile, outfile); //copy input to output in this special case (and stick in this function).
@@ -1819,9 +2489,9 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             if(d.input_processed==0) d.input_processed=the_bufsize;
             else memcpy(input_buffer, input_buffer+d.input_processed, sizeof(float)*(the_bufsize-d.input_processed));
-            fread(input_buffer+(the_bufsize-d.input_processed), sizeof(float), d.input_processed, infile);
+            csdr_fread(input_buffer+(the_bufsize-d.input_processed), sizeof(float), d.input_processed, infile);
             fractional_decimator_ff(input_buffer, output_buffer, the_bufsize, &d);
-            fwrite(output_buffer, sizeof(float), d.output_size, outfile);
+            csdr_fwrite(output_buffer, sizeof(float), d.output_size, outfile);
             //fprintf(stderr, "os = %d, ip = %d\n", d.output_size, d.input_processed);
             TRY_YIELD;
         }
@@ -1859,6 +2529,7 @@ int main(int argc, char *argv[])
             use_prefilter, num_poly_points, transition_bw, firdes_get_string_from_window(window));
 
         if(!initialize_buffers(infile,outfile)) return -2;
+        stream_resample(1./rate);
         sendbufsize(the_bufsize / rate,outfile);
 
         if(rate==1) clone_(the_bufsize, infile, outfile); //copy input to output in this special case (and stick in this function).
@@ -1885,9 +2556,9 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             if(d.input_processed==0) d.input_processed=the_bufsize;
             else memcpy(input_buffer_f, input_buffer_f+d.input_processed, sizeof(complexf)*(the_bufsize-d.input_processed));
-            fread(input_buffer_f+(the_bufsize-d.input_processed), sizeof(complexf), d.input_processed, infile);
+            csdr_fread(input_buffer_f+(the_bufsize-d.input_processed), sizeof(complexf), d.input_processed, infile);
             fractional_decimator_cc(input_buffer_f, output_buffer_f, the_bufsize, &d);
-            fwrite(output_buffer_f, sizeof(complexf), d.output_size, outfile);
+            csdr_fwrite(output_buffer_f, sizeof(complexf), d.output_size, outfile);
             //fprintf(stderr, "os = %d, ip = %d\n", d.output_size, d.input_processed);
             TRY_YIELD;
         }
@@ -1937,18 +2608,18 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             if(every_n_samples>fft_size)
             {
-                fread(input, sizeof(complexf), fft_size, infile);
+                csdr_fread(input, sizeof(complexf), fft_size, infile);
                 //skipping samples before next FFT (but fseek doesn't work for pipes)
                 for(int seek_remain=every_n_samples-fft_size;seek_remain>0;seek_remain-=the_bufsize)
                 {
-                    fread(temp_f, sizeof(complexf), MIN_M(the_bufsize,seek_remain), infile);
+                    csdr_fread(temp_f, sizeof(complexf), MIN_M(the_bufsize,seek_remain), infile);
                 }
             }
             else
             {
                 //overlapped FFT
                 for(int i=0;i<fft_size-every_n_samples;i++) input[i]=input[i+every_n_samples];
-                fread(input+fft_size-every_n_samples, sizeof(complexf), every_n_samples, infile);
+                csdr_fread(input+fft_size-every_n_samples, sizeof(complexf), every_n_samples, infile);
             }
             //apply_window_c(input,windowed,fft_size,window);
             apply_precalculated_window_c(input,windowed,fft_size,windowt);
@@ -1965,7 +2636,7 @@ int main(int argc, char *argv[])
                     "refreshdata;\n"
                 );
             }
-            else fwrite(output, sizeof(complexf), fft_size, outfile);
+            else csdr_fwrite(output, sizeof(complexf), fft_size, outfile);
             TRY_YIELD;
         }
     }
@@ -1980,9 +2651,9 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread(input_buffer, sizeof(complexf), the_bufsize, infile);
+            csdr_fread(input_buffer, sizeof(complexf), the_bufsize, infile);
             logpower_cf((complexf*)input_buffer,output_buffer, the_bufsize, add_db);
-            fwrite(output_buffer, sizeof(float), the_bufsize, outfile);
+            csdr_fwrite(output_buffer, sizeof(float), the_bufsize, outfile);
             TRY_YIELD;
         }
     }
@@ -2011,11 +2682,11 @@ int main(int argc, char *argv[])
             }
             FEOF_CHECK;
             for(n = 0; n < avgnumber; n++) {
-                fread (input, sizeof(float)*2, fft_size, infile);
+                csdr_fread (input, sizeof(float)*2, fft_size, infile);
                 accumulate_power_cf((complexf*)input, output, fft_size);
             }
             log_ff(output, output, fft_size, add_db);
-            fwrite (output, sizeof(float), fft_size, outfile);
+            csdr_fwrite (output, sizeof(float), fft_size, outfile);
             TRY_YIELD;
         }
         return 0;
@@ -2026,17 +2697,39 @@ int main(int argc, char *argv[])
         if(argc<=2) return badsyntax("need required parameters (fft_size)");
         int fft_size;
         sscanf(argv[2],"%d",&fft_size);
+        int use_splice = splice_setup(infile, outfile);
         if(!getbufsize(infile)) return -2; //dummy
         sendbufsize(fft_size,outfile);
         float* input_buffer_s1 = (float*)malloc(sizeof(float)*fft_size/2);
         float* input_buffer_s2 = (float*)malloc(sizeof(float)*fft_size/2);
+        //With splice, the second half of the FFT goes directly from the input to the output, and only the first half is copied.
+        //(Holding the first half in a pipe of ours instead could block forever: if it arrives in many small writes, each of them takes a slot of that pipe.)
+        int half_size = sizeof(float)*fft_size/2;
+        if(use_splice) csdr_fflush(outfile);
+        while(use_splice)
+        {
+            if(csdr_fread(input_buffer_s1, sizeof(unsigned char), half_size, infile)!=half_size) return 0;
+            int spliced = splice_forward(fileno(infile), fileno(outfile), half_size, 1);
+            if(spliced<0) //splice() can't be used on these files (e.g. the output is opened with O_APPEND), so we copy this FFT and fall back
+            {
+                csdr_fread(input_buffer_s2, sizeof(unsigned char), half_size, infile);
+                struct iovec exchanged_halves[2] = { { input_buffer_s2, half_size }, { input_buffer_s1, half_size } };
+                csdr_fwritev(exchanged_halves, 2, outfile);
+                use_splice = 0;
+                break;
+            }
+            if(spliced!=half_size) return 0;
+            csdr_fwrite(input_buffer_s1, sizeof(unsigned char), half_size, outfile);
+            csdr_fflush(outfile);
+            TRY_YIELD;
+        }
         for(;;)
         {
             FEOF_CHECK;
-            fread(input_buffer_s1, sizeof(float), fft_size/2, infile);
-            fread(input_buffer_s2, sizeof(float), fft_size/2, infile);
-            fwrite(input_buffer_s2, sizeof(float), fft_size/2, outfile);
-            fwrite(input_buffer_s1, sizeof(float), fft_size/2, outfile);
+            struct iovec halves[2] = { { input_buffer_s1, sizeof(float)*fft_size/2 }, { input_buffer_s2, sizeof(float)*fft_size/2 } };
+            csdr_freadv(halves, 2, infile);
+            struct iovec exchanged_halves[2] = { halves[1], halves[0] };
+            csdr_fwritev(exchanged_halves, 2, outfile);
             TRY_YIELD;
         }
     }
@@ -2053,9 +2746,9 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread(input_buffer_s1, sizeof(float), fft_size/2, infile);
-            fread(input_buffer_s2, sizeof(float), fft_size/2, infile);
-            fwrite(input_buffer_s1, sizeof(float), fft_size/2, outfile);
+            csdr_fread(input_buffer_s1, sizeof(float), fft_size/2, infile);
+            csdr_fread(input_buffer_s2, sizeof(float), fft_size/2, infile);
+            csdr_fwrite(input_buffer_s1, sizeof(float), fft_size/2, outfile);
             TRY_YIELD;
         }
     }
@@ -2079,9 +2772,9 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread(fft_compress_ima_adpcm_get_write_pointer(&job), sizeof(float), fft_size, infile);
+            csdr_fread(fft_compress_ima_adpcm_get_write_pointer(&job), sizeof(float), fft_size, infile);
             fft_compress_ima_adpcm(&job, output);
-            fwrite(output, sizeof(unsigned char), job.real_data_size/2, outfile);
+            csdr_fwrite(output, sizeof(unsigned char), job.real_data_size/2, outfile);
             TRY_YIELD;
         }
 
@@ -2089,6 +2782,63 @@ int main(int argc, char *argv[])
     }
 #endif
 
+    if(!strcmp(argv[1],"compress_fft_delta_f_u8")) //<fft_size> [step_db [keyframe_interval]]
+    {
+        if(argc<=2) return badsyntax("need required parameters (fft_size)");
+        int fft_size;
+        sscanf(argv[2],"%d",&fft_size);
+        float step_db = 1;
+        if(argc>3) sscanf(argv[3],"%g",&step_db);
+        int keyframe_interval = 50;
+        if(argc>4) sscanf(argv[4],"%d",&keyframe_interval);
+        if(step_db<0.01 || step_db>655) return badsyntax("step_db should be between 0.01 and 655");
+        if(!getbufsize(infile)) return -2; //dummy
+
+        fft_compress_delta_t job = fft_compress_delta_init(fft_size, step_db, keyframe_interval);
+        sendbufsize(fft_size,outfile);
+
+        float* input = (float*) malloc(sizeof(float) * fft_size);
+        unsigned char* output = (unsigned char*) malloc(sizeof(unsigned char) * FFT_COMPRESS_DELTA_MAX_OUTPUT(fft_size));
+        for(;;)
+        {
+            FEOF_CHECK;
+            if(csdr_fread(input, sizeof(float), fft_size, infile) != (size_t)fft_size) break;
+            int output_size = fft_compress_delta_f_u8(&job, input, output);
+            csdr_fwrite(output, sizeof(unsigned char), output_size, outfile);
+            TRY_YIELD;
+        }
+        fft_compress_delta_free(&job);
+        return 0;
+    }
+
+    if(!strcmp(argv[1],"decompress_fft_delta_u8_f")) //<fft_size>
+    {
+        if(argc<=2) return badsyntax("need required parameters (fft_size)");
+        int fft_size;
+        sscanf(argv[2],"%d",&fft_size);
+        if(!getbufsize(infile)) return -2; //dummy
+
+        fft_compress_delta_t job = fft_compress_delta_init(fft_size, 1, 1);
+        sendbufsize(fft_size,outfile);
+
+        int max_size = FFT_COMPRESS_DELTA_MAX_OUTPUT(fft_size);
+        unsigned char* input = (unsigned char*) malloc(sizeof(unsigned char) * max_size);
+        float* output = (float*) malloc(sizeof(float) * fft_size);
+        for(;;)
+        {
+            FEOF_CHECK;
+            if(csdr_fread(input, sizeof(unsigned char), 4, infile) != 4) break;
+            int length = input[0] | (input[1]<<8) | (input[2]<<16) | (input[3]<<24);
+            if(length<0 || length>max_size-4) { errhead(); fprintf(stderr, "invalid packet length: %d\n", length); return -1; }
+            if(csdr_fread(input+4, sizeof(unsigned char), length, infile) != (size_t)length) break;
+            if(fft_decompress_delta_u8_f(&job, input, length+4, output)) continue; //waiting for a keyframe
+            csdr_fwrite(output, sizeof(float), fft_size, outfile);
+            TRY_YIELD;
+        }
+        fft_compress_delta_free(&job);
+        return 0;
+    }
+
     if(!strcmp(argv[1],"fft_benchmark"))
     {
         if(argc<=3) return badsyntax("need required parameters (fft_size, fft_cycles)");
@@ -2163,9 +2913,19 @@ int main(int argc, char *argv[])
         if(!sendbufsize(getbufsize(infile),outfile)) return -2;
 
         //prepare making the filter and doing FFT on it
-        complexf* taps=(complexf*)calloc(sizeof(complexf),fft_size); //initialize to zero
-        complexf* taps_fft=(complexf*)malloc(sizeof(complexf)*fft_size);
-        fft_plan_t* plan_taps = make_fft_c2c(fft_size, taps, taps_fft, 1, 0); //forward, don't benchmark (we need this only once)
+        //there are two taps_fft buffers, so that the filter can be redesigned while the other one is in use
+        bandpass_redesign_t redesign;
+        redesign.taps=(complexf*)calloc(sizeof(complexf),fft_size); //initialize to zero
+        redesign.taps_length=taps_length;
+        redesign.window=window;
+        for(int i=0;i<2;i++)
+        {
+            redesign.taps_fft[i]=(complexf*)malloc(sizeof(complexf)*fft_size);
+            redesign.plan_taps[i]=make_fft_c2c(fft_size, redesign.taps, redesign.taps_fft[i], 1, 0); //forward, don't benchmark (we need this only once)
+        }
+        redesign.active=0;
+        redesign.ready=-1;
+        redesign.request_pending=0;
 
         //make FFT plans for continously processing the input
         complexf* input = fft_malloc(fft_size*sizeof(complexf));
@@ -2183,25 +2943,32 @@ int main(int argc, char *argv[])
 
         for(int i=input_size;i<fft_size;i++) iof(input,i)=qof(input,i)=0; //we pre-pad the input buffer with zeros
 
-        for(;;)
+        //make the initial filter: there is no output yet, so we can do it right here
+        errhead(); fprintf(stderr,"filter initialized, low_cut = %g, high_cut = %g\n",low_cut,high_cut);
+        firdes_bandpass_c(redesign.taps, taps_length, low_cut, high_cut, window);
+        fft_execute(redesign.plan_taps[redesign.active]);
+
+        if(fd)
         {
-            //make the filter
-            errhead(); fprintf(stderr,"filter initialized, low_cut = %g, high_cut = %g\n",low_cut,high_cut);
-            firdes_bandpass_c(taps, taps_length, low_cut, high_cut, window);
-            fft_execute(plan_taps);
+            pthread_mutex_init(&redesign.mutex, NULL);
+            pthread_cond_init(&redesign.cond, NULL);
+            if(pthread_create(&redesign.thread, NULL, bandpass_redesign_thread, (void*)&redesign))
+                return badsyntax("could not start filter redesign thread");
+        }
+        start_io_threads(infile, outfile, input_size*sizeof(complexf));
 
-            for(int odd=0;;odd=!odd) //the processing loop
-            {
-                FEOF_CHECK;
-                fread(input, sizeof(complexf), input_size, infile);
-                fft_plan_t* plan_inverse = (odd)?plan_inverse_2:plan_inverse_1;
-                fft_plan_t* plan_contains_last_overlap = (odd)?plan_inverse_1:plan_inverse_2; //the other
-                complexf* last_overlap = (complexf*)plan_contains_last_overlap->output + input_size; //+ fft_size - overlap_length;
-                apply_fir_fft_cc (plan_forward, plan_inverse, taps_fft, last_overlap, overlap_length);
-                int returned=fwrite(plan_inverse->output, sizeof(complexf), input_size, outfile);
-                if(read_fifo_ctl(fd,"%g %g\n",&low_cut,&high_cut)) break;
-                TRY_YIELD;
-            }
+        for(int odd=0;;odd=!odd) //the processing loop
+        {
+            FEOF_CHECK;
+            csdr_fread(input, sizeof(complexf), input_size, infile);
+            complexf* taps_fft = (fd) ? bandpass_redesign_get_taps_fft(&redesign) : redesign.taps_fft[redesign.active];
+            fft_plan_t* plan_inverse = (odd)?plan_inverse_2:plan_inverse_1;
+            fft_plan_t* plan_contains_last_overlap = (odd)?plan_inverse_1:plan_inverse_2; //the other
+            complexf* last_overlap = (complexf*)plan_contains_last_overlap->output + input_size; //+ fft_size - overlap_length;
+            apply_fir_fft_cc (plan_forward, plan_inverse, taps_fft, last_overlap, overlap_length);
+            int returned=csdr_fwrite(plan_inverse->output, sizeof(complexf), input_size, outfile);
+            if(read_fifo_ctl(fd,"%g %g\n",&low_cut,&high_cut)) bandpass_redesign_request(&redesign, low_cut, high_cut);
+            TRY_YIELD;
         }
 
     }
@@ -2217,9 +2984,9 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread(buffer_i16, sizeof(short), the_bufsize, infile);
+            csdr_fread(buffer_i16, sizeof(short), the_bufsize, infile);
             d=encode_ima_adpcm_i16_u8(buffer_i16, buffer_u8, the_bufsize, d);
-            fwrite(buffer_u8, sizeof(unsigned char), the_bufsize/2, outfile);
+            csdr_fwrite(buffer_u8, sizeof(unsigned char), the_bufsize/2, outfile);
             TRY_YIELD;
         }
     }
@@ -2232,14 +2999,45 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread(buffer_u8, sizeof(unsigned char), the_bufsize, infile);
+            csdr_fread(buffer_u8, sizeof(unsigned char), the_bufsize, infile);
             d=decode_ima_adpcm_u8_i16(buffer_u8, buffer_i16, the_bufsize, d);
-            fwrite(buffer_i16, sizeof(short), the_bufsize*2, outfile);
+            csdr_fwrite(buffer_i16, sizeof(short), the_bufsize*2, outfile);
             TRY_YIELD;
         }
     }
 #endif
 
+    if(!strcmp(argv[1],"encode_sbadpcm_s16_u8") || !strcmp(argv[1],"decode_sbadpcm_u8_s16")) //[low_bits [high_bits]]
+    {
+        int low_bits = 5, high_bits = 2;
+        if(argc>2) sscanf(argv[2],"%d",&low_bits);
+        if(argc>3) sscanf(argv[3],"%d",&high_bits);
+        if(!sbadpcm_init_check_bits(low_bits, high_bits)) return badsyntax("low_bits should be 2..5, high_bits should be 0 or 2..5");
+        int encode = !strcmp(argv[1],"encode_sbadpcm_s16_u8");
+        initialize_buffers(infile,outfile);
+        int block_count = the_bufsize/SBADPCM_BLOCK; //samples are processed in blocks of SBADPCM_BLOCK, coded into low_bits+high_bits bytes
+        int samples_size = block_count*SBADPCM_BLOCK;
+        int bytes_size = block_count*(low_bits+high_bits);
+        if(!sendbufsize(encode ? bytes_size : samples_size, outfile)) return -2;
+        sbadpcm_t codec = sbadpcm_init(low_bits, high_bits, samples_size);
+        short* samples = (short*)input_buffer;
+        for(;;)
+        {
+            FEOF_CHECK;
+            if(encode)
+            {
+                csdr_fread(samples, sizeof(short), samples_size, infile);
+                csdr_fwrite(buffer_u8, sizeof(unsigned char), sbadpcm_encode_s16_u8(&codec, samples, buffer_u8, samples_size), outfile);
+            }
+            else
+            {
+                csdr_fread(buffer_u8, sizeof(unsigned char), bytes_size, infile);
+                csdr_fwrite(samples, sizeof(short), sbadpcm_decode_u8_s16(&codec, buffer_u8, samples, bytes_size), outfile);
+            }
+            TRY_YIELD;
+        }
+    }
+
     if(!strcmp(argv[1],"flowcontrol"))
     {
         if(argc<=3) return badsyntax("need required parameters (data_rate, reads_per_seconds)");
@@ -2248,16 +3046,24 @@ int main(int argc, char *argv[])
         int reads_per_second;
         sscanf(argv[3],"%d",&reads_per_second);
         int flowcontrol_bufsize=ceil(1.*(double)data_rate/reads_per_second);
+        int use_splice = splice_setup(infile, outfile);
         if(!getbufsize(infile)) return -2;
         sendbufsize(flowcontrol_bufsize,outfile);
+        if(use_splice) flush_before_direct_io(infile, outfile);
         unsigned char* flowcontrol_buffer = (unsigned char*)malloc(sizeof(unsigned char)*flowcontrol_bufsize);
         int flowcontrol_sleep=floor(1000000./reads_per_second);
         errhead(); fprintf(stderr, "flowcontrol_bufsize = %d, flowcontrol_sleep = %d\n", flowcontrol_bufsize, flowcontrol_sleep);
         for(;;)
         {
-            FEOF_CHECK;
-            fread(flowcontrol_buffer, sizeof(unsigned char), flowcontrol_bufsize, infile);
-            fwrite(flowcontrol_buffer, sizeof(unsigned char), flowcontrol_bufsize, outfile);
+            int spliced = use_splice ? splice_forward(fileno(infile), fileno(outfile), flowcontrol_bufsize, 1) : -1;
+            if(!spliced) return 0;
+            if(spliced<0)
+            {
+                use_splice = 0;
+                FEOF_CHECK;
+                csdr_fread(flowcontrol_buffer, sizeof(unsigned char), flowcontrol_bufsize, infile);
+                csdr_fwrite(flowcontrol_buffer, sizeof(unsigned char), flowcontrol_bufsize, outfile);
+            }
             usleep(flowcontrol_sleep);
             TRY_YIELD;
         }
@@ -2302,7 +3108,7 @@ int main(int argc, char *argv[])
         fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL, 0) | O_NONBLOCK);
 
         sendbufsize(flowcontrol_readsize,outfile);
-        fflush(outfile);
+        csdr_fflush(outfile);
 
         int flowcontrol_is_buffering = 1;
         int read_return;
@@ -2350,7 +3156,7 @@ int main(int argc, char *argv[])
                 {
                     //if(thrust) fprintf(stderr, "flowcontrol: %d .. thrust\n", thrust);
                     write(STDOUT_FILENO, flowcontrol_buffer, flowcontrol_readsize);
-                    fflush(outfile);
+                    csdr_fflush(outfile);
                     //fsync(STDOUT_FILENO);
                     memmove(flowcontrol_buffer, flowcontrol_buffer+flowcontrol_readsize, flowcontrol_bufindex-flowcontrol_readsize);
                     flowcontrol_bufindex -= flowcontrol_readsize;
@@ -2367,10 +3173,13 @@ int main(int argc, char *argv[])
     if(!strcmp(argv[1],"through"))
     {
         struct timespec start_time, end_time;
+        int use_splice = splice_setup(infile, outfile);
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        if(use_splice) flush_before_direct_io(infile, outfile);
 
         int time_now_sec=0;
         int buffer_count=0;
+        unsigned long long byte_count=0;
 
         unsigned char* through_buffer;
         through_buffer = (unsigned char*)malloc(the_bufsize*sizeof(float));
@@ -2378,8 +3187,20 @@ int main(int argc, char *argv[])
 
         for(;;)
         {
-            FEOF_CHECK;
-            fread(through_buffer, sizeof(float), the_bufsize, infile);
+            int spliced = -1;
+            if(use_splice) //we only count the bytes, so the data needn't go through our buffer
+            {
+                spliced = splice_forward(fileno(infile), fileno(outfile), the_bufsize*sizeof(float), 0);
+                if(!spliced) return 0;
+                if(spliced<0) use_splice = 0; //we fall back to copying
+                else byte_count += spliced;
+            }
+            if(spliced<0)
+            {
+                FEOF_CHECK;
+                csdr_fread(through_buffer, sizeof(float), the_bufsize, infile);
+                byte_count += the_bufsize*sizeof(float);
+            }
 
             if(!time_now_sec)
             {
@@ -2392,11 +3213,11 @@ int main(int argc, char *argv[])
                 float timetaken;
                 if(time_now_sec<(timetaken=TIME_TAKEN(start_time,end_time)))
                 {
-                    fprintf( stderr, "through: %lu bytes/s, buffer #%d\n", (unsigned long)floor((float)buffer_count*the_bufsize*sizeof(float)/timetaken), buffer_count );
+                    fprintf( stderr, "through: %lu bytes/s, buffer #%d\n", (unsigned long)floor((float)byte_count/timetaken), buffer_count );
                     time_now_sec=ceil(timetaken);
                 }
             }
-            fwrite(through_buffer, sizeof(float), the_bufsize, outfile);
+            if(spliced<0) csdr_fwrite(through_buffer, sizeof(float), the_bufsize, outfile);
             buffer_count++;
             TRY_YIELD;
         }
@@ -2442,7 +3263,7 @@ int main(int argc, char *argv[])
                 *((unsigned*)(&samplerf_buf[16*i+12])) = 0;
 
             }
-            fwrite(samplerf_buf, 16, the_bufsize, outfile);
+            csdr_fwrite(samplerf_buf, 16, the_bufsize, outfile);
             TRY_YIELD;
         }
     }
@@ -2498,13 +3319,13 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread (input_buffer, sizeof(short), the_bufsize, infile);
+            csdr_fread (input_buffer, sizeof(short), the_bufsize, infile);
             for(int i=0;i<the_bufsize;i++)
             {
                 *(((short*)output_buffer)+2*i)=*(((short*)input_buffer)+i);
                 *(((short*)output_buffer)+2*i+1)=*(((short*)input_buffer)+i);
             }
-            fwrite (output_buffer, sizeof(short)*2, the_bufsize, outfile);
+            csdr_fwrite (output_buffer, sizeof(short)*2, the_bufsize, outfile);
             TRY_YIELD;
         }
     }
@@ -2513,11 +3334,11 @@ int main(int argc, char *argv[])
         if (!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
         for(;;) {
             FEOF_CHECK;
-            fread(input_buffer, sizeof(short), the_bufsize, infile);
+            csdr_fread(input_buffer, sizeof(short), the_bufsize, infile);
             for (int i = 0; i < the_bufsize / 2; i++) {
                 ((short*) output_buffer)[i] = ((short*) input_buffer)[i * 2] / 2 + ((short*) input_buffer)[i * 2 + 1] / 2;
             }
-            fwrite(output_buffer, sizeof(short), the_bufsize / 2, outfile);
+            csdr_fwrite(output_buffer, sizeof(short), the_bufsize / 2, outfile);
             TRY_YIELD;
         }
     }
@@ -2538,43 +3359,178 @@ int main(int argc, char *argv[])
         if(fd=init_fifo(argc,argv)) while(!read_fifo_ctl(fd,"%g\n",&squelch_level)) usleep(10000);
         else return badsyntax("need required parameter (--fifo <fifo>)");
         errhead(); fprintf(stderr, "initial squelch level is %g\n", squelch_level);
-        if((argc<=5)||((argc>5)&&(strcmp(argv[4],"--outfifo")))) return badsyntax("need required parameter (--outfifo <fifo>)");
-        int fd2 = open(argv[5], O_WRONLY);
-        if(fd2==-1) return badsyntax("error while opening --outfifo");
-        int flags = fcntl(fd2, F_GETFL, 0);
-        fcntl(fd2, F_SETFL, flags | O_NONBLOCK);
+        if((argc<=5)||((argc>5)&&(strcmp(argv[4],"--outfifo"))&&(strcmp(argv[4],"--telemetry")))) return badsyntax("need required parameter (--outfifo <fifo> or --telemetry <shm_file>)");
+        int use_telemetry = !strcmp(argv[4],"--telemetry");
+        int fd2 = -1;
+        if(!use_telemetry)
+        {
+            fd2 = open(argv[5], O_WRONLY);
+            if(fd2==-1) return badsyntax("error while opening --outfifo");
+            int flags = fcntl(fd2, F_GETFL, 0);
+            fcntl(fd2, F_SETFL, flags | O_NONBLOCK);
+        }
         if(argc<=6) return badsyntax("need required parameter (use_every_nth)");
         sscanf(argv[6],"%d",&decimation);
         if(decimation<=0) return badsyntax("use_every_nth <= 0 is invalid");
         if(argc<=7) return badsyntax("need required parameter (report_every_nth)");
         sscanf(argv[7],"%d",&report_every_nth);
         if(report_every_nth<=0) return badsyntax("report_every_nth <= 0 is invalid");
+        float hysteresis_db = 0;
+        int tail_blocks = 0;
+        int telemetry_records = 1024;
+        //What to output while the squelch is closed:
+        //  zeros: a block of zeros for every input block (the downstream stages process silence),
+        //  flush: a single block of zeros when the squelch closes, then nothing (the downstream stages flush their filters, then idle),
+        //  none:  nothing (the downstream stages idle).
+        enum { SQUELCH_CLOSED_ZEROS, SQUELCH_CLOSED_FLUSH, SQUELCH_CLOSED_NONE } closed_mode = SQUELCH_CLOSED_ZEROS;
+        for(int i=8;i<argc;i++)
+        {
+            if(!strcmp(argv[i],"--hysteresis") && i+1<argc) sscanf(argv[++i],"%g",&hysteresis_db);
+            else if(!strcmp(argv[i],"--tail") && i+1<argc) sscanf(argv[++i],"%d",&tail_blocks);
+            else if(!strcmp(argv[i],"--telemetry-records") && i+1<argc) sscanf(argv[++i],"%d",&telemetry_records);
+            else if(!strcmp(argv[i],"--closed") && i+1<argc)
+            {
+                i++;
+                if(!strcmp(argv[i],"zeros")) closed_mode = SQUELCH_CLOSED_ZEROS;
+                else if(!strcmp(argv[i],"flush")) closed_mode = SQUELCH_CLOSED_FLUSH;
+                else if(!strcmp(argv[i],"none")) closed_mode = SQUELCH_CLOSED_NONE;
+                else return badsyntax("--closed should be one of: zeros, flush, none");
+            }
+            else return badsyntax("invalid option");
+        }
+        if(hysteresis_db<0) return badsyntax("--hysteresis should not be negative");
+        if(tail_blocks<0) return badsyntax("--tail should not be negative");
+        if(telemetry_records<=0) return badsyntax("--telemetry-records should be positive");
+        telemetry_t telemetry;
+        float peak = 0;
+        if(use_telemetry && telemetry_create(&telemetry, argv[5], telemetry_records)) return badsyntax("error while creating --telemetry file");
+        squelch_t squelch = squelch_init(hysteresis_db, tail_blocks);
+        int was_open = 0;
         for(;;)
         {
             FEOF_CHECK;
             FREAD_C; //read input data
             power = get_power_c((complexf*)input_buffer, the_bufsize, decimation);
+            int is_open = squelch_update(&squelch, squelch_level, power);
+            if(use_telemetry) peak = MAX_M(peak, get_peak_power_c((complexf*)input_buffer, the_bufsize));
             if(report_cntr++>report_every_nth)
             {
                 report_cntr=0;
-                power_value_buf_size=snprintf(power_value_buf,100,"%g\n",power);
-                write(fd2,power_value_buf,power_value_buf_size*sizeof(char));
-          }
-            if(squelch_level==0||power>=squelch_level)
+                if(use_telemetry)
+                {
+                    //it never blocks, the readers poll the ring
+                    telemetry_write(&telemetry, power, peak, squelch_level, is_open);
+                    peak = 0;
+                }
+                else
+                {
+                    power_value_buf_size=snprintf(power_value_buf,100,"%g\n",power);
+                    write(fd2,power_value_buf,power_value_buf_size*sizeof(char));
+                }
+            }
+            if(is_open)
             {
                 //fprintf(stderr,"P");
-                fwrite(input_buffer, sizeof(complexf), the_bufsize, outfile);
+                csdr_fwrite(input_buffer, sizeof(complexf), the_bufsize, outfile);
             }
-            else
+            else if(closed_mode==SQUELCH_CLOSED_ZEROS || (closed_mode==SQUELCH_CLOSED_FLUSH && was_open))
             {
                 //fprintf(stderr,"S");
-                fwrite(zerobuf, sizeof(complexf), the_bufsize, outfile);
+                csdr_fwrite(zerobuf, sizeof(complexf), the_bufsize, outfile);
             }
+            //If we stop writing, the data in the stdio buffer should not wait for the squelch to open again.
+            if(!is_open && was_open && closed_mode!=SQUELCH_CLOSED_ZEROS) csdr_fflush(outfile);
+            was_open = is_open;
             if(read_fifo_ctl(fd,"%g\n",&squelch_level)) { errhead(); fprintf(stderr, "new squelch level is %g\n", squelch_level); }
             TRY_YIELD;
         }
     }
 
+    if(!strcmp(argv[1],"tone_squelch_ff"))
+    {
+        if(argc<=4) return badsyntax("need required parameters (sample_rate, ctcss|dcs, tone_frequency|octal_code)");
+        float sample_rate;
+        sscanf(argv[2],"%g",&sample_rate);
+        if(sample_rate<1000) return badsyntax("sample_rate should be at least 1000");
+        int is_dcs = !strcmp(argv[3],"dcs");
+        if(!is_dcs && strcmp(argv[3],"ctcss")) return badsyntax("squelch type should be one of: ctcss, dcs");
+        int tone = -1;
+        float threshold = 0.1;
+        int dcs_code = 0;
+        int dcs_inverted = 0;
+        if(is_dcs)
+        {
+            if(sscanf(argv[4],"%o",&dcs_code)!=1 || dcs_code<0 || dcs_code>0777) return badsyntax("DCS code should be 3 octal digits");
+            if(argc>5)
+            {
+                if(!strcmp(argv[5],"i")) dcs_inverted = 1;
+                else if(strcmp(argv[5],"n")) return badsyntax("DCS polarity should be n (normal) or i (inverted)");
+            }
+            errhead(); fprintf(stderr,"DCS code = %03o%c, codeword = %06x\n", dcs_code, (dcs_inverted)?'I':'N', dcs_codeword(dcs_code));
+        }
+        else
+        {
+            float frequency;
+            sscanf(argv[4],"%g",&frequency);
+            if((tone=ctcss_tone_index(frequency))<0) return badsyntax("tone_frequency should be a standard CTCSS tone");
+            if(argc>5) sscanf(argv[5],"%g",&threshold);
+            errhead(); fprintf(stderr,"CTCSS tone = %.1f Hz, threshold = %g\n", ctcss_tones[tone], threshold);
+        }
+
+        if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        subaudio_decimator_t decimator = subaudio_decimator_init(sample_rate, the_bufsize);
+        float* subaudio = (float*)malloc(sizeof(float)*(the_bufsize/decimator.decimation+1));
+        ctcss_detector_t ctcss = ctcss_detector_init(decimator.output_rate, 0.4, threshold);
+        dcs_decoder_t dcs = dcs_decoder_init(decimator.output_rate, dcs_code, dcs_inverted);
+        //The subaudio signal is removed from the output with a highpass filter.
+        biquad_t highpass_sections[4];
+        int highpass_num_sections = iirdes_chebyshev1(highpass_sections, 8, IIR_HIGHPASS, 300/sample_rate, 0, 0.5);
+        sos_filter_t highpass = sos_filter_init(highpass_sections, highpass_num_sections, 1);
+        int last_detected_tone = -1;
+        for(;;)
+        {
+            FEOF_CHECK;
+            FREAD_R;
+            int subaudio_size = subaudio_decimator_ff(&decimator, input_buffer, subaudio, the_bufsize);
+            int open;
+            if(is_dcs) open = dcs_decoder_ff(&dcs, subaudio, subaudio_size);
+            else
+            {
+                int detected_tone = ctcss_detector_ff(&ctcss, subaudio, subaudio_size);
+                if(detected_tone!=last_detected_tone)
+                {
+                    errhead();
+                    if(detected_tone>=0) fprintf(stderr,"detected CTCSS tone: %.1f Hz\n", ctcss_tones[detected_tone]);
+                    else fprintf(stderr,"no CTCSS tone\n");
+                    last_detected_tone = detected_tone;
+                }
+                open = (detected_tone==tone);
+            }
+            sos_filter_ff(&highpass, input_buffer, output_buffer, the_bufsize);
+            if(!open) memset(output_buffer, 0, sizeof(float)*the_bufsize);
+            FWRITE_R;
+            TRY_YIELD;
+        }
+    }
+
+    if(!strcmp(argv[1],"telemetry_dump"))
+    {
+        if(argc<=2) return badsyntax("need required parameter (shm_file)");
+        telemetry_t telemetry;
+        //wait for the writer to create the file
+        while(telemetry_open(&telemetry, argv[2])) usleep(100000);
+        telemetry_record_t record;
+        for(;;)
+        {
+            int result = telemetry_read(&telemetry, &record);
+            if(result==1) fprintf(outfile, "%llu %llu.%09llu %g %g %g %d\n", (unsigned long long)record.sequence-1,
+                (unsigned long long)record.timestamp_ns/1000000000, (unsigned long long)record.timestamp_ns%1000000000,
+                record.power, record.peak, record.squelch_level, record.squelch_open);
+            else if(result==-1) { errhead(); fprintf(stderr, "records lost\n"); }
+            else { csdr_fflush(outfile); usleep(10000); }
+        }
+    }
+
 #ifdef LIBCSDR_GPL
 
     /*
@@ -2625,11 +3581,11 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             //overlapped FFT
             for(int i=0;i<ddc.overlap_length;i++) input[i]=input[i+ddc.input_size];
-            fread(input+ddc.overlap_length, sizeof(complexf), ddc.input_size, infile);
+            csdr_fread(input+ddc.overlap_length, sizeof(complexf), ddc.input_size, infile);
             //apply_window_c(input,windowed,ddc.fft_size,window);
             memcpy(windowed, input, ddc.fft_size*sizeof(complexf)); //we can switch off windows; TODO: it is likely that we shouldn't apply a window to both the FFT and the filter.
             fft_execute(plan);
-            fwrite(output, sizeof(complexf), ddc.fft_size, outfile);
+            csdr_fwrite(output, sizeof(complexf), ddc.fft_size, outfile);
             TRY_YIELD;
         }
     }
@@ -2671,6 +3627,8 @@ int main(int argc, char *argv[])
         fastddc_print(&ddc,"fastddc_inv_cc");
 
         if(!initialize_buffers(infile,outfile)) return -2;
+        stream_shift(shift_rate);
+        stream_resample(1./decimation);
         sendbufsize(ddc.post_input_size/ddc.post_decimation, outfile); //TODO not exactly correct
 
         //prepare making the filter and doing FFT on it
@@ -2698,12 +3656,13 @@ int main(int argc, char *argv[])
 
         decimating_shift_addition_status_t shift_stat;
         bzero(&shift_stat, sizeof(shift_stat));
+        start_io_threads(infile, outfile, ddc.fft_size*sizeof(complexf));
         for(;;)
         {
             FEOF_CHECK;
-            fread(input, sizeof(complexf), ddc.fft_size, infile);
+            csdr_fread(input, sizeof(complexf), ddc.fft_size, infile);
             shift_stat = fastddc_inv_cc(input, output, &ddc, plan_inverse, taps_fft, shift_stat);
-            fwrite(output, sizeof(complexf), shift_stat.output_size, outfile);
+            csdr_fwrite(output, sizeof(complexf), shift_stat.output_size, outfile);
             //fprintf(stderr, "ss os = %d\n", shift_stat.output_size);
             TRY_YIELD;
             if(read_fifo_ctl(fd,"%g\n",&shift_rate)) break;
@@ -2728,7 +3687,7 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread(fft_input, sizeof(complexf), fft_size, infile);
+            csdr_fread(fft_input, sizeof(complexf), fft_size, infile);
             printf("fftdata=[");
             //we have to swap the two parts of the array to get a valid spectrum
             for(int i=fft_size/2;i<fft_size;i++) printf("(%g)+(%g)*i ",iof(fft_input,i),qof(fft_input,i));
@@ -2755,27 +3714,63 @@ int main(int argc, char *argv[])
     if(!strcmp(argv[1],"psk31_varicode_decoder_u8_u8"))
     {
         unsigned long long status_shr = 0;
-        unsigned char output;
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
-        unsigned char i=0;
+        unsigned char* output_u8 = (unsigned char*)output_buffer;
+        for(;;)
+        {
+            size_t input_size = csdr_fread_available(buffer_u8, the_bufsize, infile);
+            if(!input_size) return 0;
+            int output_size = psk31_varicode_decoder_u8_u8(&status_shr, buffer_u8, (char*)output_u8, input_size);
+            if(output_size) { csdr_fwrite(output_u8, 1, output_size, outfile); csdr_fflush(outfile); }
+            TRY_YIELD;
+        }
+    }
+
+#ifdef USE_FFTW
+    if(!strcmp(argv[1],"psk31_skimmer_f_u8")) //<sample_rate> [low_freq high_freq [threshold_db]]
+    {
+        if(argc<=2) return badsyntax("need required parameter (sample_rate)");
+        float sample_rate;
+        sscanf(argv[2],"%g",&sample_rate);
+        float low_freq = 100, high_freq = 3000, threshold_db = 10;
+        if(argc>3)
+        {
+            if(argc<=4) return badsyntax("need both low_freq and high_freq");
+            sscanf(argv[3],"%g",&low_freq);
+            sscanf(argv[4],"%g",&high_freq);
+        }
+        if(argc>5) sscanf(argv[5],"%g",&threshold_db);
+        if(low_freq<0 || high_freq>sample_rate/2 || low_freq>=high_freq) return badsyntax("low_freq and high_freq should be within 0 and sample_rate/2");
+        if(!(sample_rate>=PSK31_SKIMMER_MIN_SAMPLE_RATE && sample_rate<=PSK31_SKIMMER_MAX_SAMPLE_RATE))
+            return badsyntax("sample_rate should be between " STRINGIFY_VALUE(PSK31_SKIMMER_MIN_SAMPLE_RATE) " and " STRINGIFY_VALUE(PSK31_SKIMMER_MAX_SAMPLE_RATE));
+
+        if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
+        psk31_skimmer_t skimmer = psk31_skimmer_init(sample_rate, low_freq, high_freq, threshold_db, 64, the_bufsize);
+        int output_max_size = the_bufsize*4;
+        char* output = (char*)malloc(output_max_size);
+        errhead(); fprintf(stderr,"decoding PSK31 between %g Hz and %g Hz\n", low_freq, high_freq);
         for(;;)
         {
-            if((output=psk31_varicode_decoder_push(&status_shr, getchar()))) { putchar(output); fflush(outfile); }
-            if(i++) continue; //do the following at every 256th execution of the loop body:
             FEOF_CHECK;
+            FREAD_R;
+            int output_size = psk31_skimmer_f_u8(&skimmer, input_buffer, the_bufsize, output, output_max_size);
+            if(output_size) { csdr_fwrite(output, 1, output_size, outfile); csdr_fflush(outfile); }
             TRY_YIELD;
         }
     }
+#endif
 
     if(!strcmp(argv[1],"invert_u8_u8"))
     {
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
-        unsigned char i=0;
+        unsigned char* output_u8 = (unsigned char*)output_buffer;
         for(;;)
         {
-            putchar(!getchar());
-            if(i++) continue; //do the following at every 256th execution of the loop body:
-            FEOF_CHECK;
+            size_t input_size = csdr_fread_available(buffer_u8, the_bufsize, infile);
+            if(!input_size) return 0;
+            int output_size = 0;
+            for(size_t j=0;j<input_size;j++) output_u8[output_size++] = !buffer_u8[j];
+            if(output_size) { csdr_fwrite(output_u8, 1, output_size, outfile); csdr_fflush(outfile); }
             TRY_YIELD;
         }
     }
@@ -2783,14 +3778,14 @@ int main(int argc, char *argv[])
     if(!strcmp(argv[1],"rtty_line_decoder_u8_u8"))
     {
         static rtty_baudot_decoder_t status_baudot; //created on .bss -> initialized to 0
-        unsigned char output;
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
-        unsigned char i=0;
+        unsigned char* output_u8 = (unsigned char*)output_buffer;
         for(;;)
         {
-            if((output=rtty_baudot_decoder_push(&status_baudot, getchar()))) { putchar(output); fflush(outfile); }
-            if(i++) continue; //do the following at every 256th execution of the loop body:
-            FEOF_CHECK;
+            size_t input_size = csdr_fread_available(buffer_u8, the_bufsize, infile);
+            if(!input_size) return 0;
+            int output_size = rtty_baudot_decoder_u8_u8(&status_baudot, buffer_u8, (char*)output_u8, input_size);
+            if(output_size) { csdr_fwrite(output_u8, 1, output_size, outfile); csdr_fflush(outfile); }
             TRY_YIELD;
         }
     }
@@ -2800,12 +3795,14 @@ int main(int argc, char *argv[])
         unsigned char fig_mode = 0;
         unsigned char output;
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
-        unsigned char i=0;
+        unsigned char* output_u8 = (unsigned char*)output_buffer;
         for(;;)
         {
-            if((output=rtty_baudot_decoder_lookup(&fig_mode, getchar()))) { putchar(output); fflush(outfile); }
-            if(i++) continue; //do the following at every 256th execution of the loop body:
-            FEOF_CHECK;
+            size_t input_size = csdr_fread_available(buffer_u8, the_bufsize, infile);
+            if(!input_size) return 0;
+            int output_size = 0;
+            for(size_t j=0;j<input_size;j++) if((output=rtty_baudot_decoder_lookup(&fig_mode, buffer_u8[j]))) output_u8[output_size++] = output;
+            if(output_size) { csdr_fwrite(output_u8, 1, output_size, outfile); csdr_fflush(outfile); }
             TRY_YIELD;
         }
     }
@@ -2854,14 +3851,14 @@ int main(int argc, char *argv[])
             if(serial.input_used)
             {
                 memmove(input_buffer, input_buffer+serial.input_used, sizeof(float)*(the_bufsize-serial.input_used));
-                fread(input_buffer+(the_bufsize-serial.input_used), sizeof(float), serial.input_used, infile);
+                csdr_fread(input_buffer+(the_bufsize-serial.input_used), sizeof(float), serial.input_used, infile);
             }
-            else fread(input_buffer, sizeof(float), the_bufsize, infile); //should happen only on the first run
+            else csdr_fread(input_buffer, sizeof(float), the_bufsize, infile); //should happen only on the first run
             serial_line_decoder_f_u8(&serial,input_buffer, (unsigned char*)output_buffer, the_bufsize);
             //printf("now in | ");
             if(serial.input_used==0) { errhead(); fprintf(stderr, "error: serial_line_decoder_f_u8() got stuck.\n"); return -3; }
             //printf("now out %d | ", serial.output_size);
-            fwrite(output_buffer, sizeof(unsigned char), serial.output_size, outfile);
+            csdr_fwrite(output_buffer, sizeof(unsigned char), serial.output_size, outfile);
             TRY_YIELD;
         }
     }
@@ -2899,9 +3896,9 @@ int main(int argc, char *argv[])
             FREAD_C;
             //fprintf(stderr, "| i");
             // pll_cc(&pll, (complexf*)input_buffer, output_buffer, NULL, the_bufsize);
-            // fwrite(output_buffer, sizeof(float), the_bufsize, outfile);
+            // csdr_fwrite(output_buffer, sizeof(float), the_bufsize, outfile);
             pll_cc(&pll, (complexf*)input_buffer, NULL, (complexf*)output_buffer, the_bufsize);
-            fwrite(output_buffer, sizeof(complexf), the_bufsize, outfile);
+            csdr_fwrite(output_buffer, sizeof(complexf), the_bufsize, outfile);
             //fprintf(stderr, "| o");
             TRY_YIELD;
         }
@@ -2914,9 +3911,12 @@ int main(int argc, char *argv[])
         //if(algorithm == TIMING_RECOVERY_ALGORITHM_DEFAULT) 
         //  fprintf(stderr,"#timing_recovery_cc: algorithm = %s\n",timing_recovery_get_string_from_algorithm(algorithm));
         if(argc<=3) return badsyntax("need required parameter (decimation factor)");
-        int decimation;
-        sscanf(argv[3],"%d",&decimation);
-        if(decimation<=4 || decimation&3) return badsyntax("decimation factor should be a positive integer divisible by 4");
+        int fractional = timing_recovery_is_fractional(algorithm);
+        float samples_per_symbol;
+        sscanf(argv[3],"%g",&samples_per_symbol);
+        int decimation = samples_per_symbol;
+        if(fractional && samples_per_symbol<2) return badsyntax("decimation factor should be at least 2");
+        if(!fractional && (decimation!=samples_per_symbol || decimation<=4 || decimation&3)) return badsyntax("decimation factor should be a positive integer divisible by 4");
 
         float loop_gain = 0.5;
         if(argc>4) sscanf(argv[4],"%f",&loop_gain);
@@ -2936,6 +3936,7 @@ int main(int argc, char *argv[])
             debug_every_nth = atoi(argv[7+add_q]);
             if(debug_every_nth<0) return badsyntax("debug_every_nth should be >= 0");
         }
+        if(fractional && debug_every_nth>=0) return badsyntax("--octave and --octave_save work only with the GARDNER and EARLYLATE algorithms");
         if(octave_save)
         {
             if(argc>=9+add_q) octave_save_path = argv[8+add_q]; 
@@ -2954,9 +3955,12 @@ int main(int argc, char *argv[])
         if(output_indexes) { errhead(); fprintf(stderr, "--output_indexes mode\n"); }
 
         if(!initialize_buffers(infile,outfile)) return -2;
+        stream_resample(1./samples_per_symbol); //one output sample per symbol, also for the fractional algorithms
         sendbufsize(the_bufsize/decimation, outfile);
 
-        timing_recovery_state_t state = timing_recovery_init(algorithm, decimation, add_q, loop_gain, max_error, debug_every_nth, octave_save_path);
+        timing_recovery_state_t state = (fractional) ?
+            timing_recovery_fractional_init(algorithm, samples_per_symbol, add_q, loop_gain, max_error) :
+            timing_recovery_init(algorithm, decimation, add_q, loop_gain, max_error, debug_every_nth, octave_save_path);
 
         FREAD_C;
         unsigned buffer_start_counter = 0;
@@ -2965,18 +3969,18 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             timing_recovery_cc((complexf*)input_buffer, (complexf*)output_buffer, the_bufsize, timing_error, (int*)sampled_indexes, &state);
             //fprintf(stderr, "trcc is=%d, os=%d, ip=%d\n",the_bufsize, state.output_size, state.input_processed);
-            if(timing_error) fwrite(timing_error, sizeof(float), state.output_size, outfile);
+            if(timing_error) csdr_fwrite(timing_error, sizeof(float), state.output_size, outfile);
             else if(sampled_indexes) 
             {
                 for(int i=0;i<state.output_size;i++) sampled_indexes[i]+=buffer_start_counter;
-                fwrite(sampled_indexes, sizeof(unsigned), state.output_size, outfile);
+                csdr_fwrite(sampled_indexes, sizeof(unsigned), state.output_size, outfile);
             }
-            else fwrite(output_buffer, sizeof(complexf), state.output_size, outfile);
+            else csdr_fwrite(output_buffer, sizeof(complexf), state.output_size, outfile);
             TRY_YIELD;
             //fprintf(stderr, "state.input_processed = %d\n", state.input_processed);
             buffer_start_counter+=state.input_processed;
             memmove((complexf*)input_buffer,((complexf*)input_buffer)+state.input_processed,(the_bufsize-state.input_processed)*sizeof(complexf)); //memmove lets the source and destination overlap
-            fread(((complexf*)input_buffer)+(the_bufsize-state.input_processed), sizeof(complexf), state.input_processed, infile);
+            csdr_fread(((complexf*)input_buffer)+(the_bufsize-state.input_processed), sizeof(complexf), state.input_processed, infile);
             //fprintf(stderr,"iskip=%d state.output_size=%d start=%x target=%x skipcount=%x \n",state.input_processed,state.output_size,input_buffer, ((complexf*)input_buffer)+(BIG_BUFSIZE-state.input_processed),(BIG_BUFSIZE-state.input_processed));
         }
     }
@@ -2998,7 +4002,7 @@ int main(int argc, char *argv[])
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
         for(;;)
         {
-            fread(read_buf, sizeof(complexf), samples_to_plot, infile);
+            csdr_fread(read_buf, sizeof(complexf), samples_to_plot, infile);
             printf("N = %d;\nisig = [", samples_to_plot);
             for(int i=0;i<samples_to_plot;i++) printf("%f ", iof(read_buf, i));
             printf("];\nqsig = [");
@@ -3007,11 +4011,11 @@ int main(int argc, char *argv[])
             if(mode2d) printf("subplot(2,1,1);\nplot(zsig,isig);\nsubplot(2,1,2);\nplot(zsig,qsig);\n");
             else printf("plot3(isig,zsig,qsig);\n");
             //printf("xlim([-1 1]);\nzlim([-1 1]);\n");
-            fflush(outfile);
+            csdr_fflush(outfile);
             //if(fseek(infile, (out_of_n_samples - samples_to_plot)*sizeof(complexf), SEEK_CUR)<0) { perror("fseek error"); return -3; } //this cannot be used on infile
             for(int seek_remain=out_of_n_samples-samples_to_plot;seek_remain>0;seek_remain-=samples_to_plot)
             {
-                fread(read_buf, sizeof(complexf), MIN_M(samples_to_plot,seek_remain), infile);
+                csdr_fread(read_buf, sizeof(complexf), MIN_M(samples_to_plot,seek_remain), infile);
             }
             FEOF_CHECK;
             TRY_YIELD;
@@ -3031,7 +4035,7 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread((unsigned char*)input_buffer, sizeof(unsigned char), the_bufsize, infile);
+            csdr_fread((unsigned char*)input_buffer, sizeof(unsigned char), the_bufsize, infile);
             psk_modulator_u8_c((unsigned char*)input_buffer, (complexf*)output_buffer, the_bufsize, n_psk);
             FWRITE_C;
             TRY_YIELD;
@@ -3054,9 +4058,9 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread((void*)local_input_buffer, sizeof(unsigned char), the_bufsize*sample_size_bytes, infile);
+            csdr_fread((void*)local_input_buffer, sizeof(unsigned char), the_bufsize*sample_size_bytes, infile);
             duplicate_samples_ntimes_u8_u8(local_input_buffer, local_output_buffer, the_bufsize*sample_size_bytes, sample_size_bytes, ntimes);
-            fwrite((void*)local_output_buffer, sizeof(unsigned char), the_bufsize*sample_size_bytes*ntimes, outfile);
+            csdr_fwrite((void*)local_output_buffer, sizeof(unsigned char), the_bufsize*sample_size_bytes*ntimes, outfile);
             TRY_YIELD;
         }
     }
@@ -3068,6 +4072,7 @@ int main(int argc, char *argv[])
         sscanf(argv[2],"%d",&interpolation);    
         if(interpolation<=0) return badsyntax("interpolation should be >0"); 
         if(!initialize_buffers(infile,outfile)) return -2;
+        stream_resample(interpolation);
         sendbufsize(the_bufsize*interpolation, outfile);
         complexf* local_output_buffer = (complexf*)malloc(sizeof(complexf)*the_bufsize*interpolation);
         complexf last_input;
@@ -3078,7 +4083,7 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             FREAD_C;
             last_input = psk31_interpolate_sine_cc((complexf*)input_buffer, local_output_buffer, the_bufsize, interpolation, last_input);
-            fwrite((void*)local_output_buffer, sizeof(complexf), the_bufsize*interpolation, outfile);
+            csdr_fwrite((void*)local_output_buffer, sizeof(complexf), the_bufsize*interpolation, outfile);
             TRY_YIELD;
         }
     }
@@ -3092,9 +4097,9 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread((void*)local_input_buffer, sizeof(unsigned char), the_bufsize, infile);
+            csdr_fread((void*)local_input_buffer, sizeof(unsigned char), the_bufsize, infile);
             pack_bits_1to8_u8_u8(local_input_buffer, local_output_buffer, the_bufsize);
-            fwrite((void*)local_output_buffer, sizeof(unsigned char), the_bufsize*8, outfile);
+            csdr_fwrite((void*)local_output_buffer, sizeof(unsigned char), the_bufsize*8, outfile);
             TRY_YIELD;
         }
     }
@@ -3107,9 +4112,9 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread((void*)local_input_buffer, sizeof(unsigned char), 8, infile);
+            csdr_fread((void*)local_input_buffer, sizeof(unsigned char), 8, infile);
             unsigned char c = pack_bits_8to1_u8_u8(local_input_buffer);
-            fwrite(&c, sizeof(unsigned char), 1, outfile);
+            csdr_fwrite(&c, sizeof(unsigned char), 1, outfile);
             TRY_YIELD;
         }
     }
@@ -3123,15 +4128,15 @@ int main(int argc, char *argv[])
         int input_processed;
         unsigned char* local_input_buffer = (unsigned char*)malloc(sizeof(unsigned char)*the_bufsize);
         unsigned char* local_output_buffer = (unsigned char*)malloc(sizeof(unsigned char)*output_max_size);
-        fread((void*)local_input_buffer, sizeof(unsigned char), the_bufsize, infile);
+        csdr_fread((void*)local_input_buffer, sizeof(unsigned char), the_bufsize, infile);
         for(;;)
         {
             psk31_varicode_encoder_u8_u8(local_input_buffer, local_output_buffer, the_bufsize, output_max_size, &input_processed, &output_size);
             //fprintf(stderr, "os = %d\n", output_size);
-            fwrite((void*)local_output_buffer, sizeof(unsigned char), output_size, outfile);
+            csdr_fwrite((void*)local_output_buffer, sizeof(unsigned char), output_size, outfile);
             FEOF_CHECK;
             memmove(local_input_buffer, local_input_buffer+input_processed, the_bufsize-input_processed); 
-            fread(input_buffer+the_bufsize-input_processed, sizeof(unsigned char), input_processed, infile);
+            csdr_fread(input_buffer+the_bufsize-input_processed, sizeof(unsigned char), input_processed, infile);
             TRY_YIELD;
         }
     }
@@ -3144,7 +4149,7 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread((void*)local_input_buffer, sizeof(unsigned char), the_bufsize, infile);
+            csdr_fread((void*)local_input_buffer, sizeof(unsigned char), the_bufsize, infile);
             for(int i=0;i<the_bufsize;i++) printf("%02x ", local_input_buffer[i]);
             TRY_YIELD;
         }
@@ -3161,9 +4166,9 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread((void*)local_input_buffer, sizeof(unsigned char), the_bufsize, infile);
+            csdr_fread((void*)local_input_buffer, sizeof(unsigned char), the_bufsize, infile);
             state = differential_codec(local_input_buffer, local_output_buffer, the_bufsize, differential_codec_encode, state);
-            fwrite((void*)local_output_buffer, sizeof(unsigned char), the_bufsize, outfile);
+            csdr_fwrite((void*)local_output_buffer, sizeof(unsigned char), the_bufsize, outfile);
             TRY_YIELD;
         }
     }
@@ -3216,16 +4221,16 @@ int main(int argc, char *argv[])
             bpsk_costas_loop_cc((complexf*)input_buffer, (complexf*)output_buffer, the_bufsize, 
                     buffer_output_error, buffer_output_dphase, buffer_output_nco, 
                     &state);
-            if(output_error) fwrite(buffer_output_error, sizeof(float), the_bufsize, outfile);
-            else if(output_dphase) fwrite(buffer_output_dphase, sizeof(float), the_bufsize, outfile);
-            else if(output_nco) fwrite(buffer_output_nco, sizeof(complexf), the_bufsize, outfile);
+            if(output_error) csdr_fwrite(buffer_output_error, sizeof(float), the_bufsize, outfile);
+            else if(output_dphase) csdr_fwrite(buffer_output_dphase, sizeof(float), the_bufsize, outfile);
+            else if(output_nco) csdr_fwrite(buffer_output_nco, sizeof(complexf), the_bufsize, outfile);
             else 
             {
                 if(output_combined) 
                 {
-                    fwrite(buffer_output_error, sizeof(float), the_bufsize, file_output_error);
-                    fwrite(buffer_output_dphase, sizeof(float), the_bufsize, file_output_dphase);
-                    fwrite(buffer_output_nco, sizeof(complexf), the_bufsize, file_output_nco);
+                    csdr_fwrite(buffer_output_error, sizeof(float), the_bufsize, file_output_error);
+                    csdr_fwrite(buffer_output_dphase, sizeof(float), the_bufsize, file_output_dphase);
+                    csdr_fwrite(buffer_output_nco, sizeof(complexf), the_bufsize, file_output_nco);
                 }
                 FWRITE_C;
             }
@@ -3305,7 +4310,7 @@ int main(int argc, char *argv[])
 
         //Wait forever, so that octave won't close just after popping up the window.
         //You can close it with ^C.
-        if(octave) { fflush(outfile); getchar(); }
+        if(octave) { csdr_fflush(outfile); getchar(); }
         return 0;
     }
  
@@ -3344,11 +4349,11 @@ int main(int argc, char *argv[])
         {
             FEOF_CHECK;
             output_size = apply_fir_cc((complexf*)input_buffer, (complexf*)output_buffer, the_bufsize, taps, taps_length);
-            fwrite(output_buffer, sizeof(complexf), output_size, outfile);
+            csdr_fwrite(output_buffer, sizeof(complexf), output_size, outfile);
             //fprintf(stderr, "os = %d, is = %d\n", output_size, the_bufsize);
             TRY_YIELD;
             memmove((complexf*)input_buffer,((complexf*)input_buffer)+output_size,(the_bufsize-output_size)*sizeof(complexf)); 
-            fread(((complexf*)input_buffer)+(the_bufsize-output_size), sizeof(complexf), output_size, infile);
+            csdr_fread(((complexf*)input_buffer)+(the_bufsize-output_size), sizeof(complexf), output_size, infile);
         }
     }
 
@@ -3366,7 +4371,7 @@ int main(int argc, char *argv[])
             repeat_buffer[i]=current_val;
             TRY_YIELD;
         }
-        for(;;) fwrite(repeat_buffer, sizeof(unsigned char), argc-2, outfile);
+        for(;;) csdr_fwrite(repeat_buffer, sizeof(unsigned char), argc-2, outfile);
     }
 
     if(!strcmp(argv[1], "awgn_cc"))
@@ -3401,7 +4406,7 @@ int main(int argc, char *argv[])
             {
                 for(;;)
                 {
-                    int items_read=fread(awgn_buffer, sizeof(complexf), the_bufsize, awgnfile);
+                    int items_read=csdr_fread(awgn_buffer, sizeof(complexf), the_bufsize, awgnfile);
                     if(items_read<the_bufsize) rewind(awgnfile);
                     else break;
                 }
@@ -3476,7 +4481,7 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             FREAD_R; //doesn't count, reads 4 bytes per sample anyway
             float nv = normalized_timing_variance_u32_f((unsigned*)input_buffer, temp_buffer, the_bufsize, samples_per_symbol, initial_sample_offset, debug_print);
-            fwrite(&nv, sizeof(float), 1, outfile);
+            csdr_fwrite(&nv, sizeof(float), 1, outfile);
             errhead(); fprintf(stderr, "normalized variance = %f\n", nv);
             TRY_YIELD;
         }
@@ -3489,7 +4494,7 @@ int main(int argc, char *argv[])
         sscanf(argv[2],"%d",&n_zero_samples);
         if(!sendbufsize(initialize_buffers(infile,outfile),outfile)) return -2;
         float* zeros=(float*)calloc(sizeof(float),n_zero_samples);
-        fwrite(zeros, sizeof(float), n_zero_samples, outfile);
+        csdr_fwrite(zeros, sizeof(float), n_zero_samples, outfile);
         clone_(the_bufsize, infile, outfile);
     }
 
@@ -3547,11 +4552,11 @@ int main(int argc, char *argv[])
         {
             FEOF_CHECK;
             output_size = apply_real_fir_cc((complexf*)input_buffer, (complexf*)output_buffer, the_bufsize, taps, num_taps);
-            fwrite(output_buffer, sizeof(complexf), output_size, outfile);
+            csdr_fwrite(output_buffer, sizeof(complexf), output_size, outfile);
             //fprintf(stderr, "os = %d, is = %d, num_taps = %d\n", output_size, the_bufsize, num_taps);
             TRY_YIELD;
             memmove((complexf*)input_buffer,((complexf*)input_buffer)+output_size,(the_bufsize-output_size)*sizeof(complexf)); 
-            fread(((complexf*)input_buffer)+(the_bufsize-output_size), sizeof(complexf), output_size, infile);
+            csdr_fread(((complexf*)input_buffer)+(the_bufsize-output_size), sizeof(complexf), output_size, infile);
         }
     }
 
@@ -3577,14 +4582,16 @@ int main(int argc, char *argv[])
         int interpolation = 0;
         if(argc<=2) return badsyntax("required parameter <interpolation> is missing.");
         sscanf(argv[2],"%d",&interpolation);
-        if(!sendbufsize(interpolation*initialize_buffers(infile,outfile), outfile)) return -2;
+        if(!initialize_buffers(infile,outfile)) return -2;
+        stream_resample(interpolation);
+        sendbufsize(interpolation*the_bufsize, outfile);
         complexf* plainint_output_buffer = (complexf*)malloc(sizeof(complexf)*the_bufsize*interpolation);
         for(;;)
         {
             FEOF_CHECK;
             FREAD_C;
             plain_interpolate_cc((complexf*)input_buffer, plainint_output_buffer, the_bufsize, interpolation);
-            fwrite(plainint_output_buffer, sizeof(float)*2, the_bufsize*interpolation, outfile);
+            csdr_fwrite(plainint_output_buffer, sizeof(float)*2, the_bufsize*interpolation, outfile);
             TRY_YIELD;
         }
         return 0;
@@ -3599,7 +4606,7 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             FREAD_C;
             dbpsk_decoder_c_u8((complexf*)input_buffer, local_output_buffer, the_bufsize);
-            fwrite(local_output_buffer, sizeof(unsigned char), the_bufsize, outfile);
+            csdr_fwrite(local_output_buffer, sizeof(unsigned char), the_bufsize, outfile);
             TRY_YIELD;
         }
         return 0;
@@ -3629,10 +4636,10 @@ int main(int argc, char *argv[])
         {
             FEOF_CHECK;
             output_size=bfsk_demod_cf((complexf*)input_buffer, output_buffer, the_bufsize, mark_filter, space_filter, filter_length);
-            fwrite(output_buffer, sizeof(float), output_size, outfile);
+            csdr_fwrite(output_buffer, sizeof(float), output_size, outfile);
             TRY_YIELD;
             memmove((complexf*)input_buffer,((complexf*)input_buffer)+output_size,(the_bufsize-output_size)*sizeof(complexf));
-            fread(((complexf*)input_buffer)+(the_bufsize-output_size), sizeof(complexf), output_size, infile);
+            csdr_fread(((complexf*)input_buffer)+(the_bufsize-output_size), sizeof(complexf), output_size, infile);
         }
         return 0;
     }
@@ -3675,14 +4682,14 @@ int main(int argc, char *argv[])
         for(;;)
         {
             FEOF_CHECK;
-            fread(async_tee_buffers+(the_bufsize*current_buffer_read_cntr), sizeof(unsigned char), the_bufsize, infile);
-            fwrite(async_tee_buffers+(the_bufsize*current_buffer_read_cntr++), sizeof(unsigned char), the_bufsize, outfile);
+            csdr_fread(async_tee_buffers+(the_bufsize*current_buffer_read_cntr), sizeof(unsigned char), the_bufsize, infile);
+            csdr_fwrite(async_tee_buffers+(the_bufsize*current_buffer_read_cntr++), sizeof(unsigned char), the_bufsize, outfile);
             if(current_buffer_read_cntr>=num_buffers) current_buffer_read_cntr = 0;
             if(current_buffer_read_cntr==current_buffer_write_cntr) { errhead(); fprintf(stderr, "circular buffer overflow (read pointer gone past write pointer)\n"); }
             //errhead(); fprintf(stderr, "new fwrites\n");
             while(current_buffer_write_cntr!=current_buffer_read_cntr)
             {
-                int result = fwrite(async_tee_buffers+(the_bufsize*current_buffer_write_cntr)+current_byte_write_cntr, sizeof(unsigned char), the_bufsize-current_byte_write_cntr, teefile);
+                int result = csdr_fwrite(async_tee_buffers+(the_bufsize*current_buffer_write_cntr)+current_byte_write_cntr, sizeof(unsigned char), the_bufsize-current_byte_write_cntr, teefile);
                 if(!result) { errhead(); fprintf(stderr, "\t fwrite tee zero, next turn\n"); break; }
                 current_byte_write_cntr += result;
                 //errhead(); fprintf(stderr, "\tfwrite tee, current_byte_write_cntr = %d, current_buffer_write_cntr = %d, current_buffer_read_cntr = %d\n", 
@@ -3802,18 +4809,18 @@ int main(int argc, char *argv[])
             FEOF_CHECK;
             if(every_n_samples>fft_in_size)
             {
-                fread(input, sizeof(float), fft_in_size, infile);
+                csdr_fread(input, sizeof(float), fft_in_size, infile);
                 //skipping samples before next FFT (but fseek doesn't work for pipes)
                 for(int seek_remain=every_n_samples-fft_in_size;seek_remain>0;seek_remain-=the_bufsize)
                 {
-                    fread(temp_f, sizeof(complexf), MIN_M(the_bufsize,seek_remain), infile);
+                    csdr_fread(temp_f, sizeof(complexf), MIN_M(the_bufsize,seek_remain), infile);
                 }
             }
             else
             {
                 //overlapped FFT
                 for(int i=0;i<fft_in_size-every_n_samples;i++) input[i]=input[i+every_n_samples];
-                fread(input+fft_in_size-every_n_samples, sizeof(float), every_n_samples, infile);
+                csdr_fread(input+fft_in_size-every_n_samples, sizeof(float), every_n_samples, infile);
             }
             //apply_window_c(input,windowed,fft_size,window);
             apply_precalculated_window_f(input,windowed,fft_in_size,windowt);
@@ -3833,7 +4840,7 @@ int main(int argc, char *argv[])
                 );
 #endif
             }
-            else fwrite(output, sizeof(complexf), fft_out_size, outfile);
+            else csdr_fwrite(output, sizeof(complexf), fft_out_size, outfile);
             TRY_YIELD;
         }
     }
@@ -3890,10 +4897,16 @@ int main(int argc, char *argv[])
         unsigned char* output_buffer = (unsigned char*)malloc(sizeof(unsigned char)*values_after);
         int input_index = 0;
         int valid_values = 0;
+        unsigned char read_buffer[1024]; //we take the input in chunks, csdr_fread_available() returns as soon as there is something
+        size_t read_size = 0, read_position = 0;
         for(;;)
         {
-            FEOF_CHECK;
-            unsigned char cchar = input_buffer[input_index++]=(unsigned char)fgetc(infile);
+            if(read_position==read_size)
+            {
+                read_position = 0;
+                if(!(read_size = csdr_fread_available(read_buffer, sizeof(read_buffer), infile))) return 0;
+            }
+            unsigned char cchar = input_buffer[input_index++]=read_buffer[read_position++];
             if(valid_values<pattern_values_length) { valid_values++; continue; }
             if(input_index>=pattern_values_length) input_index=0;
             int match=1;
@@ -3930,8 +4943,11 @@ int main(int argc, char *argv[])
             {
                 valid_values = 0;
                 //fprintf(stderr,"matched!\n");
-                fread(output_buffer, sizeof(unsigned char), values_after, infile);
-                fwrite(output_buffer, sizeof(unsigned char), values_after, outfile);
+                int from_read_buffer = MIN_M(values_after, (int)(read_size-read_position));
+                memcpy(output_buffer, read_buffer+read_position, from_read_buffer);
+                read_position += from_read_buffer;
+                csdr_fread(output_buffer+from_read_buffer, sizeof(unsigned char), values_after-from_read_buffer, infile);
+                csdr_fwrite(output_buffer, sizeof(unsigned char), values_after, outfile);
             }
             TRY_YIELD;
         }
@@ -0,0 +1,730 @@
+/*
+This software is part of libcsdr, a set of simple DSP routines for
+Software Defined Radio.
+
+Copyright (c) 2014, Andras Retzler <randras@sdr.hu>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL ANDRAS RETZLER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include "csdr_io.h"
+#ifdef HAVE_LINUX_IO_URING_H
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#define CSDR_IO_EOF 1
+#define CSDR_IO_ERROR 2
+#define CSDR_IO_MAX_IOV 16
+
+csdr_io_backend_t csdr_io_backend = CSDR_IO_FD;
+static unsigned char csdr_io_flags[CSDR_IO_MAX_FD];
+
+#define CSDR_IO_MAX_UNREAD 64
+static struct csdr_io_unread_s
+{
+    unsigned char data[CSDR_IO_MAX_UNREAD];
+    size_t size;
+} csdr_io_unread_buffers[CSDR_IO_MAX_FD];
+
+static size_t csdr_io_transfer_status(int fd, struct iovec* iov, int iovcnt, int write, unsigned char* status);
+static size_t csdr_io_transfer(int fd, struct iovec* iov, int iovcnt, int write);
+
+#ifdef HAVE_LINUX_IO_URING_H
+/*
+  io_uring backend.
+  We don't depend on liburing, the ring is set up with the system calls directly. There is a single ring for all the streams,
+  and each stream has at most one read and one write in flight. The user_data of a request is fd*2+CSDR_URING_READ/WRITE.
+*/
+
+#define CSDR_URING_ENTRIES 8
+#define CSDR_URING_READ 0
+#define CSDR_URING_WRITE 1
+
+typedef struct csdr_uring_stream_s
+{
+    int disabled; //for non-blocking descriptors, or if a request could not be submitted, we stay with readv() / writev()
+    int no_read_ahead;
+    char* read_buffer;
+    size_t read_buffer_size;
+    size_t read_start, read_end; //data that has been read ahead, but not yet passed to the caller
+    size_t last_read_size;
+    int read_in_flight, read_completed, read_result;
+    char* write_buffer;
+    size_t write_buffer_size;
+    size_t write_start, write_end; //data that is being written
+    int write_in_flight, write_completed, write_result;
+} csdr_uring_stream_t;
+
+static struct csdr_uring_s
+{
+    int fd;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+} csdr_uring = { .fd = -1 };
+
+static csdr_uring_stream_t* csdr_uring_streams[CSDR_IO_MAX_FD];
+
+static int csdr_uring_setup()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, CSDR_URING_ENTRIES, &params);
+    if(fd<0) return -1;
+    //We need kernel 5.6 for IORING_OP_READ / WRITE at the current file position.
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_RW_CUR_POS)) { close(fd); return -1; }
+    size_t sq_size = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+    char* ring = mmap(NULL, (sq_size>cq_size) ? sq_size : cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(ring==MAP_FAILED) { close(fd); return -1; }
+    struct io_uring_sqe* sqes = mmap(NULL, params.sq_entries*sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(sqes==MAP_FAILED) { close(fd); return -1; }
+    csdr_uring.fd = fd;
+    csdr_uring.sq_tail = (unsigned*)(ring + params.sq_off.tail);
+    csdr_uring.sq_mask = (unsigned*)(ring + params.sq_off.ring_mask);
+    csdr_uring.sq_array = (unsigned*)(ring + params.sq_off.array);
+    csdr_uring.cq_head = (unsigned*)(ring + params.cq_off.head);
+    csdr_uring.cq_tail = (unsigned*)(ring + params.cq_off.tail);
+    csdr_uring.cq_mask = (unsigned*)(ring + params.cq_off.ring_mask);
+    csdr_uring.cqes = (struct io_uring_cqe*)(ring + params.cq_off.cqes);
+    csdr_uring.sqes = sqes;
+    return 0;
+}
+
+static int csdr_uring_submit(int fd, int op, void* buffer, size_t size)
+{
+    //It returns 0 if the request is in flight, and -1 if it could not be submitted (then the caller should do the transfer itself).
+    unsigned tail = *csdr_uring.sq_tail;
+    unsigned index = tail & *csdr_uring.sq_mask;
+    struct io_uring_sqe* sqe = &csdr_uring.sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = (op==CSDR_URING_WRITE) ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long)buffer;
+    sqe->len = size;
+    sqe->off = -1; //at the current file position
+    sqe->user_data = fd*2+op;
+    csdr_uring.sq_array[index] = index;
+    __atomic_store_n(csdr_uring.sq_tail, tail+1, __ATOMIC_RELEASE);
+    int result;
+    while((result = syscall(__NR_io_uring_enter, csdr_uring.fd, 1, 0, 0, NULL, 0))<0 && errno==EINTR);
+    if(result==1) return 0;
+    __atomic_store_n(csdr_uring.sq_tail, tail, __ATOMIC_RELEASE); //the kernel hasn't taken it, so we take it back
+    return -1;
+}
+
+static int csdr_uring_complete()
+{
+    //It waits for the next completion, and passes its result to the stream that it belongs to. It returns -1 if we can't wait.
+    unsigned head = *csdr_uring.cq_head;
+    while(head==__atomic_load_n(csdr_uring.cq_tail, __ATOMIC_ACQUIRE))
+        if(syscall(__NR_io_uring_enter, csdr_uring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0)<0 && errno!=EINTR) return -1;
+    struct io_uring_cqe* cqe = &csdr_uring.cqes[head & *csdr_uring.cq_mask];
+    csdr_uring_stream_t* stream = csdr_uring_streams[cqe->user_data/2];
+    if(cqe->user_data%2==CSDR_URING_WRITE) { stream->write_result = cqe->res; stream->write_completed = 1; }
+    else { stream->read_result = cqe->res; stream->read_completed = 1; }
+    __atomic_store_n(csdr_uring.cq_head, head+1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static csdr_uring_stream_t* csdr_uring_stream(int fd)
+{
+    csdr_uring_stream_t* stream = csdr_uring_streams[fd];
+    if(!stream)
+    {
+        stream = csdr_uring_streams[fd] = (csdr_uring_stream_t*)calloc(1, sizeof(csdr_uring_stream_t));
+        int flags = fcntl(fd, F_GETFL);
+        stream->disabled = (flags<0) || (flags & O_NONBLOCK);
+    }
+    return stream;
+}
+
+static void csdr_uring_wait_read(int fd, csdr_uring_stream_t* stream)
+{
+    if(!stream->read_in_flight) return;
+    while(!stream->read_completed) if(csdr_uring_complete()) { stream->read_result = -EIO; break; }
+    stream->read_in_flight = stream->read_completed = 0;
+    int result = stream->read_result;
+    if(result>0) stream->read_end = result;
+    else if(result==0) csdr_io_flags[fd] |= CSDR_IO_EOF;
+    else if(result!=-EINTR && result!=-EAGAIN) csdr_io_flags[fd] |= CSDR_IO_ERROR;
+}
+
+static void csdr_uring_write_directly(int fd, csdr_uring_stream_t* stream)
+{
+    //If a request can't be submitted, we write the rest of the buffer with writev(), and don't use io_uring for this stream any more.
+    struct iovec iov = { stream->write_buffer+stream->write_start, stream->write_end-stream->write_start };
+    stream->write_start += csdr_io_transfer(fd, &iov, 1, 1);
+    stream->disabled = 1;
+}
+
+static void csdr_uring_wait_write(int fd, csdr_uring_stream_t* stream)
+{
+    while(stream->write_in_flight)
+    {
+        while(!stream->write_completed) if(csdr_uring_complete()) { stream->write_result = -EIO; break; }
+        stream->write_completed = 0;
+        int result = stream->write_result;
+        if(result>0) stream->write_start += result;
+        if(result>0 || result==-EINTR || result==-EAGAIN)
+        {
+            //short write, we continue with the rest
+            if(stream->write_start<stream->write_end && !csdr_uring_submit(fd, CSDR_URING_WRITE, stream->write_buffer+stream->write_start, stream->write_end-stream->write_start)) continue;
+            if(stream->write_start<stream->write_end) csdr_uring_write_directly(fd, stream);
+        }
+        else
+        {
+            csdr_io_flags[fd] |= CSDR_IO_ERROR;
+            if(result==-EPIPE) raise(SIGPIPE); //a write() would have raised it, and then we would have exited
+        }
+        stream->write_in_flight = 0;
+    }
+}
+
+static size_t csdr_uring_readv(int fd, csdr_uring_stream_t* stream, struct iovec* iov, int iovcnt)
+{
+    size_t requested = 0, bytes = 0, position = 0;
+    for(int i=0;i<iovcnt;i++) requested += iov[i].iov_len;
+    int i = 0;
+    //first we take what has been read ahead
+    while(i<iovcnt)
+    {
+        if(position==iov[i].iov_len) { i++; position = 0; continue; }
+        if(stream->read_start==stream->read_end)
+        {
+            if(!stream->read_in_flight) break;
+            csdr_uring_wait_read(fd, stream);
+            if(stream->read_start==stream->read_end) break;
+        }
+        size_t size = stream->read_end-stream->read_start;
+        if(size>iov[i].iov_len-position) size = iov[i].iov_len-position;
+        memcpy((char*)iov[i].iov_base+position, stream->read_buffer+stream->read_start, size);
+        stream->read_start += size;
+        position += size;
+        bytes += size;
+    }
+    //then we read the rest directly
+    if(i<iovcnt && !(csdr_io_flags[fd] & (CSDR_IO_EOF | CSDR_IO_ERROR)))
+    {
+        struct iovec iov_left[CSDR_IO_MAX_IOV];
+        memcpy(iov_left, iov+i, sizeof(struct iovec)*(iovcnt-i));
+        iov_left[0].iov_base = (char*)iov_left[0].iov_base + position;
+        iov_left[0].iov_len -= position;
+        bytes += csdr_io_transfer(fd, iov_left, iovcnt-i, 0);
+    }
+    //we expect that the caller will ask for a block of the same size again, so we start reading it
+    if(!stream->no_read_ahead && requested==stream->last_read_size && !stream->read_in_flight && stream->read_start==stream->read_end
+        && !(csdr_io_flags[fd] & (CSDR_IO_EOF | CSDR_IO_ERROR)))
+    {
+        if(stream->read_buffer_size<requested) stream->read_buffer = (char*)realloc(stream->read_buffer, stream->read_buffer_size = requested);
+        stream->read_start = stream->read_end = 0;
+        if(!csdr_uring_submit(fd, CSDR_URING_READ, stream->read_buffer, requested)) stream->read_in_flight = 1;
+        else stream->disabled = 1; //we will read with readv()
+    }
+    stream->last_read_size = requested;
+    return bytes;
+}
+
+static size_t csdr_uring_writev(int fd, csdr_uring_stream_t* stream, struct iovec* iov, int iovcnt)
+{
+    csdr_uring_wait_write(fd, stream);
+    if(csdr_io_flags[fd] & CSDR_IO_ERROR) return 0;
+    size_t size = 0;
+    for(int i=0;i<iovcnt;i++) size += iov[i].iov_len;
+    if(!size) return 0;
+    if(stream->write_buffer_size<size) stream->write_buffer = (char*)realloc(stream->write_buffer, stream->write_buffer_size = size);
+    stream->write_end = 0;
+    for(int i=0;i<iovcnt;i++)
+    {
+        memcpy(stream->write_buffer+stream->write_end, iov[i].iov_base, iov[i].iov_len);
+        stream->write_end += iov[i].iov_len;
+    }
+    stream->write_start = 0;
+    if(!csdr_uring_submit(fd, CSDR_URING_WRITE, stream->write_buffer, size)) stream->write_in_flight = 1;
+    else
+    {
+        csdr_uring_write_directly(fd, stream);
+        return stream->write_start;
+    }
+    return size;
+}
+
+static void csdr_uring_flush_all()
+{
+    //The requests still in the ring would be cancelled when we exit, so we wait for the writes.
+    for(int fd=0;fd<CSDR_IO_MAX_FD;fd++) if(csdr_uring_streams[fd]) csdr_uring_wait_write(fd, csdr_uring_streams[fd]);
+}
+#endif
+
+int csdr_io_set_backend(char* name)
+{
+    //It returns -1 if the backend is unknown, and -2 if it is not available (then we stay with CSDR_IO_FD).
+    if(!strcmp(name,"stdio")) csdr_io_backend = CSDR_IO_STDIO;
+    else if(!strcmp(name,"fd")) csdr_io_backend = CSDR_IO_FD;
+    else if(!strcmp(name,"uring"))
+    {
+#ifdef HAVE_LINUX_IO_URING_H
+        if(csdr_uring.fd<0)
+        {
+            if(csdr_uring_setup()) return -2;
+            atexit(csdr_uring_flush_all);
+        }
+        csdr_io_backend = CSDR_IO_URING;
+#else
+        return -2;
+#endif
+    }
+    else return -1;
+    return 0;
+}
+
+void csdr_io_no_read_ahead(FILE* stream)
+{
+    //The caller will also access the file descriptor directly (e.g. with splice()), so we shouldn't take any data from it in advance.
+#ifdef HAVE_LINUX_IO_URING_H
+    int fd = fileno(stream);
+    if(fd>=0 && fd<CSDR_IO_MAX_FD) csdr_uring_stream(fd)->no_read_ahead = 1;
+#endif
+}
+
+int csdr_io_unread(FILE* stream, const void* ptr, size_t size)
+{
+    //The data will be returned again by the next reads, before anything else from the stream (like ungetc() for a whole block).
+    int fd = fileno(stream);
+    if(fd<0 || fd>=CSDR_IO_MAX_FD) return -1;
+    struct csdr_io_unread_s* u = &csdr_io_unread_buffers[fd];
+    if(u->size+size>CSDR_IO_MAX_UNREAD) return -1;
+    memmove(u->data+size, u->data, u->size);
+    memcpy(u->data, ptr, size);
+    u->size += size;
+    return 0;
+}
+
+size_t csdr_io_unread_size(FILE* stream)
+{
+    int fd = fileno(stream);
+    return (fd>=0 && fd<CSDR_IO_MAX_FD) ? csdr_io_unread_buffers[fd].size : 0;
+}
+
+static size_t csdr_io_take_unread(FILE* stream, struct iovec** iov, int* iovcnt)
+{
+    //It fills the beginning of iov from the data given back by csdr_io_unread(), and advances iov past what has been filled.
+    int fd = fileno(stream);
+    if(fd<0 || fd>=CSDR_IO_MAX_FD) return 0;
+    struct csdr_io_unread_s* u = &csdr_io_unread_buffers[fd];
+    size_t taken = 0;
+    while(u->size && *iovcnt)
+    {
+        size_t size = ((*iov)->iov_len<u->size) ? (*iov)->iov_len : u->size;
+        memcpy((*iov)->iov_base, u->data, size);
+        memmove(u->data, u->data+size, u->size-size);
+        u->size -= size;
+        taken += size;
+        if(size<(*iov)->iov_len) { (*iov)->iov_base = (char*)(*iov)->iov_base + size; (*iov)->iov_len -= size; }
+        else { (*iov)++; (*iovcnt)--; }
+    }
+    return taken;
+}
+
+/*
+  Reader and writer threads.
+  After csdr_io_start_threads(), a reader thread reads the input into a ring of blocks, and a writer thread writes the output from
+  another ring, so that the thread of the command only computes. csdr_fread() and csdr_fwrite() copy the data from / to the rings.
+  Each ring has a single producer and a single consumer, so the indices are simply stored atomically, and a mutex is only taken
+  when one of them has to sleep because the ring is empty or full.
+*/
+
+#define CSDR_IO_RING_BLOCKS 4
+#define CSDR_IO_RING_SPIN 1000 //we check this many times before going to sleep
+
+typedef struct csdr_io_ring_s
+{
+    int fd;
+    char* data; //CSDR_IO_RING_BLOCKS × block_size
+    size_t sizes[CSDR_IO_RING_BLOCKS]; //the number of bytes in each block
+    size_t block_size;
+    unsigned head; //the number of blocks published by the producer
+    unsigned tail; //the number of blocks released by the consumer
+    size_t position; //in the block that the thread of the command is reading / filling
+    int closed; //CSDR_IO_EOF or CSDR_IO_ERROR if there won't be more data from the reader, or if the writer has failed
+    int writer;
+    int waiting; //the number of threads sleeping on cond
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+} csdr_io_ring_t;
+
+static csdr_io_ring_t* csdr_io_rings[CSDR_IO_MAX_FD];
+
+static int csdr_io_ring_published(csdr_io_ring_t* r) { return __atomic_load_n(&r->head, __ATOMIC_SEQ_CST)!=r->tail; }
+static int csdr_io_ring_readable(csdr_io_ring_t* r) { return csdr_io_ring_published(r) || __atomic_load_n(&r->closed, __ATOMIC_SEQ_CST); }
+static int csdr_io_ring_writable(csdr_io_ring_t* r) { return r->head-__atomic_load_n(&r->tail, __ATOMIC_SEQ_CST)<CSDR_IO_RING_BLOCKS; }
+static int csdr_io_ring_drained(csdr_io_ring_t* r) { return r->head==__atomic_load_n(&r->tail, __ATOMIC_SEQ_CST); }
+
+static void csdr_io_ring_wait(csdr_io_ring_t* r, int (*ready)(csdr_io_ring_t*))
+{
+    for(int i=0;i<CSDR_IO_RING_SPIN;i++) if(ready(r)) return;
+    pthread_mutex_lock(&r->mutex);
+    __atomic_add_fetch(&r->waiting, 1, __ATOMIC_SEQ_CST);
+    while(!ready(r)) pthread_cond_wait(&r->cond, &r->mutex);
+    __atomic_sub_fetch(&r->waiting, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&r->mutex);
+}
+
+static void csdr_io_ring_wake(csdr_io_ring_t* r)
+{
+    //The other side increments waiting before checking the indices for the last time, so either it sees our change, or we see that it waits.
+    //Both sides wait on the same cond for different reasons, so we wake all of them.
+    if(!__atomic_load_n(&r->waiting, __ATOMIC_SEQ_CST)) return;
+    pthread_mutex_lock(&r->mutex);
+    pthread_cond_broadcast(&r->cond);
+    pthread_mutex_unlock(&r->mutex);
+}
+
+static void csdr_io_ring_publish(csdr_io_ring_t* r, size_t size)
+{
+    r->sizes[r->head%CSDR_IO_RING_BLOCKS] = size;
+    __atomic_store_n(&r->head, r->head+1, __ATOMIC_SEQ_CST);
+    csdr_io_ring_wake(r);
+}
+
+static void csdr_io_ring_release(csdr_io_ring_t* r)
+{
+    __atomic_store_n(&r->tail, r->tail+1, __ATOMIC_SEQ_CST);
+    csdr_io_ring_wake(r);
+}
+
+static void* csdr_io_reader_thread(void* arg)
+{
+    csdr_io_ring_t* r = (csdr_io_ring_t*)arg;
+    for(;;)
+    {
+        csdr_io_ring_wait(r, csdr_io_ring_writable);
+        //we pass on whatever a single read() returns, so that a slow input isn't delayed until a whole block is there
+        ssize_t result = read(r->fd, r->data+(r->head%CSDR_IO_RING_BLOCKS)*r->block_size, r->block_size);
+        if(result<0 && errno==EINTR) continue;
+        if(result<=0)
+        {
+            __atomic_store_n(&r->closed, (result) ? CSDR_IO_ERROR : CSDR_IO_EOF, __ATOMIC_SEQ_CST);
+            csdr_io_ring_wake(r);
+            return NULL;
+        }
+        csdr_io_ring_publish(r, result);
+    }
+}
+
+static void* csdr_io_writer_thread(void* arg)
+{
+    csdr_io_ring_t* r = (csdr_io_ring_t*)arg;
+    for(;;)
+    {
+        csdr_io_ring_wait(r, csdr_io_ring_published);
+        unsigned index = r->tail%CSDR_IO_RING_BLOCKS;
+        struct iovec iov = { r->data+index*r->block_size, r->sizes[index] };
+        //after an error, we still release the blocks, so that the thread of the command doesn't wait for us forever
+        //(the error is only kept in r->closed, csdr_io_flags belong to the thread of the command)
+        unsigned char status = 0;
+        if(!__atomic_load_n(&r->closed, __ATOMIC_SEQ_CST) && csdr_io_transfer_status(r->fd, &iov, 1, 1, &status)<r->sizes[index])
+            __atomic_store_n(&r->closed, CSDR_IO_ERROR, __ATOMIC_SEQ_CST);
+        csdr_io_ring_release(r);
+    }
+    return NULL;
+}
+
+static size_t csdr_io_ring_readv(csdr_io_ring_t* r, struct iovec* iov, int iovcnt)
+{
+    size_t bytes = 0;
+    for(int i=0;i<iovcnt;i++) for(size_t position=0;position<iov[i].iov_len;)
+    {
+        if(!csdr_io_ring_readable(r)) csdr_io_ring_wait(r, csdr_io_ring_readable);
+        if(!csdr_io_ring_published(r)) { csdr_io_flags[r->fd] |= __atomic_load_n(&r->closed, __ATOMIC_SEQ_CST); return bytes; }
+        unsigned index = r->tail%CSDR_IO_RING_BLOCKS;
+        size_t size = r->sizes[index]-r->position;
+        if(size>iov[i].iov_len-position) size = iov[i].iov_len-position;
+        memcpy((char*)iov[i].iov_base+position, r->data+index*r->block_size+r->position, size);
+        position += size;
+        bytes += size;
+        if((r->position += size)==r->sizes[index]) { r->position = 0; csdr_io_ring_release(r); }
+    }
+    return bytes;
+}
+
+static size_t csdr_io_ring_writev(csdr_io_ring_t* r, struct iovec* iov, int iovcnt)
+{
+    if(__atomic_load_n(&r->closed, __ATOMIC_SEQ_CST)) { csdr_io_flags[r->fd] |= CSDR_IO_ERROR; return 0; }
+    size_t bytes = 0;
+    for(int i=0;i<iovcnt;i++) for(size_t position=0;position<iov[i].iov_len;)
+    {
+        if(!r->position) csdr_io_ring_wait(r, csdr_io_ring_writable);
+        size_t size = r->block_size-r->position;
+        if(size>iov[i].iov_len-position) size = iov[i].iov_len-position;
+        memcpy(r->data+(r->head%CSDR_IO_RING_BLOCKS)*r->block_size+r->position, (char*)iov[i].iov_base+position, size);
+        position += size;
+        bytes += size;
+        if((r->position += size)==r->block_size) { r->position = 0; csdr_io_ring_publish(r, r->block_size); }
+    }
+    //the last, partially filled block also goes out now, we don't keep the output back
+    if(r->position) { csdr_io_ring_publish(r, r->position); r->position = 0; }
+    return bytes;
+}
+
+static csdr_io_ring_t* csdr_io_ring(FILE* stream)
+{
+    int fd = fileno(stream);
+    return (fd>=0 && fd<CSDR_IO_MAX_FD) ? csdr_io_rings[fd] : NULL;
+}
+
+static void csdr_io_ring_flush(csdr_io_ring_t* r)
+{
+    if(r->writer) csdr_io_ring_wait(r, csdr_io_ring_drained);
+}
+
+static csdr_io_ring_t* csdr_io_ring_start(FILE* stream, size_t block_size, void* (*thread)(void*))
+{
+    int fd = fileno(stream);
+    if(fd<0 || fd>=CSDR_IO_MAX_FD) return NULL;
+    if(csdr_io_rings[fd]) return csdr_io_rings[fd];
+    csdr_io_ring_t* r = (csdr_io_ring_t*)calloc(1, sizeof(csdr_io_ring_t));
+    r->fd = fd;
+    r->block_size = block_size;
+    r->writer = (thread==csdr_io_writer_thread);
+    r->data = (char*)malloc(block_size*CSDR_IO_RING_BLOCKS);
+    pthread_mutex_init(&r->mutex, NULL);
+    pthread_cond_init(&r->cond, NULL);
+    if(pthread_create(&r->thread, NULL, thread, (void*)r)) { free(r->data); free(r); return NULL; }
+    return csdr_io_rings[fd] = r;
+}
+
+static void csdr_io_flush_threads()
+{
+    //the writer thread would be stopped when we exit, so we wait for it to write everything
+    for(int fd=0;fd<CSDR_IO_MAX_FD;fd++) if(csdr_io_rings[fd]) csdr_io_ring_flush(csdr_io_rings[fd]);
+}
+
+int csdr_io_start_threads(FILE* infile, FILE* outfile, size_t block_size)
+{
+    //It returns 0 on success. It should be called before anything is read ahead from infile.
+    //It can be called again (e.g. after the command has been reconfigured), then it does nothing.
+    //The threads read the file descriptor directly, and with the stdio backend, stdio may have already buffered input from it.
+    if(csdr_io_backend==CSDR_IO_STDIO) return -1;
+    csdr_fflush(outfile);
+    if(!csdr_io_ring_start(infile, block_size, csdr_io_reader_thread)) return -1;
+    if(!csdr_io_ring(outfile))
+    {
+        if(!csdr_io_ring_start(outfile, block_size, csdr_io_writer_thread)) return -1;
+        atexit(csdr_io_flush_threads);
+    }
+    return 0;
+}
+
+static int csdr_io_fd(FILE* stream)
+{
+    //It returns the file descriptor if we can use it directly, or -1 if we should go through stdio.
+    if(csdr_io_backend==CSDR_IO_STDIO) return -1;
+    int fd = fileno(stream);
+    return (fd>=0 && fd<CSDR_IO_MAX_FD) ? fd : -1;
+}
+
+static size_t csdr_io_transfer_status(int fd, struct iovec* iov, int iovcnt, int write, unsigned char* status)
+{
+    //It moves all the data described by iov, continuing after short reads and writes, and returns the number of bytes moved.
+    //It stops early only on EOF or on an error (including EAGAIN on a non-blocking descriptor), and sets CSDR_IO_EOF or
+    //CSDR_IO_ERROR in *status then. The iov array is modified.
+    size_t total = 0;
+    for(;;)
+    {
+        while(iovcnt && !iov->iov_len) { iov++; iovcnt--; }
+        if(!iovcnt) break;
+        ssize_t result = (write) ? writev(fd, iov, iovcnt) : readv(fd, iov, iovcnt);
+        if(result<0 && errno==EINTR) continue;
+        if(result<0 || (result==0 && write)) { *status |= CSDR_IO_ERROR; break; }
+        if(result==0) { *status |= CSDR_IO_EOF; break; }
+        total += result;
+        while(iovcnt && result >= iov->iov_len) { result -= iov->iov_len; iov++; iovcnt--; }
+        if(iovcnt) { iov->iov_base = (char*)iov->iov_base + result; iov->iov_len -= result; }
+    }
+    return total;
+}
+
+static size_t csdr_io_transfer(int fd, struct iovec* iov, int iovcnt, int write)
+{
+    return csdr_io_transfer_status(fd, iov, iovcnt, write, &csdr_io_flags[fd]);
+}
+
+size_t csdr_fread(void* ptr, size_t size, size_t count, FILE* stream)
+{
+    if(!size || !count) return 0;
+    struct iovec iov = { ptr, size*count };
+    return csdr_freadv(&iov, 1, stream)/size;
+}
+
+size_t csdr_fread_available(void* ptr, size_t size, FILE* stream)
+{
+    //Unlike csdr_fread(), it doesn't wait for the whole block: it returns up to size bytes as soon as there is at least one,
+    //and 0 only on EOF or on an error. It is meant for the byte-oriented commands, where a slow input shouldn't be delayed.
+    if(!size) return 0;
+    size_t unread = csdr_io_unread_size(stream);
+    if(unread) return csdr_fread(ptr, 1, (unread<size) ? unread : size, stream);
+    int fd = csdr_io_fd(stream);
+    if(fd<0 || csdr_io_ring(stream)) return csdr_fread(ptr, 1, 1, stream); //stdio or the reader thread may have more, we can't ask them
+#ifdef HAVE_LINUX_IO_URING_H
+    csdr_uring_stream_t* uring_stream = (csdr_io_backend==CSDR_IO_URING) ? csdr_uring_streams[fd] : NULL;
+    if(uring_stream)
+    {
+        //what has been read ahead goes first
+        csdr_uring_wait_read(fd, uring_stream);
+        size_t buffered = uring_stream->read_end-uring_stream->read_start;
+        if(buffered)
+        {
+            if(buffered>size) buffered = size;
+            memcpy(ptr, uring_stream->read_buffer+uring_stream->read_start, buffered);
+            uring_stream->read_start += buffered;
+            return buffered;
+        }
+    }
+#endif
+    if(csdr_io_flags[fd] & (CSDR_IO_EOF | CSDR_IO_ERROR)) return 0;
+    ssize_t result;
+    while((result = read(fd, ptr, size))<0 && errno==EINTR);
+    if(result==0) csdr_io_flags[fd] |= CSDR_IO_EOF;
+    if(result<0) csdr_io_flags[fd] |= CSDR_IO_ERROR;
+    return (result>0) ? result : 0;
+}
+
+size_t csdr_fwrite(const void* ptr, size_t size, size_t count, FILE* stream)
+{
+    if(!size || !count) return 0;
+    struct iovec iov = { (void*)ptr, size*count };
+    return csdr_fwritev(&iov, 1, stream)/size;
+}
+
+size_t csdr_freadv(struct iovec* iov, int iovcnt, FILE* stream)
+{
+    //It returns the number of bytes read. Whatever could not be filled is zeroed.
+    if(iovcnt>CSDR_IO_MAX_IOV) return 0;
+    if(csdr_io_unread_size(stream))
+    {
+        struct iovec iov_left[CSDR_IO_MAX_IOV];
+        struct iovec* iov_next = iov_left;
+        memcpy(iov_left, iov, sizeof(struct iovec)*iovcnt);
+        size_t taken = csdr_io_take_unread(stream, &iov_next, &iovcnt);
+        return taken + ((iovcnt) ? csdr_freadv(iov_next, iovcnt, stream) : 0);
+    }
+    int fd = csdr_io_fd(stream);
+    csdr_io_ring_t* ring = csdr_io_ring(stream);
+    size_t bytes = 0;
+    if(ring) bytes = csdr_io_ring_readv(ring, iov, iovcnt);
+    else if(fd<0) for(int i=0;i<iovcnt;i++)
+    {
+        size_t result = fread(iov[i].iov_base, 1, iov[i].iov_len, stream);
+        bytes += result;
+        if(result<iov[i].iov_len) break;
+    }
+#ifdef HAVE_LINUX_IO_URING_H
+    else if(csdr_io_backend==CSDR_IO_URING && !csdr_uring_stream(fd)->disabled) bytes = csdr_uring_readv(fd, csdr_uring_stream(fd), iov, iovcnt);
+#endif
+    else
+    {
+        struct iovec iov_left[CSDR_IO_MAX_IOV];
+        memcpy(iov_left, iov, sizeof(struct iovec)*iovcnt);
+        bytes = csdr_io_transfer(fd, iov_left, iovcnt, 0);
+    }
+    size_t skip = bytes;
+    for(int i=0;i<iovcnt;i++)
+    {
+        if(skip<iov[i].iov_len) memset((char*)iov[i].iov_base+skip, 0, iov[i].iov_len-skip);
+        skip = (skip>iov[i].iov_len) ? skip-iov[i].iov_len : 0;
+    }
+    return bytes;
+}
+
+size_t csdr_fwritev(struct iovec* iov, int iovcnt, FILE* stream)
+{
+    //It returns the number of bytes written.
+    if(iovcnt>CSDR_IO_MAX_IOV) return 0;
+    csdr_io_ring_t* ring = csdr_io_ring(stream);
+    if(ring) { fflush(stream); return csdr_io_ring_writev(ring, iov, iovcnt); }
+    int fd = csdr_io_fd(stream);
+    size_t bytes = 0;
+    if(fd<0) for(int i=0;i<iovcnt;i++)
+    {
+        size_t result = fwrite(iov[i].iov_base, 1, iov[i].iov_len, stream);
+        bytes += result;
+        if(result<iov[i].iov_len) break;
+    }
+    else
+    {
+        fflush(stream); //whatever has been written through stdio should go before the block
+#ifdef HAVE_LINUX_IO_URING_H
+        if(csdr_io_backend==CSDR_IO_URING)
+        {
+            if(!csdr_uring_stream(fd)->disabled) return csdr_uring_writev(fd, csdr_uring_stream(fd), iov, iovcnt);
+            csdr_uring_wait_write(fd, csdr_uring_stream(fd)); //if it has just been disabled
+        }
+#endif
+        struct iovec iov_left[CSDR_IO_MAX_IOV];
+        memcpy(iov_left, iov, sizeof(struct iovec)*iovcnt);
+        bytes = csdr_io_transfer(fd, iov_left, iovcnt, 1);
+    }
+    return bytes;
+}
+
+int csdr_feof(FILE* stream)
+{
+    int fd = fileno(stream);
+    if(csdr_io_unread_size(stream)) return 0;
+    return feof(stream) || (fd>=0 && fd<CSDR_IO_MAX_FD && (csdr_io_flags[fd]&CSDR_IO_EOF));
+}
+
+int csdr_ferror(FILE* stream)
+{
+    int fd = fileno(stream);
+    csdr_io_ring_t* ring = csdr_io_ring(stream);
+    if(ring && ring->writer && __atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST)) csdr_io_flags[fd] |= CSDR_IO_ERROR;
+    return ferror(stream) || (fd>=0 && fd<CSDR_IO_MAX_FD && (csdr_io_flags[fd]&CSDR_IO_ERROR));
+}
+
+int csdr_fflush(FILE* stream)
+{
+    csdr_io_ring_t* ring = csdr_io_ring(stream);
+    if(ring) csdr_io_ring_flush(ring);
+#ifdef HAVE_LINUX_IO_URING_H
+    int fd = fileno(stream);
+    if(fd>=0 && fd<CSDR_IO_MAX_FD && csdr_uring_streams[fd]) csdr_uring_wait_write(fd, csdr_uring_streams[fd]);
+#endif
+    return fflush(stream);
+}
@@ -0,0 +1,74 @@
+/*
+This software is part of libcsdr, a set of simple DSP routines for
+Software Defined Radio.
+
+Copyright (c) 2014, Andras Retzler <randras@sdr.hu>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL ANDRAS RETZLER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <stdio.h>
+#include <sys/uio.h>
+
+//Block I/O for the streams of csdr.
+//The functions have the same semantics as fread() / fwrite(), but they go directly to the file descriptor behind the FILE*,
+//so the data is not copied through the buffer of stdio. Short reads and writes (pipes, sockets) are continued until the whole
+//block is transferred, or until EOF or an error. On a short read, the rest of the block is filled with zeros, so that the
+//caller never processes stale data from the previous block.
+//Data written before through stdio (e.g. by fprintf()) is flushed before the block, so the order of the output is kept.
+//Reads don't look ahead (except with the io_uring backend, see csdr_io_no_read_ahead()), so the same stream can still be passed
+//to splice() or read by stdio afterwards.
+//With the io_uring backend, the read of the next block and the write of the previous block are in flight while the caller processes
+//the current one. The next read is started when the same block size has been requested twice in a row, and written blocks are copied
+//to a buffer of ours, so the caller can reuse its buffer immediately. csdr_fflush() waits until the output has been written.
+//csdr_io_unread() gives back data to the beginning of the stream (e.g. if a header turned out to be samples), and
+//csdr_io_unread_size() tells how much of it is still pending, so that callers going to the file descriptor directly can forward it first.
+//csdr_fread_available() returns whatever can be read at once, for the commands that process the input byte by byte.
+//csdr_io_start_threads() moves reading and writing to two threads of their own, see csdr_io.c.
+
+#define CSDR_IO_MAX_FD 256 //for file descriptors above this, we fall back to stdio
+
+typedef enum csdr_io_backend_e
+{
+    CSDR_IO_STDIO, //plain fread() / fwrite()
+    CSDR_IO_FD, //readv() / writev() on the file descriptor
+    CSDR_IO_URING //asynchronous read and write through io_uring
+} csdr_io_backend_t;
+
+extern csdr_io_backend_t csdr_io_backend;
+
+int csdr_io_set_backend(char* name);
+void csdr_io_no_read_ahead(FILE* stream);
+int csdr_io_unread(FILE* stream, const void* ptr, size_t size);
+size_t csdr_io_unread_size(FILE* stream);
+int csdr_io_start_threads(FILE* infile, FILE* outfile, size_t block_size);
+size_t csdr_fread(void* ptr, size_t size, size_t count, FILE* stream);
+size_t csdr_fread_available(void* ptr, size_t size, FILE* stream);
+size_t csdr_fwrite(const void* ptr, size_t size, size_t count, FILE* stream);
+size_t csdr_freadv(struct iovec* iov, int iovcnt, FILE* stream);
+size_t csdr_fwritev(struct iovec* iov, int iovcnt, FILE* stream);
+int csdr_feof(FILE* stream);
+int csdr_ferror(FILE* stream);
+int csdr_fflush(FILE* stream);
@@ -87,6 +87,7 @@ OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #ifdef USE_IMA_ADPCM
 
 #include "libcsdr.h"
+#include "fmv.h"
 #include <stdlib.h>
  
 const int indexAdjustTable[16] = {
@@ -174,6 +175,151 @@ ima_adpcm_state_t decode_ima_adpcm_u8_i16(unsigned char* input, short* output, i
 	return state;
 }
 
+/*
+  Batched codec: IMA_ADPCM_BATCH_LANES independent streams are processed side by side.
+  Every stream still depends on its own previous sample, so the single stream codec above cannot be vectorized,
+  but the same sample position of several streams can: the input is transposed into a block where the lanes
+  are next to each other, and the encoder/decoder step is written without branches, so the compiler can put
+  the lanes into SIMD registers. The output is bit exact with encode_ima_adpcm_i16_u8/decode_ima_adpcm_u8_i16.
+*/
+
+#define IMA_ADPCM_BATCH_BLOCK 64 //samples per lane that are transposed at once, should be even
+
+static inline int ima_adpcm_difference(int step, int code)
+{
+    int difference = (step>>3) + ((code&1)?step>>2:0) + ((code&2)?step>>1:0) + ((code&4)?step:0);
+    return (code&8)?-difference:difference;
+}
+
+static inline int ima_adpcm_next_index(int index, int code)
+{
+    //the same as indexAdjustTable[code]
+    int adjust = ((code&7)<4) ? -1 : 2*((code&7)-3);
+    index += adjust;
+    return (index<0) ? 0 : ((index>88) ? 88 : index);
+}
+
+static inline int ima_adpcm_next_value(int value, int difference)
+{
+    value += difference;
+    return (value>32767) ? 32767 : ((value<-32768) ? -32768 : value);
+}
+
+CSDR_TARGET_CLONES
+static void encode_ima_adpcm_block(short samples[][IMA_ADPCM_BATCH_LANES], unsigned char codes[][IMA_ADPCM_BATCH_LANES], int block_length, int lanes, int* state_index, int* state_value)
+{
+    int index[IMA_ADPCM_BATCH_LANES], value[IMA_ADPCM_BATCH_LANES]; //local copies, so that they surely do not alias with the block
+    for(int l=0;l<IMA_ADPCM_BATCH_LANES;l++) { index[l] = state_index[l]; value[l] = state_value[l]; }
+    for(int i=0;i<block_length;i++)
+    {
+        for(int l=0;l<lanes;l++) //@encode_ima_adpcm_block
+        {
+            int step = _stepSizeTable[index[l]];
+            int diff = samples[i][l] - value[l];
+            int code = (diff<0) ? 8 : 0;
+            diff = (diff<0) ? -diff : diff;
+            int bit = diff>=step;
+            code |= bit<<2; diff -= bit?step:0;
+            bit = diff>=(step>>1);
+            code |= bit<<1; diff -= bit?(step>>1):0;
+            bit = diff>=(step>>2);
+            code |= bit;
+            value[l] = ima_adpcm_next_value(value[l], ima_adpcm_difference(step, code));
+            index[l] = ima_adpcm_next_index(index[l], code);
+            codes[i][l] = code;
+        }
+    }
+    for(int l=0;l<IMA_ADPCM_BATCH_LANES;l++) { state_index[l] = index[l]; state_value[l] = value[l]; }
+}
+
+CSDR_TARGET_CLONES
+static void decode_ima_adpcm_block(unsigned char codes[][IMA_ADPCM_BATCH_LANES], short samples[][IMA_ADPCM_BATCH_LANES], int block_length, int lanes, int* state_index, int* state_value)
+{
+    int index[IMA_ADPCM_BATCH_LANES], value[IMA_ADPCM_BATCH_LANES];
+    for(int l=0;l<IMA_ADPCM_BATCH_LANES;l++) { index[l] = state_index[l]; value[l] = state_value[l]; }
+    for(int i=0;i<block_length;i++)
+    {
+        for(int l=0;l<lanes;l++) //@decode_ima_adpcm_block
+        {
+            int code = codes[i][l];
+            value[l] = ima_adpcm_next_value(value[l], ima_adpcm_difference(_stepSizeTable[index[l]], code));
+            index[l] = ima_adpcm_next_index(index[l], code);
+            samples[i][l] = value[l];
+        }
+    }
+    for(int l=0;l<IMA_ADPCM_BATCH_LANES;l++) { state_index[l] = index[l]; state_value[l] = value[l]; }
+}
+
+void encode_ima_adpcm_i16_u8_batch(short** input, unsigned char** output, int input_length, ima_adpcm_state_t* states, int stream_count)
+{
+    //It encodes stream_count streams of input_length samples each. states[] is updated, like the return value of encode_ima_adpcm_i16_u8.
+    short samples[IMA_ADPCM_BATCH_BLOCK][IMA_ADPCM_BATCH_LANES];
+    unsigned char codes[IMA_ADPCM_BATCH_BLOCK][IMA_ADPCM_BATCH_LANES];
+    int index[IMA_ADPCM_BATCH_LANES], value[IMA_ADPCM_BATCH_LANES];
+    input_length -= input_length%2; //we always output whole bytes
+    for(int first=0;first<stream_count;first+=IMA_ADPCM_BATCH_LANES)
+    {
+        int lanes = MIN_M(IMA_ADPCM_BATCH_LANES, stream_count-first);
+        int vector_lanes = (lanes+7)&~7; //the unused lanes up to this are just filled with zeros
+        for(int l=0;l<IMA_ADPCM_BATCH_LANES;l++)
+        {
+            index[l] = (l<lanes) ? states[first+l].index : 0;
+            value[l] = (l<lanes) ? states[first+l].previousValue : 0;
+        }
+        for(int i=0;i<input_length;i+=IMA_ADPCM_BATCH_BLOCK)
+        {
+            int block_length = MIN_M(IMA_ADPCM_BATCH_BLOCK, input_length-i);
+            for(int j=0;j<block_length;j++)
+                for(int l=0;l<vector_lanes;l++) samples[j][l] = (l<lanes) ? input[first+l][i+j] : 0;
+            encode_ima_adpcm_block(samples, codes, block_length, vector_lanes, index, value);
+            for(int l=0;l<lanes;l++)
+                for(int j=0;j<block_length;j+=2) output[first+l][(i+j)/2] = codes[j][l] | (codes[j+1][l]<<4);
+        }
+        for(int l=0;l<lanes;l++)
+        {
+            states[first+l].index = index[l];
+            states[first+l].previousValue = value[l];
+        }
+    }
+}
+
+void decode_ima_adpcm_u8_i16_batch(unsigned char** input, short** output, int input_length, ima_adpcm_state_t* states, int stream_count)
+{
+    //It decodes stream_count streams of input_length bytes (2*input_length samples) each. states[] is updated.
+    short samples[IMA_ADPCM_BATCH_BLOCK][IMA_ADPCM_BATCH_LANES];
+    unsigned char codes[IMA_ADPCM_BATCH_BLOCK][IMA_ADPCM_BATCH_LANES];
+    int index[IMA_ADPCM_BATCH_LANES], value[IMA_ADPCM_BATCH_LANES];
+    for(int first=0;first<stream_count;first+=IMA_ADPCM_BATCH_LANES)
+    {
+        int lanes = MIN_M(IMA_ADPCM_BATCH_LANES, stream_count-first);
+        int vector_lanes = (lanes+7)&~7; //the unused lanes up to this are just filled with zeros
+        for(int l=0;l<IMA_ADPCM_BATCH_LANES;l++)
+        {
+            index[l] = (l<lanes) ? states[first+l].index : 0;
+            value[l] = (l<lanes) ? states[first+l].previousValue : 0;
+        }
+        for(int i=0;i<2*input_length;i+=IMA_ADPCM_BATCH_BLOCK)
+        {
+            int block_length = MIN_M(IMA_ADPCM_BATCH_BLOCK, 2*input_length-i);
+            for(int j=0;j<block_length;j+=2)
+                for(int l=0;l<vector_lanes;l++)
+                {
+                    unsigned char byte = (l<lanes) ? input[first+l][(i+j)/2] : 0;
+                    codes[j][l] = byte&0xf;
+                    codes[j+1][l] = (byte>>4)&0xf;
+                }
+            decode_ima_adpcm_block(codes, samples, block_length, vector_lanes, index, value);
+            for(int l=0;l<lanes;l++)
+                for(int j=0;j<block_length;j++) output[first+l][i+j] = samples[j][l];
+        }
+        for(int l=0;l<lanes;l++)
+        {
+            states[first+l].index = index[l];
+            states[first+l].previousValue = value[l];
+        }
+    }
+}
+
 void fft_compress_ima_adpcm_init(fft_compress_ima_adpcm_t* job, uint32_t size) {
     job->size = size;
     job->real_data_size = size + COMPRESS_FFT_PAD_N;
@@ -198,4 +344,26 @@ void fft_compress_ima_adpcm(fft_compress_ima_adpcm_t* job, unsigned char* output
     encode_ima_adpcm_i16_u8(job->temp, output, job->real_data_size, job->state); //we always return to original d at any new buffer
 }
 
+void fft_compress_ima_adpcm_batch(fft_compress_ima_adpcm_t** jobs, unsigned char** outputs, int job_count)
+{
+    //The same as calling fft_compress_ima_adpcm() on each job, but the lines are encoded in parallel.
+    //All jobs should have the same size.
+    if(job_count<=0) return;
+    short* temps[IMA_ADPCM_BATCH_LANES];
+    ima_adpcm_state_t states[IMA_ADPCM_BATCH_LANES];
+    for(int first=0;first<job_count;first+=IMA_ADPCM_BATCH_LANES)
+    {
+        int lanes = MIN_M(IMA_ADPCM_BATCH_LANES, job_count-first);
+        for(int l=0;l<lanes;l++)
+        {
+            fft_compress_ima_adpcm_t* job = jobs[first+l];
+            for (int i = 0; i < COMPRESS_FFT_PAD_N; i++) job->input[i] = job->input[COMPRESS_FFT_PAD_N]; //do padding
+            for (int i = 0; i < job->real_data_size; i++) job->temp[i] = job->input[i] * 100; //convert float dB values to short
+            temps[l] = job->temp;
+            states[l] = job->state; //we always return to original d at any new buffer
+        }
+        encode_ima_adpcm_i16_u8_batch(temps, outputs+first, jobs[first]->real_data_size, states, lanes);
+    }
+}
+
 #endif
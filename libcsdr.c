@@ -40,6 +40,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "predefined.h"
 #include <assert.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 /*
            _           _                   __                  _   _
@@ -169,6 +170,23 @@ void firdes_bandpass_c(complexf *output, int length, float lowcut, float highcut
     }
 }
 
+void firdes_hilbert_f(float *output, int length, window_t window)
+{
+    //Generates windowed FIR Hilbert transformer taps (90 degree phase shift, cos -> sin).
+    //  length should be odd
+    //The taps are in the order of fir_one_pass_ff, so that it gives the Hilbert transform of input[length/2].
+    int middle=length/2;
+    float (*window_function)(float)  = firdes_get_window_kernel(window);
+    output[middle]=0;
+    for(int i=1; i<=middle; i++) //@firdes_hilbert_f
+    {
+        //the impulse response is 2/(PI*n) for odd n and 0 for even n, mirrored because of the order of the taps
+        float tap = (i&1) ? (2/(PI*i))*window_function((float)i/middle) : 0;
+        output[middle-i]=tap;
+        output[middle+i]=-tap;
+    }
+}
+
 int firdes_filter_len(float transition_bw)
 {
     int result=4.0/transition_bw;
@@ -176,6 +194,255 @@ int firdes_filter_len(float transition_bw)
     return result;
 }
 
+//IIR filters as cascades of second order sections (biquads).
+//Design: analog prototype poles (Butterworth or Chebyshev type I) -> frequency transformation -> bilinear transform.
+//The frequencies are relative to the sampling rate, as for firdes_lowpass_f.
+
+typedef struct iirdes_complex_s { double i; double q; } iirdes_complex_t;
+
+static iirdes_complex_t iirdes_cmult(iirdes_complex_t a, iirdes_complex_t b) { iirdes_complex_t r = { a.i*b.i-a.q*b.q, a.i*b.q+a.q*b.i }; return r; }
+static iirdes_complex_t iirdes_cdiv(iirdes_complex_t a, iirdes_complex_t b)
+{
+    double d = b.i*b.i+b.q*b.q;
+    iirdes_complex_t r = { (a.i*b.i+a.q*b.q)/d, (a.q*b.i-a.i*b.q)/d };
+    return r;
+}
+static iirdes_complex_t iirdes_csqrt(iirdes_complex_t a)
+{
+    double m = sqrt(sqrt(a.i*a.i+a.q*a.q)), p = atan2(a.q, a.i)/2;
+    iirdes_complex_t r = { m*cos(p), m*sin(p) };
+    return r;
+}
+
+int iirdes_num_sections(int order, iir_filter_type_t type)
+{
+    //bandpass and bandstop filters have twice the order of the prototype
+    return (type == IIR_BANDPASS || type == IIR_BANDSTOP) ? order : (order+1)/2;
+}
+
+static void iirdes_add_section(biquad_t* section, iirdes_complex_t pole1, iirdes_complex_t pole2, int first_order, iir_filter_type_t type, double zero_cos)
+{
+    //pole1 and pole2 are analog poles, which we map to the z plane with the bilinear transform: z = (1+s)/(1-s).
+    //They are either a complex conjugate pair or two real poles.
+    iirdes_complex_t zp1 = iirdes_cdiv((iirdes_complex_t){ 1+pole1.i, pole1.q }, (iirdes_complex_t){ 1-pole1.i, -pole1.q });
+    iirdes_complex_t zp2 = iirdes_cdiv((iirdes_complex_t){ 1+pole2.i, pole2.q }, (iirdes_complex_t){ 1-pole2.i, -pole2.q });
+    if(first_order)
+    {
+        section->a1 = -zp1.i;
+        section->a2 = 0;
+        section->b0 = 1;
+        section->b1 = (type == IIR_LOWPASS) ? 1 : -1; //zero at z=-1 (lowpass) or z=1 (highpass)
+        section->b2 = 0;
+        return;
+    }
+    section->a1 = -(zp1.i+zp2.i);
+    section->a2 = zp1.i*zp2.i-zp1.q*zp2.q;
+    section->b0 = 1;
+    if(type == IIR_LOWPASS) { section->b1 = 2; section->b2 = 1; } //double zero at z=-1
+    else if(type == IIR_HIGHPASS) { section->b1 = -2; section->b2 = 1; } //double zero at z=1
+    else if(type == IIR_BANDPASS) { section->b1 = 0; section->b2 = -1; } //zeros at z=1 and z=-1
+    else { section->b1 = -2*zero_cos; section->b2 = 1; } //zeros at the center frequency on the unit circle
+}
+
+static iirdes_complex_t iirdes_response(biquad_t* sections, int num_sections, double rate)
+{
+    //Frequency response of the cascade at rate (relative to the sampling rate)
+    iirdes_complex_t z1 = { cos(2*M_PI*rate), -sin(2*M_PI*rate) }; //z^-1
+    iirdes_complex_t z2 = iirdes_cmult(z1, z1);
+    iirdes_complex_t h = { 1, 0 };
+    for(int i=0;i<num_sections;i++)
+    {
+        biquad_t* s = sections+i;
+        iirdes_complex_t num = { s->b0+s->b1*z1.i+s->b2*z2.i, s->b1*z1.q+s->b2*z2.q };
+        iirdes_complex_t den = { 1+s->a1*z1.i+s->a2*z2.i, s->a1*z1.q+s->a2*z2.q };
+        h = iirdes_cmult(h, iirdes_cdiv(num, den));
+    }
+    return h;
+}
+
+static int iirdes_from_prototype(biquad_t* output, iirdes_complex_t* proto_poles, int order, iir_filter_type_t type, double cutoff1, double cutoff2, double passband_gain)
+{
+    //proto_poles[0 ... (order+1)/2-1] are the poles of the normalized lowpass prototype with a non-negative imaginary part.
+    //Frequencies are prewarped for the bilinear transform.
+    double w1 = tan(M_PI*cutoff1);
+    double w2 = (type == IIR_BANDPASS || type == IIR_BANDSTOP) ? tan(M_PI*cutoff2) : 0;
+    double w0 = sqrt(w1*w2), bw = w2-w1;
+    double zero_cos = (1-w0*w0)/(1+w0*w0); //cos of the digital center frequency, for the zeros of the bandstop filter
+    int num_sections = 0;
+    for(int k=0;k<(order+1)/2;k++)
+    {
+        iirdes_complex_t p = proto_poles[k];
+        int real_pole = (p.q == 0);
+        if(type == IIR_LOWPASS || type == IIR_HIGHPASS)
+        {
+            //lowpass: s -> s/w1, highpass: s -> w1/s
+            iirdes_complex_t ap = (type == IIR_LOWPASS) ? (iirdes_complex_t){ p.i*w1, p.q*w1 } : iirdes_cdiv((iirdes_complex_t){ w1, 0 }, p);
+            iirdes_complex_t ap_conj = { ap.i, -ap.q };
+            iirdes_add_section(output+num_sections++, ap, ap_conj, real_pole, type, 0);
+        }
+        else
+        {
+            //bandpass: s -> (s^2+w0^2)/(s*bw), bandstop: s -> s*bw/(s^2+w0^2)
+            //Each prototype pole p becomes the two roots of: s^2 - q*s + w0^2 = 0, where q = p*bw (bandpass) or bw/p (bandstop).
+            iirdes_complex_t q = (type == IIR_BANDPASS) ? (iirdes_complex_t){ p.i*bw, p.q*bw } : iirdes_cdiv((iirdes_complex_t){ bw, 0 }, p);
+            iirdes_complex_t disc = iirdes_cmult(q, q);
+            disc.i -= 4*w0*w0;
+            iirdes_complex_t d = iirdes_csqrt(disc);
+            iirdes_complex_t r1 = { (q.i+d.i)/2, (q.q+d.q)/2 };
+            iirdes_complex_t r2 = { (q.i-d.i)/2, (q.q-d.q)/2 };
+            if(real_pole)
+            {
+                //r1 and r2 are a complex conjugate pair or both real: one section
+                iirdes_add_section(output+num_sections++, r1, r2, 0, type, zero_cos);
+            }
+            else
+            {
+                //the conjugate of p gives the conjugates of r1 and r2
+                iirdes_add_section(output+num_sections++, r1, (iirdes_complex_t){ r1.i, -r1.q }, 0, type, zero_cos);
+                iirdes_add_section(output+num_sections++, r2, (iirdes_complex_t){ r2.i, -r2.q }, 0, type, zero_cos);
+            }
+        }
+    }
+
+    //Normalize the gain in the passband, we change the numerator of the first section.
+    double reference_rate = (type == IIR_LOWPASS || type == IIR_BANDSTOP) ? 0 : (type == IIR_HIGHPASS) ? 0.5 : atan(w0)/M_PI;
+    iirdes_complex_t h = iirdes_response(output, num_sections, reference_rate);
+    double gain = passband_gain/sqrt(h.i*h.i+h.q*h.q);
+    output[0].b0 *= gain;
+    output[0].b1 *= gain;
+    output[0].b2 *= gain;
+    return num_sections;
+}
+
+int iirdes_butterworth(biquad_t* output, int order, iir_filter_type_t type, float cutoff1, float cutoff2)
+{
+    //Returns the number of sections written to output (see iirdes_num_sections).
+    //cutoff2 is only used by bandpass and bandstop filters.
+    iirdes_complex_t* poles = (iirdes_complex_t*)malloc(sizeof(iirdes_complex_t)*(order+1)/2);
+    for(int k=0;k<(order+1)/2;k++)
+    {
+        //poles on the unit circle in the left half plane
+        double theta = M_PI*(2*k+1)/(2*order);
+        poles[k].i = -sin(theta);
+        poles[k].q = cos(theta);
+        if(fabs(poles[k].q)<1e-12) poles[k].q = 0;
+    }
+    int num_sections = iirdes_from_prototype(output, poles, order, type, cutoff1, cutoff2, 1);
+    free(poles);
+    return num_sections;
+}
+
+int iirdes_chebyshev1(biquad_t* output, int order, iir_filter_type_t type, float cutoff1, float cutoff2, float ripple_db)
+{
+    //Chebyshev type I: the passband has ripple_db ripple, the cutoff frequency is the edge of the ripple band.
+    double epsilon = sqrt(pow(10, ripple_db/10)-1);
+    double mu = asinh(1/epsilon)/order;
+    iirdes_complex_t* poles = (iirdes_complex_t*)malloc(sizeof(iirdes_complex_t)*(order+1)/2);
+    for(int k=0;k<(order+1)/2;k++)
+    {
+        double theta = M_PI*(2*k+1)/(2*order);
+        poles[k].i = -sinh(mu)*sin(theta);
+        poles[k].q = cosh(mu)*cos(theta);
+        if(fabs(poles[k].q)<1e-12) poles[k].q = 0;
+    }
+    //With even order the response is at the bottom of the ripple at DC.
+    double passband_gain = (order%2) ? 1 : 1/sqrt(1+epsilon*epsilon);
+    int num_sections = iirdes_from_prototype(output, poles, order, type, cutoff1, cutoff2, passband_gain);
+    free(poles);
+    return num_sections;
+}
+
+int iirdes_notch(biquad_t* output, float rate, float bandwidth)
+{
+    //Second order notch filter at rate, with the given -3 dB bandwidth (both relative to the sampling rate).
+    //From the Audio EQ Cookbook by Robert Bristow-Johnson, with Q = rate/bandwidth.
+    double w0 = 2*M_PI*rate;
+    double alpha = sin(w0)*bandwidth/(2*rate);
+    double a0 = 1+alpha;
+    output->b0 = 1/a0;
+    output->b1 = -2*cos(w0)/a0;
+    output->b2 = 1/a0;
+    output->a1 = -2*cos(w0)/a0;
+    output->a2 = (1-alpha)/a0;
+    return 1;
+}
+
+sos_filter_t sos_filter_init(biquad_t* sections, int num_sections, int channels)
+{
+    sos_filter_t f;
+    f.sections = sections;
+    f.num_sections = num_sections;
+    f.channels = channels;
+    f.state = (float*)calloc(2*num_sections*channels, sizeof(float));
+    return f;
+}
+
+void sos_filter_ff(sos_filter_t* f, float* input, float* output, int input_size)
+{
+    //input_size is the number of samples per channel, channels are interleaved.
+    //It uses transposed direct form II. Input and output can be the same buffer.
+    if(f->channels>1) { sos_filter_channels_ff(f, input, output, input_size); return; }
+
+    //With one channel, we go through all the sections sample by sample.
+    //Although each section depends on the previous one, the CPU can work on the sections in parallel, one sample behind each other.
+    for(int i=0;i<input_size;i++) //@sos_filter_ff
+    {
+        float x = input[i];
+        for(int s=0;s<f->num_sections;s++)
+        {
+            biquad_t* b = f->sections+s;
+            float* z = f->state+2*s;
+            float y = b->b0*x+z[0];
+            z[0] = b->b1*x-b->a1*y+z[1];
+            z[1] = b->b2*x-b->a2*y;
+            x = y;
+        }
+        output[i] = x;
+    }
+}
+
+static inline void sos_filter_channels_const(sos_filter_t* f, float* input, float* output, int input_size, int channels)
+{
+    //When channels is a compile time constant, the channel loop is unrolled into SIMD operations.
+    //As with one channel, the sections are in the inner loop, so that the CPU can work on them in parallel.
+    for(int i=0;i<input_size;i++)
+    {
+        float x[channels];
+        for(int c=0;c<channels;c++) x[c] = input[i*channels+c];
+        for(int s=0;s<f->num_sections;s++)
+        {
+            biquad_t* b = f->sections+s;
+            float* z0 = f->state+2*s*channels;
+            float* z1 = z0+channels;
+            for(int c=0;c<channels;c++) //@sos_filter_channels_ff
+            {
+                float y = b->b0*x[c]+z0[c];
+                z0[c] = b->b1*x[c]-b->a1*y+z1[c];
+                z1[c] = b->b2*x[c]-b->a2*y;
+                x[c] = y;
+            }
+        }
+        for(int c=0;c<channels;c++) output[i*channels+c] = x[c];
+    }
+}
+
+CSDR_TARGET_CLONES
+void sos_filter_channels_ff(sos_filter_t* f, float* input, float* output, int input_size)
+{
+    //input_size is the number of samples per channel. Input and output can be the same buffer.
+    //The channels are independent, so we process them in parallel with SIMD instructions: the innermost loop is on the channels.
+    if(f->channels==2) sos_filter_channels_const(f, input, output, input_size, 2); //I/Q or stereo
+    else if(f->channels==4) sos_filter_channels_const(f, input, output, input_size, 4);
+    else if(f->channels==8) sos_filter_channels_const(f, input, output, input_size, 8);
+    else sos_filter_channels_const(f, input, output, input_size, f->channels);
+}
+
+void sos_filter_cc(sos_filter_t* f, complexf* input, complexf* output, int input_size)
+{
+    //The same real filter on the I and Q channels. f should be initialized with channels=2.
+    sos_filter_channels_ff(f, (float*)input, (float*)output, input_size);
+}
+
 /*
   _____   _____ _____      __                  _   _
  |  __ \ / ____|  __ \    / _|                | | (_)
@@ -742,6 +1009,115 @@ int fir_decimate_cc(complexf *input, complexf *output, int input_size, fir_decim
 
 #endif
 
+/*
+  Front end: convert_u8_f | shift_addfast_cc | fir_decimate_cc in one step.
+  The input is converted and shifted in blocks that fit into the cache, and fir_decimate_cc works on those blocks,
+  so the full rate signal is never written to memory, only the decimated output.
+  The output matches the three separate steps within float rounding only, as the phase of the shift is wrapped differently.
+*/
+
+#define FRONTEND_BLOCK_SIZE 4096
+
+frontend_t frontend_init(float shift_rate, int decimation, float transition_bw, window_t window)
+{
+    frontend_t f;
+    f.shift = shift_addfast_init(shift_rate);
+    f.starting_phase = 0;
+    f.decimator = fir_decimate_init(decimation, transition_bw, window);
+    //the block always has room for at least one output sample
+    f.buffer_size = f.decimator.taps_length+MAX_M(FRONTEND_BLOCK_SIZE, decimation);
+    f.buffer = (complexf*)malloc(sizeof(complexf)*f.buffer_size);
+    f.buffer_fill = 0;
+    return f;
+}
+
+void frontend_set_shift_rate(frontend_t* f, float shift_rate)
+{
+    f->shift = shift_addfast_init(shift_rate);
+}
+
+static inline float frontend_convert_shift(void* input, complexf* output, int input_size, shift_addfast_data_t* d, float starting_phase, const int is_s16)
+{
+    //It works like shift_addfast_cc, but it converts the input sample by sample first, and it wraps the phase in double.
+#define FRONTEND_SAMPLE(x) ((is_s16) ? ((short*)input)[x]/(float)SHRT_MAX : ((unsigned char*)input)[x]/(UCHAR_MAX/2.0f)-1.0f)
+    float cos_start=cos(starting_phase);
+    float sin_start=sin(starting_phase);
+    float cos_vals[4], sin_vals[4], dcos[4], dsin[4];
+    for(int j=0;j<4;j++) { dcos[j] = d->dcos[j]; dsin[j] = d->dsin[j]; }
+    for(int i=0;i<input_size/4;i++) //@frontend_convert_shift
+    {
+        for(int j=0;j<4;j++)
+        {
+            cos_vals[j] = cos_start * dcos[j] - sin_start * dsin[j];
+            sin_vals[j] = sin_start * dcos[j] + cos_start * dsin[j];
+        }
+        for(int j=0;j<4;j++)
+        {
+            float in_i = FRONTEND_SAMPLE(2*(4*i+j));
+            float in_q = FRONTEND_SAMPLE(2*(4*i+j)+1);
+            iof(output,4*i+j)=cos_vals[j]*in_i-sin_vals[j]*in_q;
+            qof(output,4*i+j)=sin_vals[j]*in_i+cos_vals[j]*in_q;
+        }
+        cos_start = cos_vals[3];
+        sin_start = sin_vals[3];
+    }
+    for(int j=0;j<input_size%4;j++)
+    {
+        int k = input_size-input_size%4+j;
+        float cos_val = cos_start * d->dcos[j] - sin_start * d->dsin[j];
+        float sin_val = sin_start * d->dcos[j] + cos_start * d->dsin[j];
+        float in_i = FRONTEND_SAMPLE(2*k);
+        float in_q = FRONTEND_SAMPLE(2*k+1);
+        iof(output,k)=cos_val*in_i-sin_val*in_q;
+        qof(output,k)=sin_val*in_i+cos_val*in_q;
+    }
+#undef FRONTEND_SAMPLE
+    //The blocks are long, so the phase advance is wrapped in double precision, otherwise the float error would accumulate.
+    double phase=starting_phase+input_size*(double)d->phase_increment;
+    phase-=2*PI*floor((phase+PI)/(2*PI));
+    return phase;
+}
+
+CSDR_TARGET_CLONES
+static float frontend_convert_shift_u8(unsigned char* input, complexf* output, int input_size, shift_addfast_data_t* d, float starting_phase)
+{
+    return frontend_convert_shift(input, output, input_size, d, starting_phase, 0);
+}
+
+CSDR_TARGET_CLONES
+static float frontend_convert_shift_s16(short* input, complexf* output, int input_size, shift_addfast_data_t* d, float starting_phase)
+{
+    return frontend_convert_shift(input, output, input_size, d, starting_phase, 1);
+}
+
+static int frontend_cc(frontend_t* f, void* input, complexf* output, int input_size, int is_s16)
+{
+    //input_size is the number of complex samples on the input. It returns the number of output samples, which is at most input_size/decimation+1.
+    int output_size = 0;
+    for(int i=0;i<input_size;)
+    {
+        int size = MIN_M(input_size-i, f->buffer_size-f->buffer_fill);
+        if(is_s16) f->starting_phase = frontend_convert_shift_s16((short*)input+2*i, f->buffer+f->buffer_fill, size, &f->shift, f->starting_phase);
+        else f->starting_phase = frontend_convert_shift_u8((unsigned char*)input+2*i, f->buffer+f->buffer_fill, size, &f->shift, f->starting_phase);
+        f->buffer_fill += size;
+        i += size;
+        if(f->buffer_fill<f->decimator.taps_length) continue;
+        output_size += fir_decimate_cc(f->buffer, output+output_size, f->buffer_fill, &f->decimator);
+        f->buffer_fill -= f->decimator.input_skip;
+    }
+    return output_size;
+}
+
+int frontend_u8_cc(frontend_t* f, unsigned char* input, complexf* output, int input_size)
+{
+    return frontend_cc(f, input, output, input_size, 0);
+}
+
+int frontend_s16_cc(frontend_t* f, short* input, complexf* output, int input_size)
+{
+    return frontend_cc(f, input, output, input_size, 1);
+}
+
 /*
 int fir_decimate_cc(complexf *input, complexf *output, int input_size, int decimation, float *taps, int taps_length)
 {
@@ -1108,20 +1484,17 @@ void apply_fir_fft_cc(fft_plan_t* plan, fft_plan_t* plan_inverse, complexf* taps
 
 */
 
+CSDR_TARGET_CLONES
 void amdemod_cf(complexf* input, float *output, int input_size)
 {
-    //@amdemod: i*i+q*q
-    for (int i=0; i<input_size; i++)
-    {
-        output[i]=iof(input,i)*iof(input,i)+qof(input,i)*qof(input,i);
-    }
-    //@amdemod: sqrt
-    for (int i=0; i<input_size; i++)
+    //It is a single pass with sqrtf, so it can be vectorized (most SIMD instruction sets have a vector square root).
+    for (int i=0; i<input_size; i++) //@amdemod_cf
     {
-        output[i]=sqrt(output[i]);
+        output[i]=sqrtf(iof(input,i)*iof(input,i)+qof(input,i)*qof(input,i));
     }
 }
 
+CSDR_TARGET_CLONES
 void amdemod_estimator_cf(complexf* input, float *output, int input_size, float alpha, float beta)
 {
     //concept is explained here:
@@ -1134,22 +1507,96 @@ void amdemod_estimator_cf(complexf* input, float *output, int input_size, float
         beta=0.392485425092;
     }
 
-    //@amdemod_estimator
-    for (int i=0; i<input_size; i++)
+    //It is branchless, so that it can be vectorized.
+    for (int i=0; i<input_size; i++) //@amdemod_estimator_cf
     {
-        float abs_i=iof(input,i);
-        if(abs_i<0) abs_i=-abs_i;
-        float abs_q=qof(input,i);
-        if(abs_q<0) abs_q=-abs_q;
-        float max_iq=abs_i;
-        if(abs_q>max_iq) max_iq=abs_q;
-        float min_iq=abs_i;
-        if(abs_q<min_iq) min_iq=abs_q;
-
+        float abs_i=fabsf(iof(input,i));
+        float abs_q=fabsf(qof(input,i));
+        float max_iq=(abs_q>abs_i)?abs_q:abs_i;
+        float min_iq=(abs_q>abs_i)?abs_i:abs_q;
         output[i]=alpha*max_iq+beta*min_iq;
     }
 }
 
+samdemod_t samdemod_init(samdemod_sideband_t sideband, float pll_bandwidth, float transition_bw, int max_input_size)
+{
+    samdemod_t s;
+    s.sideband = sideband;
+    s.pll.pll_type = PLL_PI_CONTROLLER;
+    pll_cc_init_pi_controller(&s.pll, pll_bandwidth, 1, 1, 0.707);
+    s.nco = (complexf*)malloc(sizeof(complexf)*max_input_size);
+    s.hilbert_taps_length = firdes_filter_len(transition_bw);
+    s.hilbert_taps = (float*)malloc(sizeof(float)*s.hilbert_taps_length);
+    firdes_hilbert_f(s.hilbert_taps, s.hilbert_taps_length, WINDOW_DEFAULT);
+    s.buffer_i = (float*)calloc(max_input_size+s.hilbert_taps_length, sizeof(float));
+    s.buffer_q = (float*)calloc(max_input_size+s.hilbert_taps_length, sizeof(float));
+    return s;
+}
+
+CSDR_TARGET_CLONES
+void samdemod_cf(complexf* input, float* output, int input_size, samdemod_t* s)
+{
+    //Synchronous AM demodulator: the carrier is regenerated by a PLL, so the output is not distorted if the carrier fades.
+    //If the PLL is locked, nco = e^(j*carrier_phase), and we mix the input down with it.
+    pll_cc(&s->pll, input, NULL, s->nco, input_size);
+    if(s->sideband == SAMDEMOD_DSB)
+    {
+        for(int i=0;i<input_size;i++) //@samdemod_cf: dsb
+            output[i] = iof(input,i)*iof(s->nco,i)+qof(input,i)*qof(s->nco,i);
+        return;
+    }
+
+    //USB = I - hilbert(Q), LSB = I + hilbert(Q)
+    int history = s->hilbert_taps_length-1;
+    float* buffer_i = s->buffer_i+history;
+    float* buffer_q = s->buffer_q+history;
+    for(int i=0;i<input_size;i++) //@samdemod_cf: mix down
+    {
+        buffer_i[i] = iof(input,i)*iof(s->nco,i)+qof(input,i)*qof(s->nco,i);
+        buffer_q[i] = qof(input,i)*iof(s->nco,i)-iof(input,i)*qof(s->nco,i);
+    }
+    float sign = (s->sideband == SAMDEMOD_USB) ? -1 : 1;
+    for(int i=0;i<input_size;i++)
+    {
+        float acc = 0;
+        for(int ti=0;ti<s->hilbert_taps_length;ti++) acc += s->buffer_q[i+ti]*s->hilbert_taps[ti]; //@samdemod_cf: hilbert
+        output[i] = s->buffer_i[i+history/2] + sign*acc;
+    }
+    memmove(s->buffer_i, s->buffer_i+input_size, sizeof(float)*history);
+    memmove(s->buffer_q, s->buffer_q+input_size, sizeof(float)*history);
+}
+
+#define IIR1_LOOKAHEAD 8 //number of outputs that are calculated in parallel by iir1_lookahead_ff
+#define IIR1_LOOKAHEAD_FIR_LENGTH (IIR1_LOOKAHEAD+1)
+
+//Block-parallel first order IIR filter: y[n] = c*y[n-1] + b[n], where b[n] is a short FIR filter on the input.
+//We use look-ahead decomposition: substituting y[n-1] = c*y[n-2] + b[n-1] again and again we get:
+//  y[n] = c^8 * y[n-8] + sum_{j=0..7} c^j * b[n-j]
+//The sum is an FIR filter on the input, which is calculated by iir1_lookahead_fir_ff.
+//As y[n] only depends on y[n-8], 8 consecutive outputs can be calculated in parallel by iir1_lookahead_recursion_ff.
+//Both loops are vectorized. The first IIR1_LOOKAHEAD outputs have to be calculated sample by sample between the two steps.
+
+CSDR_TARGET_CLONES
+static void iir1_lookahead_fir_ff(float* input, float* output, int input_size, float* fir)
+{
+    //fir[t] is the tap for input[n-t].
+    //We go backwards, so input and output can be the same buffer.
+    for(int i=input_size-1;i>=IIR1_LOOKAHEAD;i--) //@iir1_lookahead_fir_ff
+    {
+        float acc=0;
+        for(int t=0;t<IIR1_LOOKAHEAD_FIR_LENGTH;t++) acc+=fir[t]*input[i-t];
+        output[i]=acc;
+    }
+}
+
+CSDR_TARGET_CLONES
+static void iir1_lookahead_recursion_ff(float* output, int input_size, float c)
+{
+    float c_lookahead=powf(c,IIR1_LOOKAHEAD);
+    for(int i=IIR1_LOOKAHEAD;i<input_size;i++) //@iir1_lookahead_recursion_ff
+        output[i]+=c_lookahead*output[i-IIR1_LOOKAHEAD];
+}
+
 dcblock_preserve_t dcblock_ff(float* input, float* output, int input_size, float a, dcblock_preserve_t preserved)
 {
     //after AM demodulation, a DC blocking filter should be used to remove the DC component from the signal.
@@ -1157,12 +1604,22 @@ dcblock_preserve_t dcblock_ff(float* input, float* output, int input_size, float
     //output size equals to input_size;
     //preserve can be initialized to zero on first run.
     if(a==0) a=0.999; //default value, simulate in octave: freqz([1 -1],[1 -0.99])
+    //b[n] = input[n]-input[n-1], so sum_j a^j * b[n-j] = input[n] + sum_{j=1..7} (a^j - a^(j-1)) * input[n-j] - a^7 * input[n-8]
+    float fir[IIR1_LOOKAHEAD_FIR_LENGTH];
+    fir[0]=1;
+    for(int t=1;t<IIR1_LOOKAHEAD;t++) fir[t]=powf(a,t)-powf(a,t-1);
+    fir[IIR1_LOOKAHEAD]=-powf(a,IIR1_LOOKAHEAD-1);
+    float last_input=input[input_size-1];
+    iir1_lookahead_fir_ff(input, output, input_size, fir);
+
     output[0]=input[0]-preserved.last_input+a*preserved.last_output;
-    for(int i=1; i<input_size; i++) //@dcblock_f
+    int scalar_size=(input_size<IIR1_LOOKAHEAD)?input_size:IIR1_LOOKAHEAD;
+    for(int i=1; i<scalar_size; i++) //@dcblock_f
     {
         output[i]=input[i]-input[i-1]+a*output[i-1];
     }
-    preserved.last_input=input[input_size-1];
+    iir1_lookahead_recursion_ff(output, input_size, a);
+    preserved.last_input=last_input;
     preserved.last_output=output[input_size-1];
     return preserved;
 }
@@ -1181,10 +1638,11 @@ float fastdcblock_ff(float* input, float* output, int input_size, float last_dc_
     avg/=input_size;
 
     float avgdiff=avg-last_dc_level;
+    float dc_step=avgdiff/input_size;
     //DC removal level will change lineraly from last_dc_level to avg.
     for(int i=0;i<input_size;i++) //@fastdcblock_ff: remove DC component
     {
-        float dc_removal_level=last_dc_level+avgdiff*((float)i/input_size);
+        float dc_removal_level=last_dc_level+dc_step*i;
         output[i]=input[i]-dc_removal_level;
     }
     return avg;
@@ -1193,51 +1651,100 @@ float fastdcblock_ff(float* input, float* output, int input_size, float last_dc_
 //#define FASTAGC_MAX_GAIN (65e3)
 #define FASTAGC_MAX_GAIN 50
 
+fastagc_ff_t fastagc_init(int input_size, int num_blocks, float reference, int floats_per_sample)
+{
+    fastagc_ff_t input;
+    input.num_blocks = num_blocks;
+    input.input_size = input_size;
+    input.floats_per_sample = floats_per_sample;
+    input.reference = reference;
+    input.last_gain = 0;
+    input.buffers = (float**)malloc(sizeof(float*)*num_blocks);
+    for(int i=0;i<num_blocks;i++) input.buffers[i] = (float*)calloc(input_size*floats_per_sample, sizeof(float));
+    input.peaks = (float*)calloc(num_blocks, sizeof(float));
+    input.oldest = 0;
+    input.buffer_input = input.buffers[num_blocks-1];
+    return input;
+}
+
+void fastagc_free(fastagc_ff_t* input)
+{
+    for(int i=0;i<input->num_blocks;i++) free(input->buffers[i]);
+    free(input->buffers);
+    free(input->peaks);
+}
+
+static float fastagc_target_gain(fastagc_ff_t* input, float peak_input)
+{
+    //Determine the maximal peak out of all the blocks
+    input->peaks[(input->oldest+input->num_blocks-1)%input->num_blocks] = peak_input;
+    float target_peak=0;
+    for(int i=0;i<input->num_blocks;i++) if(target_peak<input->peaks[i]) target_peak=input->peaks[i];
+
+    //we change the gain linearly on the apply_block from the last_gain to target_gain.
+    float target_gain=input->reference/target_peak;
+    if(target_gain>FASTAGC_MAX_GAIN) target_gain=FASTAGC_MAX_GAIN;
+    return target_gain;
+}
+
+static void fastagc_shift(fastagc_ff_t* input, float target_gain)
+{
+    //The oldest block has been output, so it becomes the input block to fill.
+    input->buffer_input=input->buffers[input->oldest];
+    input->oldest=(input->oldest+1)%input->num_blocks;
+    input->last_gain=target_gain;
+}
+
+CSDR_TARGET_CLONES
 void fastagc_ff(fastagc_ff_t* input, float* output)
 {
     //Gain is processed on blocks of samples.
-    //You have to supply three blocks of samples before the first block comes out.
-    //AGC reaction speed equals input_size*samp_rate*2
+    //You have to supply num_blocks blocks of samples before the first block comes out.
+    //AGC reaction speed equals input_size*samp_rate*(num_blocks-1)
 
-    //The algorithm calculates target gain at the end of the first block out of the peak value of all the three blocks.
-    //This way the gain change can easily react if there is any peak in the third block.
+    //The algorithm calculates target gain at the end of the oldest block out of the peak value of all the blocks.
+    //This way the gain change can easily react if there is any peak in the newest block.
     //Pros: can be easily speeded up with loop vectorization, easy to implement
-    //Cons: needs 3 buffers, dos not behave similarly to real AGC circuits
+    //Cons: needs num_blocks buffers, dos not behave similarly to real AGC circuits
 
     //Get the peak value of new input buffer
     float peak_input=0;
     for(int i=0;i<input->input_size;i++) //@fastagc_ff: peak search
-    {
-        float val=fabs(input->buffer_input[i]);
-        if(val>peak_input) peak_input=val;
-    }
-
-    //Determine the maximal peak out of the three blocks
-    float target_peak=peak_input;
-    if(target_peak<input->peak_2) target_peak=input->peak_2;
-    if(target_peak<input->peak_1) target_peak=input->peak_1;
-
-    //we change the gain linearly on the apply_block from the last_gain to target_gain.
-    float target_gain=input->reference/target_peak;
-    if(target_gain>FASTAGC_MAX_GAIN) target_gain=FASTAGC_MAX_GAIN;
-    //fprintf(stderr, "target_gain: %g\n",target_gain);
+        peak_input=fmaxf(peak_input, fabsf(input->buffer_input[i]));
 
+    float target_gain=fastagc_target_gain(input, peak_input);
+    float* buffer_out=input->buffers[input->oldest];
+    float gain=input->last_gain;
+    float dgain=(target_gain-input->last_gain)/input->input_size;
     for(int i=0;i<input->input_size;i++) //@fastagc_ff: apply gain
     {
-        float rate=(float)i/input->input_size;
-        float gain=input->last_gain*(1.0-rate)+target_gain*rate;
-        output[i]=input->buffer_1[i]*gain;
+        output[i]=buffer_out[i]*gain;
+        gain+=dgain;
     }
+    fastagc_shift(input, target_gain);
+}
 
-    //Shift the three buffers
-    float* temp_pointer=input->buffer_1;
-    input->buffer_1=input->buffer_2;
-    input->peak_1=input->peak_2;
-    input->buffer_2=input->buffer_input;
-    input->peak_2=peak_input;
-    input->buffer_input=temp_pointer;
-    input->last_gain=target_gain;
-    //fprintf(stderr,"target_gain=%g\n", target_gain);
+CSDR_TARGET_CLONES
+void fastagc_cc(fastagc_ff_t* input, complexf* output)
+{
+    //Same as fastagc_ff, the peak is the maximal magnitude of the complex samples.
+    complexf* buffer_input=(complexf*)input->buffer_input;
+    float peak_input=0;
+    for(int i=0;i<input->input_size;i++) //@fastagc_cc: peak search
+        peak_input=fmaxf(peak_input, iof(buffer_input,i)*iof(buffer_input,i)+qof(buffer_input,i)*qof(buffer_input,i));
+    peak_input=sqrtf(peak_input);
+
+    float target_gain=fastagc_target_gain(input, peak_input);
+    complexf* buffer_out=(complexf*)input->buffers[input->oldest];
+    float gain=input->last_gain;
+    float dgain=(target_gain-input->last_gain)/input->input_size;
+    for(int i=0;i<input->input_size;i++) //@fastagc_cc: apply gain
+    {
+        iof(output,i)=iof(buffer_out,i)*gain;
+        qof(output,i)=qof(buffer_out,i)*gain;
+        gain+=dgain;
+    }
+    fastagc_shift(input, target_gain);
 }
 
 /*
@@ -1268,6 +1775,38 @@ float fmdemod_atan_cf(complexf* input, float *output, int input_size, float last
     return last_phase;
 }
 
+float fast_atan2f(float y, float x)
+{
+    //Polynomial approximation of atan2, max. error is about 1e-5 rad.
+    //The atan polynomial for the [0,1] range is from Abramowitz & Stegun 4.4.49.
+    //It is branchless, so that loops calling it can be vectorized.
+    float abs_x = fabsf(x);
+    float abs_y = fabsf(y);
+    float max_xy = (abs_x>abs_y) ? abs_x : abs_y;
+    float min_xy = (abs_x>abs_y) ? abs_y : abs_x;
+    float a = (max_xy>0) ? min_xy/max_xy : 0;
+    float s = a*a;
+    float r = a*(0.9998660f+s*(-0.3302995f+s*(0.1801410f+s*(-0.0851330f+s*0.0208351f))));
+    r = (abs_y>abs_x) ? (PI/2)-r : r;
+    r = (x<0) ? PI-r : r;
+    return (y<0) ? -r : r;
+}
+
+CSDR_TARGET_CLONES
+complexf fmdemod_atan_fast_cf(complexf* input, float *output, int input_size, complexf last_sample)
+{
+    //We take the phase of x[n]*conj(x[n-1]) instead of the difference of the phases of x[n] and x[n-1].
+    //It is the same, but it always falls into -PI...PI, so we don't need to unwrap it.
+    output[0] = fast_atan2f(qof(input,0)*last_sample.i-iof(input,0)*last_sample.q, iof(input,0)*last_sample.i+qof(input,0)*last_sample.q)/PI;
+    for (int i=1; i<input_size; i++) //@fmdemod_atan_fast_cf
+    {
+        float re = iof(input,i)*iof(input,i-1)+qof(input,i)*qof(input,i-1);
+        float im = qof(input,i)*iof(input,i-1)-iof(input,i)*qof(input,i-1);
+        output[i] = fast_atan2f(im, re)/PI;
+    }
+    return input[input_size-1];
+}
+
 #define fmdemod_quadri_K 0.340447550238101026565118445432744920253753662109375
 //this constant ensures proper scaling for qa_fmemod testcases for SNR calculation and more.
 
@@ -1287,39 +1826,68 @@ complexf fmdemod_quadri_novect_cf(complexf* input, float* output, int input_size
 }
 
 
+#if defined NEON_OPTS
+#pragma message "Manual NEON optimizations are ON: we have a faster fmdemod_quadri_cf now."
+
+#include <arm_neon.h>
+
 complexf fmdemod_quadri_cf(complexf* input, float* output, int input_size, float *temp, complexf last_sample)
 {
-    float* temp_dq=temp;
-    float* temp_di=temp+input_size;
-
-    temp_dq[0]=qof(input,0)-last_sample.q;
-    for (int i=1; i<input_size; i++) //@fmdemod_quadri_cf: dq
+    //This is the same single pass as the generic version below, 4 samples at a time.
+    //ARMv7 NEON has no vector division, so we take the reciprocal estimate of the denominator,
+    //and refine it with one Newton-Raphson step (that gives about 16 bits of precision).
+    //temp is not used anymore, it is kept for API compatibility.
+    float32x4_t k = vdupq_n_f32(fmdemod_quadri_K);
+    float32x4_t zero = vdupq_n_f32(0);
+    float32x4_t last_i = vdupq_n_f32(last_sample.i);
+    float32x4_t last_q = vdupq_n_f32(last_sample.q);
+    int i;
+    for(i=0; i<=input_size-4; i+=4) //@fmdemod_quadri_cf: fused pass (NEON)
     {
-        temp_dq[i]=qof(input,i)-qof(input,i-1);
+        float32x4x2_t iq = vld2q_f32((float*)(input+i)); //deinterleave: val[0] is I, val[1] is Q
+        float32x4_t prev_i = vextq_f32(last_i, iq.val[0], 3); //the previous sample of each lane
+        float32x4_t prev_q = vextq_f32(last_q, iq.val[1], 3);
+        float32x4_t num = vmlsq_f32(vmulq_f32(iq.val[1], prev_i), iq.val[0], prev_q);
+        float32x4_t den = vmlaq_f32(vmulq_f32(iq.val[0], iq.val[0]), iq.val[1], iq.val[1]);
+        float32x4_t recip = vrecpeq_f32(den);
+        recip = vmulq_f32(vrecpsq_f32(den, recip), recip);
+        float32x4_t result = vmulq_f32(vmulq_f32(num, recip), k);
+        vst1q_f32(output+i, vbslq_f32(vcgtq_f32(den, zero), result, zero));
+        last_i = iq.val[0];
+        last_q = iq.val[1];
     }
-
-    temp_di[0]=iof(input,0)-last_sample.i;
-    for (int i=1; i<input_size; i++) //@fmdemod_quadri_cf: di
+    if(i) last_sample = input[i-1];
+    for(; i<input_size; i++) //@fmdemod_quadri_cf: remaining samples
     {
-        temp_di[i]=iof(input,i)-iof(input,i-1);
+        float den = iof(input,i)*iof(input,i)+qof(input,i)*qof(input,i);
+        output[i] = (den) ? fmdemod_quadri_K*(qof(input,i)*last_sample.i-iof(input,i)*last_sample.q)/den : 0;
+        last_sample = input[i];
     }
+    return input[input_size-1];
+}
 
-    for (int i=0; i<input_size; i++) //@fmdemod_quadri_cf: output numerator
-    {
-        output[i]=(iof(input,i)*temp_dq[i]-qof(input,i)*temp_di[i]);
-    }
-    for (int i=0; i<input_size; i++) //@fmdemod_quadri_cf: output denomiator
-    {
-        temp[i]=iof(input,i)*iof(input,i)+qof(input,i)*qof(input,i);
-    }
-    for (int i=0; i<input_size; i++) //@fmdemod_quadri_cf: output division
+#else
+
+CSDR_TARGET_CLONES
+complexf fmdemod_quadri_cf(complexf* input, float* output, int input_size, float *temp, complexf last_sample)
+{
+    //This used to be done in five passes over temp arrays (dq, di, numerator, denominator, division).
+    //Now it is a single pass: i*dq-q*di is simplified to q[n]*i[n-1]-i[n]*q[n-1],
+    //and the check for zero is written so that the compiler can turn it into a blend, and vectorize the loop.
+    //temp is not used anymore, it is kept for API compatibility.
+    float den = iof(input,0)*iof(input,0)+qof(input,0)*qof(input,0);
+    output[0] = (den) ? fmdemod_quadri_K*(qof(input,0)*last_sample.i-iof(input,0)*last_sample.q)/den : 0;
+    for (int i=1; i<input_size; i++) //@fmdemod_quadri_cf: fused pass
     {
-        output[i]=(temp[i])?fmdemod_quadri_K*output[i]/temp[i]:0;
+        float num = qof(input,i)*iof(input,i-1)-iof(input,i)*qof(input,i-1);
+        float den = iof(input,i)*iof(input,i)+qof(input,i)*qof(input,i);
+        output[i] = (den>0) ? fmdemod_quadri_K*num/den : 0;
     }
-
     return input[input_size-1];
 }
 
+#endif
+
 inline int is_nan(float f)
 {
     //http://stackoverflow.com/questions/570669/checking-if-a-double-or-float-is-nan-in-c
@@ -1340,9 +1908,17 @@ float deemphasis_wfm_ff (float* input, float* output, int input_size, float tau,
     float dt = 1.0/sample_rate;
     float alpha = dt/(tau+dt);
     if(is_nan(last_output)) last_output=0.0; //if last_output is NaN
+    //b[n] = alpha*input[n], so the FIR taps are alpha*(1-alpha)^j
+    float fir[IIR1_LOOKAHEAD_FIR_LENGTH];
+    for(int t=0;t<IIR1_LOOKAHEAD;t++) fir[t]=alpha*powf(1-alpha,t);
+    fir[IIR1_LOOKAHEAD]=0;
+    iir1_lookahead_fir_ff(input, output, input_size, fir);
+
     output[0]=alpha*input[0]+(1-alpha)*last_output;
-    for (int i=1;i<input_size;i++) //@deemphasis_wfm_ff
+    int scalar_size=(input_size<IIR1_LOOKAHEAD)?input_size:IIR1_LOOKAHEAD;
+    for (int i=1;i<scalar_size;i++) //@deemphasis_wfm_ff
        output[i]=alpha*input[i]+(1-alpha)*output[i-1]; //this is the simplest IIR LPF
+    iir1_lookahead_recursion_ff(output, input_size, 1-alpha);
     return output[input_size-1];
 }
 
@@ -1412,34 +1988,257 @@ float get_power_c(complexf* input, int input_size, int decimation)
     return acc;
 }
 
-/*
-  __  __           _       _       _ 
- |  \/  |         | |     | |     |  |
- | \  / | ___   __| |_   _| | __ _|  |_ ___  _ __ ___
- | |\/| |/ _ \ / _` | | | | |/ _` |  __/ _ \| '__/ __|
- | |  | | (_) | (_| | |_| | | (_| |  || (_) | |  \__ \
- |_|  |_|\___/ \__,_|\__,_|_|\__,_|\ __\___/|_|  |___/
-
-*/
+CSDR_TARGET_CLONES
+float get_peak_power_c(complexf* input, int input_size)
+{
+    //the highest power of a single sample
+    float peak = 0;
+    for(int i=0;i<input_size;i++) //@get_peak_power_c
+    {
+        float power = iof(input,i)*iof(input,i)+qof(input,i)*qof(input,i);
+        peak = (power>peak) ? power : peak;
+    }
+    return peak;
+}
 
-void add_dcoffset_cc(complexf* input, complexf* output, int input_size)
+squelch_t squelch_init(float hysteresis_db, int tail_blocks)
 {
-    for(int i=0;i<input_size;i++) iof(output,i)=0.5+iof(input,i)/2;
-    for(int i=0;i<input_size;i++) qof(output,i)=qof(input,i)/2;
+    squelch_t s;
+    s.hysteresis = pow(10, hysteresis_db/10);
+    s.tail_blocks = tail_blocks;
+    s.tail_counter = 0;
+    s.open = 0;
+    return s;
 }
 
-float fmmod_fc(float* input, complexf* output, int input_size, float last_phase)
+int squelch_update(squelch_t* s, float squelch_level, float power)
 {
-    float phase=last_phase;
-    for(int i=0;i<input_size;i++)
+    //It is called once per block with the power of the block, and returns if the squelch is open.
+    //The squelch opens at squelch_level, and closes if the power stays below squelch_level/hysteresis for tail_blocks blocks.
+    //squelch_level = 0 forces the squelch to be open.
+    if(squelch_level==0 || power>=squelch_level)
     {
-        phase+=input[i]*PI;
-        while(phase>PI) phase-=2*PI;
-        while(phase<=-PI) phase+=2*PI;
-        iof(output,i)=cos(phase);
-        qof(output,i)=sin(phase);
+        s->open = 1;
+        s->tail_counter = s->tail_blocks;
     }
-    return phase;
+    else if(s->open && power<squelch_level/s->hysteresis)
+    {
+        if(s->tail_counter>0) s->tail_counter--;
+        else s->open = 0;
+    }
+    return s->open;
+}
+
+//CTCSS and DCS tone squelch.
+//Both signals are below 300 Hz, so the audio is lowpass filtered and decimated to about 1 kHz first.
+
+subaudio_decimator_t subaudio_decimator_init(float input_rate, int max_input_size)
+{
+    subaudio_decimator_t d;
+    d.decimation = MAX_M(1, (int)(input_rate/1000));
+    d.output_rate = input_rate/d.decimation;
+    //passband up to 300 Hz, stopband from 600 Hz (which is below output_rate-300)
+    d.taps_length = firdes_filter_len(300/input_rate);
+    d.taps = (float*)malloc(sizeof(float)*d.taps_length);
+    firdes_lowpass_f(d.taps, d.taps_length, 450/input_rate, WINDOW_DEFAULT);
+    d.buffer = (float*)calloc(d.taps_length-1+max_input_size, sizeof(float));
+    d.buffer_fill = d.taps_length-1;
+    return d;
+}
+
+CSDR_TARGET_CLONES
+int subaudio_decimator_ff(subaudio_decimator_t* d, float* input, float* output, int input_size)
+{
+    //It returns the number of output samples. input_size should not be more than max_input_size.
+    memcpy(d->buffer+d->buffer_fill, input, sizeof(float)*input_size);
+    d->buffer_fill += input_size;
+    int oi = 0, i;
+    for(i=0; i+d->taps_length<=d->buffer_fill; i+=d->decimation)
+    {
+        float acc = 0;
+        for(int ti=0;ti<d->taps_length;ti++) acc += d->buffer[i+ti]*d->taps[ti]; //@subaudio_decimator_ff
+        output[oi++] = acc;
+    }
+    memmove(d->buffer, d->buffer+i, sizeof(float)*(d->buffer_fill-i));
+    d->buffer_fill -= i;
+    return oi;
+}
+
+const float ctcss_tones[CTCSS_NUM_TONES] = {
+    67.0, 69.3, 71.9, 74.4, 77.0, 79.7, 82.5, 85.4, 88.5, 91.5,
+    94.8, 97.4, 100.0, 103.5, 107.2, 110.9, 114.8, 118.8, 123.0, 127.3,
+    131.8, 136.5, 141.3, 146.2, 151.4, 156.7, 159.8, 162.2, 165.5, 167.9,
+    171.3, 173.8, 177.3, 179.9, 183.5, 186.2, 189.9, 192.8, 196.6, 199.5,
+    203.5, 206.5, 210.7, 218.1, 225.7, 229.1, 233.6, 241.8, 250.3, 254.1
+};
+
+int ctcss_tone_index(float frequency)
+{
+    //returns the index of the standard tone closest to frequency, or -1 if it is not a standard tone
+    for(int i=0;i<CTCSS_NUM_TONES;i++) if(fabs(ctcss_tones[i]-frequency)<0.5) return i;
+    return -1;
+}
+
+ctcss_detector_t ctcss_detector_init(float sample_rate, float window_length, float threshold)
+{
+    //window_length is in seconds: the tones are 2.3 Hz apart at least, so it should be 0.4 s or more.
+    ctcss_detector_t d;
+    for(int k=0;k<CTCSS_NUM_TONES;k++)
+    {
+        d.coeff[k] = 2*cos(2*M_PI*ctcss_tones[k]/sample_rate);
+        d.s1[k] = d.s2[k] = 0;
+    }
+    d.energy = 0;
+    d.window_size = window_length*sample_rate;
+    d.counter = 0;
+    d.threshold = threshold;
+    d.tone = -1;
+    return d;
+}
+
+CSDR_TARGET_CLONES
+static void ctcss_goertzel_ff(ctcss_detector_t* d, float* input, int input_size)
+{
+    //All the Goertzel filters are run in one pass, the innermost loop is on the tones, so that it can use SIMD instructions.
+    for(int i=0;i<input_size;i++)
+    {
+        float x = input[i];
+        d->energy += x*x;
+        for(int k=0;k<CTCSS_NUM_TONES;k++) //@ctcss_goertzel_ff
+        {
+            float s0 = x+d->coeff[k]*d->s1[k]-d->s2[k];
+            d->s2[k] = d->s1[k];
+            d->s1[k] = s0;
+        }
+    }
+}
+
+int ctcss_detector_ff(ctcss_detector_t* d, float* input, int input_size)
+{
+    //It returns the index of the tone detected in the last complete window, -1 if none.
+    while(input_size)
+    {
+        int size = MIN_M(input_size, d->window_size-d->counter);
+        ctcss_goertzel_ff(d, input, size);
+        input += size;
+        input_size -= size;
+        d->counter += size;
+        if(d->counter<d->window_size) break;
+
+        //The ratio of the tone power to the total power is 1 for a pure tone.
+        int best = -1;
+        float best_ratio = 0;
+        for(int k=0;k<CTCSS_NUM_TONES;k++)
+        {
+            float power = d->s1[k]*d->s1[k]+d->s2[k]*d->s2[k]-d->coeff[k]*d->s1[k]*d->s2[k];
+            float ratio = (d->energy>0) ? 2*power/(d->window_size*d->energy) : 0;
+            if(ratio>best_ratio) { best_ratio = ratio; best = k; }
+            d->s1[k] = d->s2[k] = 0;
+        }
+        d->tone = (best_ratio>=d->threshold) ? best : -1;
+        d->energy = 0;
+        d->counter = 0;
+    }
+    return d->tone;
+}
+
+uint32_t dcs_codeword(int code)
+{
+    //code is the 9 bit DCS code (3 octal digits). The 23 bit codeword is sent LSB first, again and again:
+    //9 bits of code, 3 bits of 100, then 11 bits of Golay (23,12) parity.
+    uint32_t data = (code & 0x1ff) | 0x800;
+    uint32_t word = data;
+    for(int i=0;i<12;i++)
+    {
+        word <<= 1;
+        if(word & 0x1000) word ^= 0x8ea;
+    }
+    return data | ((word & 0xffe) << 11);
+}
+
+dcs_decoder_t dcs_decoder_init(float sample_rate, int code, int inverted)
+{
+    dcs_decoder_t d;
+    d.codeword = dcs_codeword(code);
+    if(inverted) d.codeword = ~d.codeword & 0x7fffff;
+    d.bit_step = 134.4/sample_rate;
+    d.bit_phase = 0;
+    d.high = d.low = 0;
+    d.decay = d.bit_step/23; //the peak detectors decay in about one codeword, which has both levels in it
+    d.last_level = 0;
+    d.shift_register = 0;
+    d.bits_since_match = 0;
+    d.matches = 0;
+    return d;
+}
+
+static void dcs_decoder_push_bits(dcs_decoder_t* d, float* bit_levels, int num_bits)
+{
+    unsigned char bits[64];
+    binary_slicer_f_u8(bit_levels, bits, num_bits);
+    for(int i=0;i<num_bits;i++)
+    {
+        d->shift_register = (d->shift_register>>1) | (bits[i]<<22);
+        if(d->shift_register==d->codeword) { d->matches++; d->bits_since_match = 0; }
+        else if(++d->bits_since_match>2*23) d->matches = 0; //we have missed the codeword twice
+    }
+}
+
+int dcs_decoder_ff(dcs_decoder_t* d, float* input, int input_size)
+{
+    //It returns 1 if the codeword has been received at least twice in a row, and it has not been missed twice since.
+    float bit_levels[64]; //the signal sampled in the middle of the bits, relative to the slicing level
+    int num_bits = 0;
+    for(int i=0;i<input_size;i++)
+    {
+        float x = input[i];
+        float range = d->high-d->low;
+        d->high = (x>d->high) ? x : d->high-range*d->decay;
+        d->low = (x<d->low) ? x : d->low+range*d->decay;
+        float level = x-(d->high+d->low)/2;
+
+        //Bit clock: the level crossings should be at phase 0, we sample the bits at phase 0.5.
+        if((level>0)!=(d->last_level>0)) d->bit_phase -= 0.2*((d->bit_phase<0.5) ? d->bit_phase : d->bit_phase-1);
+        d->last_level = level;
+        float last_phase = d->bit_phase;
+        d->bit_phase += d->bit_step;
+        if(last_phase<0.5 && d->bit_phase>=0.5) bit_levels[num_bits++] = level;
+        if(d->bit_phase>=1) d->bit_phase -= 1;
+        if(d->bit_phase<0) d->bit_phase += 1;
+        if(num_bits==64) { dcs_decoder_push_bits(d, bit_levels, num_bits); num_bits = 0; }
+    }
+    dcs_decoder_push_bits(d, bit_levels, num_bits);
+    return d->matches>=2;
+}
+
+/*
+  __  __           _       _       _ 
+ |  \/  |         | |     | |     |  |
+ | \  / | ___   __| |_   _| | __ _|  |_ ___  _ __ ___
+ | |\/| |/ _ \ / _` | | | | |/ _` |  __/ _ \| '__/ __|
+ | |  | | (_) | (_| | |_| | | (_| |  || (_) | |  \__ \
+ |_|  |_|\___/ \__,_|\__,_|_|\__,_|\ __\___/|_|  |___/
+
+*/
+
+void add_dcoffset_cc(complexf* input, complexf* output, int input_size)
+{
+    for(int i=0;i<input_size;i++) iof(output,i)=0.5+iof(input,i)/2;
+    for(int i=0;i<input_size;i++) qof(output,i)=qof(input,i)/2;
+}
+
+float fmmod_fc(float* input, complexf* output, int input_size, float last_phase)
+{
+    float phase=last_phase;
+    for(int i=0;i<input_size;i++)
+    {
+        phase+=input[i]*PI;
+        while(phase>PI) phase-=2*PI;
+        while(phase<=-PI) phase+=2*PI;
+        iof(output,i)=cos(phase);
+        qof(output,i)=sin(phase);
+    }
+    return phase;
 }
 
 void fixed_amplitude_cc(complexf* input, complexf* output, int input_size, float new_amplitude)
@@ -1784,19 +2583,46 @@ unsigned long long psk31_varicode_masklen_helper[] =
 
 const int n_psk31_varicode_items = sizeof(psk31_varicode_items) / sizeof(psk31_varicode_item_t);
 
-char psk31_varicode_decoder_push(unsigned long long* status_shr, unsigned char symbol)
+//A character is complete when the shift register ends with "00<code>00". Codes never contain "00", so the code is the bits after the
+//last "00" before the two trailing zero bits. The table gives the character for the last PSK31_VARICODE_TABLE_BITS bits before the two
+//trailing zeros, and 0 if they don't end with "00<code>".
+static char psk31_varicode_decoder_table[1<<PSK31_VARICODE_TABLE_BITS];
+static pthread_once_t psk31_varicode_decoder_table_once = PTHREAD_ONCE_INIT; //the decoders may be called from several threads
+
+static void psk31_varicode_decoder_init_table(void)
 {
-    *status_shr=((*status_shr)<<1)|(!!symbol); //shift new bit in shift register
-    //fprintf(stderr,"*status_shr = %llx\n", *status_shr);
-    if((*status_shr)&0xFFF==0) return 0;
     for(int i=0;i<n_psk31_varicode_items;i++)
     {
-        //fprintf(stderr,"| i = %d | %llx ?= %llx | bitsall = %d\n", i, psk31_varicode_items[i].code<<2, (*status_shr)&psk31_varicode_masklen_helper[(psk31_varicode_items[i].bitcount+4)&63], (psk31_varicode_items[i].bitcount+4)&63);
-        if((psk31_varicode_items[i].code<<2)==((*status_shr)&psk31_varicode_masklen_helper[(psk31_varicode_items[i].bitcount+4)&63]))
-            { /*fprintf(stderr,">>>>>>>>> %d %x %c\n", i,  psk31_varicode_items[i].ascii,  psk31_varicode_items[i].ascii);*/ return psk31_varicode_items[i].ascii; }
+        int bits = psk31_varicode_items[i].bitcount+2; //the code, and "00" before it
+        for(int above=0;above<(1<<(PSK31_VARICODE_TABLE_BITS-bits));above++)
+            psk31_varicode_decoder_table[(above<<bits)|psk31_varicode_items[i].code] = psk31_varicode_items[i].ascii;
+    }
+}
 
+char psk31_varicode_decoder_push(unsigned long long* status_shr, unsigned char symbol)
+{
+    *status_shr=((*status_shr)<<1)|(!!symbol); //shift new bit in shift register
+    if((*status_shr)&3) return 0; //each character is followed by "00"
+    pthread_once(&psk31_varicode_decoder_table_once, psk31_varicode_decoder_init_table);
+    return psk31_varicode_decoder_table[((*status_shr)>>2)&((1<<PSK31_VARICODE_TABLE_BITS)-1)];
+}
+
+int psk31_varicode_decoder_u8_u8(unsigned long long* status_shr, unsigned char* input, char* output, int input_size)
+{
+    //It decodes a whole buffer of symbols (0x00 or 0x01 bytes), and returns the number of characters written to the output.
+    //The output should have space for input_size/3 characters. NUL characters are not output, like with psk31_varicode_decoder_push.
+    pthread_once(&psk31_varicode_decoder_table_once, psk31_varicode_decoder_init_table);
+    unsigned long long shr = *status_shr;
+    int output_size = 0;
+    for(int i=0;i<input_size;i++)
+    {
+        shr=(shr<<1)|(!!input[i]);
+        if(shr&3) continue;
+        char c = psk31_varicode_decoder_table[(shr>>2)&((1<<PSK31_VARICODE_TABLE_BITS)-1)];
+        if(c) output[output_size++] = c;
     }
-    return 0;
+    *status_shr = shr;
+    return output_size;
 }
 
 void psk31_varicode_encoder_u8_u8(unsigned char* input, unsigned char* output, int input_size, int output_max_size, int* input_processed, int* output_size)
@@ -1861,14 +2687,25 @@ rtty_baudot_item_t rtty_baudot_items[] =
 
 const int n_rtty_baudot_items = sizeof(rtty_baudot_items) / sizeof(rtty_baudot_item_t);
 
+static char rtty_baudot_decoder_table[2][32]; //[fig_mode][code]
+static pthread_once_t rtty_baudot_decoder_table_once = PTHREAD_ONCE_INIT;
+
+static void rtty_baudot_decoder_init_table(void)
+{
+    for(int i=0;i<n_rtty_baudot_items;i++)
+    {
+        rtty_baudot_decoder_table[0][rtty_baudot_items[i].code] = rtty_baudot_items[i].ascii_letter;
+        rtty_baudot_decoder_table[1][rtty_baudot_items[i].code] = rtty_baudot_items[i].ascii_figure;
+    }
+}
+
 char rtty_baudot_decoder_lookup(unsigned char* fig_mode, unsigned char c)
 {
     if(c==RTTY_FIGURE_MODE_SELECT_CODE) { *fig_mode=1; return 0; }
     if(c==RTTY_LETTER_MODE_SELECT_CODE) { *fig_mode=0; return 0; }
-    for(int i=0;i<n_rtty_baudot_items;i++)
-        if(rtty_baudot_items[i].code==c)
-            return (*fig_mode) ? rtty_baudot_items[i].ascii_figure : rtty_baudot_items[i].ascii_letter;
-    return 0;
+    if(c>31) return 0;
+    pthread_once(&rtty_baudot_decoder_table_once, rtty_baudot_decoder_init_table);
+    return rtty_baudot_decoder_table[!!*fig_mode][c];
 }
 
 char rtty_baudot_decoder_push(rtty_baudot_decoder_t* s, unsigned char symbol)
@@ -1904,6 +2741,20 @@ char rtty_baudot_decoder_push(rtty_baudot_decoder_t* s, unsigned char symbol)
     return 0;
 }
 
+int rtty_baudot_decoder_u8_u8(rtty_baudot_decoder_t* s, unsigned char* input, char* output, int input_size)
+{
+    //It decodes a whole buffer of symbols (0x00 or 0x01 bytes), and returns the number of characters written to the output.
+    //The output should have space for input_size/7 characters.
+    pthread_once(&rtty_baudot_decoder_table_once, rtty_baudot_decoder_init_table);
+    int output_size = 0;
+    for(int i=0;i<input_size;i++)
+    {
+        char c = rtty_baudot_decoder_push(s, input[i]);
+        if(c) output[output_size++] = c;
+    }
+    return output_size;
+}
+
 #define DEBUG_SERIAL_LINE_DECODER 0
 
 //What has not been checked:
@@ -2135,7 +2986,7 @@ void pll_cc(pll_t* p, complexf* input, float* output_dphase, complexf* output_nc
         if(output_nco) output_nco[i] = current_nco; //we don't output anything if it is a NULL pointer
 
         //accurate phase detector: calculating error from phase offset
-        float input_phase = atan2(iof(input,i),qof(input,i));
+        float input_phase = fast_atan2f(iof(input,i),qof(input,i));
         float new_dphase = input_phase - p->output_phase;
         while(new_dphase>PI) new_dphase-=2*PI;
         while(new_dphase<-PI) new_dphase+=2*PI;
@@ -2165,6 +3016,132 @@ void pll_cc(pll_t* p, complexf* input, float* output_dphase, complexf* output_nc
     }
 }
 
+#define WFM_STEREO_PILOT_FREQ 19000
+#define WFM_STEREO_AUDIO_CUTOFF 15000
+#define WFM_STEREO_NUM_POLY_POINTS 4
+//the resampler always leaves less samples than this unprocessed, and we don't call it with less samples than this
+#define WFM_STEREO_MIN_RESAMPLER_INPUT(s) ((s)->audio_taps_length + WFM_STEREO_NUM_POLY_POINTS + (int)ceilf((s)->decimator_left.rate) + 2)
+
+wfm_stereo_t wfm_stereo_init(int input_rate, int output_rate, float tau, int max_input_size)
+{
+    //The stereo multiplex signal of FM broadcasting looks like this:
+    //  0.9 * [ (L+R)/2 + (L-R)/2 * sin(2*w*t) ] + 0.1 * sin(w*t), where the pilot frequency is w/(2*PI) = 19 kHz.
+    //input_rate should be at least ~120 kHz, so that the L-R signal around 38 kHz is within the band.
+    wfm_stereo_t s;
+    s.input_rate = input_rate;
+    s.output_rate = output_rate;
+    s.tau = tau;
+    s.last_sample.i = s.last_sample.q = 0;
+
+    //We filter the pilot with a complex bandpass filter, so that we can feed its phase to the PLL.
+    s.pilot_taps_length = firdes_filter_len(4000.0/input_rate);
+    complexf* pilot_taps = (complexf*)malloc(sizeof(complexf)*s.pilot_taps_length);
+    //We use the taps in the order of fir_one_pass_ff, so the filter is centered at -19 kHz to let through +19 kHz.
+    firdes_bandpass_c(pilot_taps, s.pilot_taps_length, -(WFM_STEREO_PILOT_FREQ+2000.0)/input_rate, -(WFM_STEREO_PILOT_FREQ-2000.0)/input_rate, WINDOW_DEFAULT);
+    s.pilot_taps_i = (float*)malloc(sizeof(float)*s.pilot_taps_length);
+    s.pilot_taps_q = (float*)malloc(sizeof(float)*s.pilot_taps_length);
+    for(int i=0;i<s.pilot_taps_length;i++)
+    {
+        s.pilot_taps_i[i] = iof(pilot_taps,i);
+        s.pilot_taps_q[i] = qof(pilot_taps,i);
+    }
+    free(pilot_taps);
+    s.mpx = (float*)calloc(max_input_size+s.pilot_taps_length, sizeof(float));
+    s.pilot = (complexf*)malloc(sizeof(complexf)*max_input_size);
+    s.pilot_nco = (complexf*)malloc(sizeof(complexf)*max_input_size);
+
+    //The PLL is started from the nominal pilot frequency, so its bandwidth can be narrow.
+    //(pll_cc measures the phase as atan2(i,q), so it turns in the negative direction.)
+    s.pilot_pll.pll_type = PLL_PI_CONTROLLER;
+    pll_cc_init_pi_controller(&s.pilot_pll, 50.0/input_rate, 1, 1, 0.707);
+    s.pilot_pll.dphase = s.pilot_pll.iir_temp = -2*PI*WFM_STEREO_PILOT_FREQ/input_rate;
+    s.pilot_lock = 0;
+    s.stereo = 0;
+
+    float rate = (float)input_rate/output_rate;
+    float audio_cutoff = WFM_STEREO_AUDIO_CUTOFF;
+    if(audio_cutoff > 0.45*output_rate) audio_cutoff = 0.45*output_rate;
+    s.audio_taps_length = firdes_filter_len(4000.0/input_rate);
+    s.audio_taps = (float*)malloc(sizeof(float)*s.audio_taps_length);
+    firdes_lowpass_f(s.audio_taps, s.audio_taps_length, audio_cutoff/input_rate, WINDOW_DEFAULT);
+    s.decimator_left = fractional_decimator_ff_init(rate, WFM_STEREO_NUM_POLY_POINTS, s.audio_taps, s.audio_taps_length);
+    s.decimator_right = fractional_decimator_ff_init(rate, WFM_STEREO_NUM_POLY_POINTS, s.audio_taps, s.audio_taps_length);
+    int lr_buffer_size = max_input_size + WFM_STEREO_MIN_RESAMPLER_INPUT(&s);
+    s.left = (float*)malloc(sizeof(float)*lr_buffer_size);
+    s.right = (float*)malloc(sizeof(float)*lr_buffer_size);
+    s.lr_size = 0;
+    s.output_left = (float*)malloc(sizeof(float)*(lr_buffer_size/rate+1));
+    s.output_right = (float*)malloc(sizeof(float)*(lr_buffer_size/rate+1));
+    s.deemphasis_last_left = s.deemphasis_last_right = 0;
+    s.output_size = 0;
+    return s;
+}
+
+CSDR_TARGET_CLONES
+void wfm_stereo_cf(complexf* input, short* output, int input_size, wfm_stereo_t* s)
+{
+    //It does FM demodulation, pilot recovery, L-R demodulation, matrixing, resampling and de-emphasis in one step.
+    //The output is interleaved stereo (left, right), s->output_size is the number of sample pairs written.
+    int history = s->pilot_taps_length-1;
+    //fmdemod_quadri_cf would be faster, but its output is the sine of the phase difference, and the distortion at high deviation would ruin the stereo separation.
+    s->last_sample = fmdemod_atan_fast_cf(input, s->mpx+history, input_size, s->last_sample);
+
+    //pilot[i] is the filtered pilot at mpx[i], as the phase of the complex taps starts at zero.
+    for(int i=0;i<input_size;i++)
+    {
+        float acci = 0, accq = 0;
+        for(int ti=0;ti<s->pilot_taps_length;ti++) //@wfm_stereo_cf: pilot filter
+        {
+            acci += s->mpx[i+ti]*s->pilot_taps_i[ti];
+            accq += s->mpx[i+ti]*s->pilot_taps_q[ti];
+        }
+        iof(s->pilot,i) = acci;
+        qof(s->pilot,i) = accq;
+    }
+    pll_cc(&s->pilot_pll, s->pilot, NULL, s->pilot_nco, input_size);
+
+    //If pilot = cos(p), then pilot_nco = cos(p) + j*sin(p), and the 38 kHz subcarrier is sin(2*(p+PI/2)) = -2*cos(p)*sin(p).
+    float* left = s->left + s->lr_size;
+    float* right = s->right + s->lr_size;
+    for(int i=0;i<input_size;i++)
+    {
+        float mpx = s->mpx[i];
+        float ni = iof(s->pilot_nco,i), nq = qof(s->pilot_nco,i);
+        float pilot_abs = sqrtf(iof(s->pilot,i)*iof(s->pilot,i)+qof(s->pilot,i)*qof(s->pilot,i));
+        float phase_error_cos = (pilot_abs>0) ? (iof(s->pilot,i)*ni+qof(s->pilot,i)*nq)/pilot_abs : 0;
+        s->pilot_lock += (phase_error_cos - s->pilot_lock) * 1e-4;
+        //switch between mono and stereo with hysteresis
+        if(s->pilot_lock > 0.7) s->stereo = 1;
+        else if(s->pilot_lock < 0.5) s->stereo = 0;
+        float diff = (s->stereo) ? -4*mpx*ni*nq : 0; //2*mpx*subcarrier
+        left[i] = mpx + diff;
+        right[i] = mpx - diff;
+    }
+    memmove(s->mpx, s->mpx+input_size, sizeof(float)*history);
+    s->lr_size += input_size;
+    s->output_size = 0;
+    if(s->lr_size < WFM_STEREO_MIN_RESAMPLER_INPUT(s)) return;
+
+    //The left and right decimators always process the same number of samples.
+    fractional_decimator_ff(s->left, s->output_left, s->lr_size, &s->decimator_left);
+    fractional_decimator_ff(s->right, s->output_right, s->lr_size, &s->decimator_right);
+    s->lr_size -= s->decimator_left.input_processed;
+    memmove(s->left, s->left+s->decimator_left.input_processed, sizeof(float)*s->lr_size);
+    memmove(s->right, s->right+s->decimator_right.input_processed, sizeof(float)*s->lr_size);
+    s->output_size = s->decimator_left.output_size;
+
+    s->deemphasis_last_left = deemphasis_wfm_ff(s->output_left, s->output_left, s->output_size, s->tau, s->output_rate, s->deemphasis_last_left);
+    s->deemphasis_last_right = deemphasis_wfm_ff(s->output_right, s->output_right, s->output_size, s->tau, s->output_rate, s->deemphasis_last_right);
+    for(int i=0;i<s->output_size;i++) //@wfm_stereo_cf: interleave and clip
+    {
+        float l = s->output_left[i], r = s->output_right[i];
+        l = (l>1) ? 1 : ((l<-1) ? -1 : l);
+        r = (r>1) ? 1 : ((r<-1) ? -1 : r);
+        output[2*i] = l*SHRT_MAX;
+        output[2*i+1] = r*SHRT_MAX;
+    }
+}
+
 void octave_plot_point_on_cplxsig(complexf* signal, int signal_size, float error, int index, int correction_offset, char* writefiles_path, int points_size, ...)
 {
     static int figure_output_counter = 0;
@@ -2223,9 +3200,26 @@ timing_recovery_state_t timing_recovery_init(timing_recovery_algorithm_t algorit
     return to_return;
 }
 
+timing_recovery_state_t timing_recovery_fractional_init(timing_recovery_algorithm_t algorithm, float samples_per_symbol, int use_q, float loop_gain, float max_error)
+{
+    //samples_per_symbol can be fractional, and it should be at least 2.
+    timing_recovery_state_t to_return = timing_recovery_init(algorithm, (int)samples_per_symbol, use_q, loop_gain, max_error, -1, NULL);
+    to_return.samples_per_symbol = samples_per_symbol;
+    to_return.symbol_index = 0;
+    to_return.rate_correction = 0;
+    to_return.last_symbol.i = to_return.last_symbol.q = 0;
+    return to_return;
+}
+
+int timing_recovery_is_fractional(timing_recovery_algorithm_t algorithm)
+{
+    return algorithm == TIMING_RECOVERY_ALGORITHM_GARDNER_FARROW || algorithm == TIMING_RECOVERY_ALGORITHM_MUELLER_MULLER;
+}
+
 #define MTIMINGR_HDEBUG 0
 
-void timing_recovery_cc(complexf* input, complexf* output, int input_size, float* timing_error, int* sampled_indexes, timing_recovery_state_t* state)
+//The debug parameter is a constant at the call sites, so the octave plotting is compiled out of the version without debug.
+static inline void timing_recovery_integer_cc(complexf* input, complexf* output, int input_size, float* timing_error, int* sampled_indexes, timing_recovery_state_t* state, int debug)
 {
     //We always assume that the input starts at center of the first symbol cross before the first symbol.
     //Last time we consumed that much from the input samples that it is there.
@@ -2238,7 +3232,7 @@ void timing_recovery_cc(complexf* input, complexf* output, int input_size, float
     float error;
     int el_point_left_index, el_point_right_index, el_point_mid_index;
     int si = 0;
-    if(state->debug_every_nth>=0) fprintf(stderr, "disp(\"begin timing_recovery_cc\");\n");
+    if(debug) fprintf(stderr, "disp(\"begin timing_recovery_cc\");\n");
     if(MTIMINGR_HDEBUG) fprintf(stderr, "timing_recovery_cc started, nsb = %d, nshb = %d, nsqb = %d\n", num_samples_bit, num_samples_halfbit, num_samples_quarterbit);
     {
         for(;;)
@@ -2289,7 +3283,7 @@ void timing_recovery_cc(complexf* input, complexf* output, int input_size, float
             
             if(error>state->max_error) error=state->max_error;
             if(error<-state->max_error) error=-state->max_error;
-            if(state->debug_every_nth>=0)
+            if(debug)
             {
                 if(state->debug_every_nth==0 || state->debug_phase==0) 
                 {
@@ -2322,6 +3316,84 @@ void timing_recovery_cc(complexf* input, complexf* output, int input_size, float
     state->last_correction_offset = correction_offset;
 }
 
+//Cubic Lagrange interpolation in Farrow structure at input[index+mu], 0<=mu<1. It uses input[index-1 ... index+2].
+static inline complexf timing_recovery_farrow(complexf* input, int index, float mu)
+{
+    complexf* x = input+index-1;
+    complexf result;
+    float c1 = -iof(x,0)/3-iof(x,1)/2+iof(x,2)-iof(x,3)/6;
+    float c2 = iof(x,0)/2-iof(x,1)+iof(x,2)/2;
+    float c3 = -iof(x,0)/6+iof(x,1)/2-iof(x,2)/2+iof(x,3)/6;
+    iofv(result) = ((c3*mu+c2)*mu+c1)*mu+iof(x,1);
+    c1 = -qof(x,0)/3-qof(x,1)/2+qof(x,2)-qof(x,3)/6;
+    c2 = qof(x,0)/2-qof(x,1)+qof(x,2)/2;
+    c3 = -qof(x,0)/6+qof(x,1)/2-qof(x,2)/2+qof(x,3)/6;
+    qofv(result) = ((c3*mu+c2)*mu+c1)*mu+qof(x,1);
+    return result;
+}
+
+static inline complexf timing_recovery_interpolate(complexf* input, float index)
+{
+    int integer_index = (int)index;
+    return timing_recovery_farrow(input, integer_index, index-integer_index);
+}
+
+static void timing_recovery_fractional_cc(complexf* input, complexf* output, int input_size, float* timing_error, int* sampled_indexes, timing_recovery_state_t* state)
+{
+    //Gardner: error = (y[k-1]-y[k]) * y[k-1/2]
+    //Mueller and Muller: error = d[k-1]*y[k] - d[k]*y[k-1], where d[k] is the decision on y[k]
+    //The error is negative if we sample too late, and it goes into a second order loop filter.
+    float sps = state->samples_per_symbol;
+    int history = (int)ceilf(sps/2)+2; //the Gardner mid point and the interpolator need this many samples before the symbol
+    float index = state->symbol_index;
+    if(index<history) index = history; //first call
+    float alpha = state->loop_gain*sps/4; //proportional
+    float beta = alpha*alpha/sps/4; //integral
+    float max_rate_correction = sps/10;
+    int si = 0;
+    while((int)index+2<input_size && si<input_size)
+    {
+        complexf symbol = timing_recovery_interpolate(input, index);
+        complexf last = state->last_symbol;
+        float error;
+        if(state->algorithm == TIMING_RECOVERY_ALGORITHM_GARDNER_FARROW)
+        {
+            complexf mid = timing_recovery_interpolate(input, index-sps/2);
+            error = (iofv(last)-iofv(symbol))*iofv(mid);
+            if(state->use_q) error = (error+(qofv(last)-qofv(symbol))*qofv(mid))/2;
+        }
+        else
+        {
+            error = ((iofv(last)>0)?1:-1)*iofv(symbol)-((iofv(symbol)>0)?1:-1)*iofv(last);
+            if(state->use_q) error = (error+((qofv(last)>0)?1:-1)*qofv(symbol)-((qofv(symbol)>0)?1:-1)*qofv(last))/2;
+        }
+        if(timing_error) timing_error[si]=error;
+        if(sampled_indexes) sampled_indexes[si]=(int)(index+0.5);
+        output[si++] = symbol;
+        state->last_symbol = symbol;
+
+        if(error>state->max_error) error=state->max_error;
+        if(error<-state->max_error) error=-state->max_error;
+        state->rate_correction += beta*error;
+        if(state->rate_correction>max_rate_correction) state->rate_correction=max_rate_correction;
+        if(state->rate_correction<-max_rate_correction) state->rate_correction=-max_rate_correction;
+        index += sps+state->rate_correction+alpha*error;
+    }
+    //We keep history samples before the next symbol for the next call.
+    state->input_processed = MAX_M(0, (int)index-history);
+    state->symbol_index = index-state->input_processed;
+    state->output_size = si;
+}
+
+void timing_recovery_cc(complexf* input, complexf* output, int input_size, float* timing_error, int* sampled_indexes, timing_recovery_state_t* state)
+{
+    //It processes as many symbols as possible, then the caller should drop state->input_processed samples from the beginning of the input,
+    //and fill the buffer again for the next call.
+    if(timing_recovery_is_fractional(state->algorithm)) timing_recovery_fractional_cc(input, output, input_size, timing_error, sampled_indexes, state);
+    else if(state->debug_every_nth>=0) timing_recovery_integer_cc(input, output, input_size, timing_error, sampled_indexes, state, 1);
+    else timing_recovery_integer_cc(input, output, input_size, timing_error, sampled_indexes, state, 0);
+}
+
 #define MTIMINGR_GAS(NAME) \
     if(!strcmp( #NAME , input )) return TIMING_RECOVERY_ALGORITHM_ ## NAME;
 
@@ -2329,6 +3401,8 @@ timing_recovery_algorithm_t timing_recovery_get_algorithm_from_string(char* inpu
 {
     MTIMINGR_GAS(GARDNER);
     MTIMINGR_GAS(EARLYLATE);
+    MTIMINGR_GAS(GARDNER_FARROW);
+    MTIMINGR_GAS(MUELLER_MULLER);
     return TIMING_RECOVERY_ALGORITHM_DEFAULT;
 }
 
@@ -2339,6 +3413,8 @@ char* timing_recovery_get_string_from_algorithm(timing_recovery_algorithm_t algo
 {
     MTIMINGR_GSA(GARDNER);
     MTIMINGR_GSA(EARLYLATE);
+    MTIMINGR_GSA(GARDNER_FARROW);
+    MTIMINGR_GSA(MUELLER_MULLER);
     return "INVALID";
 }
 
@@ -2367,7 +3443,7 @@ void bpsk_costas_loop_cc(complexf* input, complexf* output, int input_size, floa
         float error = 0;
         if(s->decision_directed)
         {
-            float output_phase = atan2(qof(output,i),iof(output,i));
+            float output_phase = fast_atan2f(qof(output,i),iof(output,i));
             if (fabs(output_phase)<PI/2) 
                 error = -output_phase;
             else
@@ -2601,6 +3677,268 @@ int bfsk_demod_cf(complexf* input, float* output, int input_size, complexf* mark
     return input_size-taps_length+1;
 }
 
+#ifdef USE_FFTW
+
+//PSK31 skimmer: all the PSK31 signals in the audio passband are found with FFT, and decoded in the same process.
+//Each channel is a lightweight decoder: channel filter -> AGC -> timing_recovery_cc -> DBPSK -> varicode.
+//There is no carrier recovery: DBPSK only needs the phase difference between two symbols, and a slow AFC follows the frequency drift.
+
+#define PSK31_SKIMMER_CHANNEL_RATE 250 //8 samples per symbol
+#define PSK31_SKIMMER_HALF_BANDWIDTH 20 //Hz, the signal power is measured over the bandwidth of a signal
+#define PSK31_SKIMMER_MIN_SPACING 40 //Hz, we don't start a new channel closer than this to an existing one
+#define PSK31_SKIMMER_TEXT_SIZE 256
+#define PSK31_SKIMMER_FLUSH_SECONDS 2 //we output the text of a channel at least this often
+#define PSK31_SKIMMER_TIMEOUT_SECONDS 3 //we stop a channel if there is no signal for this long
+
+psk31_skimmer_t psk31_skimmer_init(float sample_rate, float low_frequency, float high_frequency, float threshold_db, int max_channels, int max_input_size)
+{
+    psk31_skimmer_t s;
+    memset(&s, 0, sizeof(s));
+    //The caller should check the sample rate: if it is out of range, nothing is allocated, and s.fft_size is 0.
+    s.fft_size = next_pow2((int)(sample_rate/4)); //about 4 Hz resolution
+    if(!(sample_rate>=PSK31_SKIMMER_MIN_SAMPLE_RATE && sample_rate<=PSK31_SKIMMER_MAX_SAMPLE_RATE) || s.fft_size<=0) { s.fft_size = 0; return s; }
+    s.sample_rate = sample_rate;
+    s.decimation = MAX_M(1, (int)(sample_rate/PSK31_SKIMMER_CHANNEL_RATE+0.5));
+    s.max_input_size = max_input_size;
+    s.low_frequency = low_frequency;
+    s.high_frequency = high_frequency;
+    s.threshold = pow(10, threshold_db/10);
+
+    //The channel filter lets the PSK31 signal through (about 60 Hz wide), and it is applied at the decimated rate only.
+    s.taps_length = firdes_filter_len(60/sample_rate);
+    s.lowpass_taps = (float*)malloc(sizeof(float)*s.taps_length);
+    firdes_lowpass_f(s.lowpass_taps, s.taps_length, 40/sample_rate, WINDOW_DEFAULT);
+    s.buffer = (float*)calloc(s.taps_length-1+max_input_size, sizeof(float));
+    s.buffer_fill = s.taps_length-1;
+
+    //We allocate everything for the channels here, so that starting a channel is cheap.
+    int baseband_max_size = max_input_size/s.decimation+64;
+    s.max_channels = max_channels;
+    s.channels = (psk31_channel_t*)calloc(max_channels, sizeof(psk31_channel_t));
+    for(int i=0;i<max_channels;i++)
+    {
+        psk31_channel_t* c = s.channels+i;
+        c->frequency = 0; //inactive
+        c->taps_i = (float*)malloc(sizeof(float)*s.taps_length);
+        c->taps_q = (float*)malloc(sizeof(float)*s.taps_length);
+        c->baseband = (complexf*)malloc(sizeof(complexf)*baseband_max_size);
+        c->symbols = (complexf*)malloc(sizeof(complexf)*baseband_max_size);
+        c->text = (char*)malloc(PSK31_SKIMMER_TEXT_SIZE);
+    }
+
+    s.fft_input = (float*)fft_malloc(sizeof(float)*s.fft_size);
+    s.fft_output = (complexf*)fft_malloc(sizeof(complexf)*(s.fft_size/2+1));
+    s.fft_plan = make_fft_r2c(s.fft_size, s.fft_input, s.fft_output, 0);
+    s.fft_input_fill = 0;
+    s.window = (float*)malloc(sizeof(float)*s.fft_size);
+    for(int i=0;i<s.fft_size;i++) s.window[i] = 0.5-0.5*cos(2*PI*i/s.fft_size);
+    s.average_power = (float*)calloc(s.fft_size/2+1, sizeof(float));
+    s.signal_power = (float*)calloc(s.fft_size/2+1, sizeof(float));
+    s.sort_temp = (float*)malloc(sizeof(float)*(s.fft_size/2+1));
+    return s;
+}
+
+static int psk31_skimmer_compare_floats(const void* a, const void* b)
+{
+    float fa = *(const float*)a, fb = *(const float*)b;
+    return (fa>fb)-(fa<fb);
+}
+
+static void psk31_skimmer_start_channel(psk31_skimmer_t* s, psk31_channel_t* c, float frequency)
+{
+    c->frequency = frequency;
+    //The filter is shifted to the channel frequency: taps[j] = lowpass_taps[j] * e^(-j*omega*j).
+    //The sum of input[n-L+1+j] * taps[j] is then multiplied by e^(-j*omega*(n-L+1)) to get the baseband sample.
+    double omega = 2*M_PI*frequency/s->sample_rate;
+    for(int j=0;j<s->taps_length;j++)
+    {
+        c->taps_i[j] = s->lowpass_taps[j]*cos(omega*j);
+        c->taps_q[j] = -s->lowpass_taps[j]*sin(omega*j);
+    }
+    c->phase = 0;
+    c->dphase = -omega*s->decimation;
+    c->amplitude = 0;
+    float samples_per_symbol = (s->sample_rate/s->decimation)/31.25;
+    c->timing = timing_recovery_fractional_init(TIMING_RECOVERY_ALGORITHM_GARDNER_FARROW, samples_per_symbol, 1, 0.3, 2);
+    c->baseband_size = 0;
+    c->last_symbol.i = c->last_symbol.q = 0;
+    c->varicode_status = 0;
+    c->frames_since_detected = 0;
+    c->frames_since_flush = 0;
+    c->text_length = 0;
+}
+
+static int psk31_skimmer_flush(psk31_channel_t* c, char* output, int output_max_size)
+{
+    //It writes a line of "<frequency> <text>" to the output, and returns its length.
+    if(!c->text_length) return 0;
+    c->text[c->text_length] = 0;
+    int length = snprintf(output, output_max_size, "%.1f %s\n", c->frequency, c->text);
+    if(length>=output_max_size) return 0; //no space, we try again later
+    c->text_length = 0;
+    c->frames_since_flush = 0;
+    return length;
+}
+
+static int psk31_skimmer_detect(psk31_skimmer_t* s, char* output, int output_max_size)
+{
+    //It runs on every FFT frame: it finds the signals, starts and stops the channels, and outputs the text of the channels.
+    int output_size = 0;
+    int bins = s->fft_size/2+1;
+    float bin_hz = s->sample_rate/s->fft_size;
+    int frames_per_second = MAX_M(1, (int)(s->sample_rate/s->fft_size+0.5));
+    for(int i=0;i<s->fft_size;i++) s->fft_input[i] *= s->window[i];
+    fft_execute(s->fft_plan);
+    for(int k=0;k<bins;k++)
+    {
+        float power = iof(s->fft_output,k)*iof(s->fft_output,k)+qof(s->fft_output,k)*qof(s->fft_output,k);
+        s->average_power[k] = 0.7*s->average_power[k]+0.3*power;
+    }
+
+    int half_width = (int)(PSK31_SKIMMER_HALF_BANDWIDTH/bin_hz+0.5);
+    int low_bin = MAX_M(half_width+1, (int)ceilf(s->low_frequency/bin_hz));
+    int high_bin = MIN_M(bins-half_width-2, (int)(s->high_frequency/bin_hz));
+    if(high_bin<=low_bin) return 0;
+    float sum = 0;
+    for(int j=low_bin-half_width;j<=low_bin+half_width;j++) sum += s->average_power[j];
+    for(int k=low_bin;k<=high_bin;k++)
+    {
+        s->signal_power[k] = sum;
+        sum += s->average_power[k+half_width+1]-s->average_power[k-half_width];
+    }
+    //the median is a good estimate for the noise floor if most of the band is free
+    int num_bins = high_bin-low_bin+1;
+    memcpy(s->sort_temp, s->signal_power+low_bin, sizeof(float)*num_bins);
+    qsort(s->sort_temp, num_bins, sizeof(float), psk31_skimmer_compare_floats);
+    float signal_threshold = s->sort_temp[num_bins/2]*s->threshold;
+
+    for(int i=0;i<s->max_channels;i++) if(s->channels[i].frequency) { s->channels[i].frames_since_detected++; s->channels[i].frames_since_flush++; }
+    for(int k=low_bin+1;k<high_bin;k++)
+    {
+        float p = s->signal_power[k];
+        if(p<signal_threshold) continue;
+        int is_peak = 1;
+        for(int j=MAX_M(low_bin,k-half_width);j<=MIN_M(high_bin,k+half_width) && is_peak;j++) if(s->signal_power[j]>p || (j<k && s->signal_power[j]==p)) is_peak = 0;
+        if(!is_peak) continue;
+        //parabolic interpolation between the bins
+        float pl = s->signal_power[k-1], pr = s->signal_power[k+1];
+        float denominator = pl-2*p+pr;
+        float frequency = (k+((denominator<0)?(pl-pr)/(2*denominator):0))*bin_hz;
+        int nearest = -1;
+        float nearest_distance = s->sample_rate;
+        int free_channel = -1;
+        for(int i=0;i<s->max_channels;i++)
+        {
+            if(!s->channels[i].frequency) { if(free_channel<0) free_channel = i; continue; }
+            float distance = fabs(s->channels[i].frequency-frequency);
+            if(distance<nearest_distance) { nearest_distance = distance; nearest = i; }
+        }
+        if(nearest>=0 && nearest_distance<PSK31_SKIMMER_MIN_SPACING/2) s->channels[nearest].frames_since_detected = 0;
+        else if(nearest_distance>=PSK31_SKIMMER_MIN_SPACING && free_channel>=0) psk31_skimmer_start_channel(s, s->channels+free_channel, frequency);
+    }
+
+    for(int i=0;i<s->max_channels;i++)
+    {
+        psk31_channel_t* c = s->channels+i;
+        if(!c->frequency) continue;
+        int timeout = c->frames_since_detected>PSK31_SKIMMER_TIMEOUT_SECONDS*frames_per_second;
+        if(timeout || c->frames_since_flush>=PSK31_SKIMMER_FLUSH_SECONDS*frames_per_second)
+            output_size += psk31_skimmer_flush(c, output+output_size, output_max_size-output_size);
+        if(timeout && !c->text_length) c->frequency = 0;
+    }
+    return output_size;
+}
+
+CSDR_TARGET_CLONES
+static void psk31_skimmer_channel_filter(float* input, complexf* output, int output_size, int decimation, float* taps_i, float* taps_q, int taps_length)
+{
+    for(int oi=0;oi<output_size;oi++)
+    {
+        float* x = input+oi*decimation;
+        float acci = 0, accq = 0;
+        for(int ti=0;ti<taps_length;ti++) //@psk31_skimmer_channel_filter
+        {
+            acci += x[ti]*taps_i[ti];
+            accq += x[ti]*taps_q[ti];
+        }
+        iof(output,oi) = acci;
+        qof(output,oi) = accq;
+    }
+}
+
+static int psk31_skimmer_decode(psk31_skimmer_t* s, psk31_channel_t* c, int num_outputs, char* output, int output_max_size)
+{
+    complexf* baseband = c->baseband+c->baseband_size;
+    psk31_skimmer_channel_filter(s->buffer, baseband, num_outputs, s->decimation, c->taps_i, c->taps_q, s->taps_length);
+    for(int i=0;i<num_outputs;i++)
+    {
+        //shift to baseband, and normalize with the average amplitude (the amplitude goes to zero at every phase reversal, so we average over a few symbols)
+        float cosv = cos(c->phase), sinv = sin(c->phase);
+        float bi = iof(baseband,i), bq = qof(baseband,i);
+        c->amplitude = 0.98*c->amplitude + 0.02*sqrtf(bi*bi+bq*bq);
+        float gain = (c->amplitude>0) ? 1/c->amplitude : 0;
+        iof(baseband,i) = gain*(bi*cosv-bq*sinv);
+        qof(baseband,i) = gain*(bi*sinv+bq*cosv);
+        c->phase = fmod(c->phase+c->dphase, 2*M_PI);
+    }
+    c->baseband_size += num_outputs;
+
+    timing_recovery_cc(c->baseband, c->symbols, c->baseband_size, NULL, NULL, &c->timing);
+    int output_size = 0;
+    for(int i=0;i<c->timing.output_size;i++)
+    {
+        //DBPSK: a phase reversal is 0, no change is 1
+        complexf symbol = c->symbols[i];
+        float di = iofv(symbol)*iofv(c->last_symbol)+qofv(symbol)*qofv(c->last_symbol); //symbol * conj(last_symbol)
+        float dq = qofv(symbol)*iofv(c->last_symbol)-iofv(symbol)*qofv(c->last_symbol);
+        unsigned char bit = di > 0;
+        c->last_symbol = symbol;
+        //AFC: the phase difference is 0 or pi, anything else (after squaring) is caused by frequency error
+        float phase_error = atan2f(2*di*dq, di*di-dq*dq)/2;
+        c->dphase -= 0.01*phase_error/c->timing.samples_per_symbol;
+        c->frequency += 0.01*phase_error/c->timing.samples_per_symbol*s->sample_rate/(2*M_PI*s->decimation);
+        char character = psk31_varicode_decoder_push(&c->varicode_status, bit);
+        if(!character || c->frames_since_detected>1) continue; //we don't output what we decode from noise
+        if(character=='\n' || character=='\r') character = ' ';
+        if(character<' ') continue;
+        c->text[c->text_length++] = character;
+        if(c->text_length>=PSK31_SKIMMER_TEXT_SIZE-1) output_size += psk31_skimmer_flush(c, output+output_size, output_max_size-output_size);
+        if(c->text_length>=PSK31_SKIMMER_TEXT_SIZE-1) c->text_length--; //no space in the output, we drop a character
+    }
+    c->baseband_size -= c->timing.input_processed;
+    memmove(c->baseband, c->baseband+c->timing.input_processed, sizeof(complexf)*c->baseband_size);
+    return output_size;
+}
+
+int psk31_skimmer_f_u8(psk31_skimmer_t* s, float* input, int input_size, char* output, int output_max_size)
+{
+    //The input is real audio, e.g. from an SSB demodulator. The output is text, a line for each channel: "<frequency in Hz> <decoded text>".
+    //It returns the number of characters written to the output. input_size should not be more than max_input_size.
+    int output_size = 0;
+    for(int i=0;i<input_size;)
+    {
+        int size = MIN_M(input_size-i, s->fft_size-s->fft_input_fill);
+        memcpy(s->fft_input+s->fft_input_fill, input+i, sizeof(float)*size);
+        s->fft_input_fill += size;
+        i += size;
+        if(s->fft_input_fill<s->fft_size) break;
+        output_size += psk31_skimmer_detect(s, output+output_size, output_max_size-output_size);
+        s->fft_input_fill = 0;
+    }
+
+    memcpy(s->buffer+s->buffer_fill, input, sizeof(float)*input_size);
+    s->buffer_fill += input_size;
+    int num_outputs = (s->buffer_fill>=s->taps_length) ? (s->buffer_fill-s->taps_length)/s->decimation+1 : 0;
+    for(int i=0;i<s->max_channels;i++)
+        if(s->channels[i].frequency) output_size += psk31_skimmer_decode(s, s->channels+i, num_outputs, output+output_size, output_max_size-output_size);
+    int consumed = num_outputs*s->decimation;
+    s->buffer_fill -= consumed;
+    memmove(s->buffer, s->buffer+consumed, sizeof(float)*s->buffer_fill);
+    return output_size;
+}
+
+#endif
+
 /*
   _____        _                                            _
  |  __ \      | |                                          (_)
@@ -2611,82 +3949,250 @@ int bfsk_demod_cf(complexf* input, float* output, int input_size, complexf* mark
 
 */
 
+//The conversions from float clip the values out of -1...1 instead of letting them wrap around, and round to the nearest integer.
+//The *_novect versions do the same one sample at a time, they are kept as a reference for the vectorized versions.
+
+CSDR_TARGET_CLONES
 void convert_u8_f(unsigned char* input, float* output, int input_size)
 {
-    for(int i=0;i<input_size;i++) output[i]=((float)input[i])/(UCHAR_MAX/2.0)-1.0; //@convert_u8_f
+    for(int i=0;i<input_size;i++) output[i]=((float)input[i])/(UCHAR_MAX/2.0f)-1.0f; //@convert_u8_f
 }
 
+CSDR_TARGET_CLONES
 void convert_s8_f(signed char* input, float* output, int input_size)
 {
     for(int i=0;i<input_size;i++) output[i]=((float)input[i])/SCHAR_MAX; //@convert_s8_f
 }
 
+CSDR_TARGET_CLONES
 void convert_s16_f(short* input, float* output, int input_size)
 {
     for(int i=0;i<input_size;i++) output[i]=(float)input[i]/SHRT_MAX; //@convert_s16_f
 }
 
+CSDR_TARGET_CLONES
+void convert_s32_f(int* input, float* output, int input_size)
+{
+    for(int i=0;i<input_size;i++) output[i]=(float)input[i]/INT_MAX; //@convert_s32_f
+}
+
+CSDR_TARGET_CLONES
 void convert_f_u8(float* input, unsigned char* output, int input_size)
 {
-    for(int i=0;i<input_size;i++) output[i]=input[i]*UCHAR_MAX*0.5+128; //@convert_f_u8
+    for(int i=0;i<input_size;i++) //@convert_f_u8
+    {
+        float v = input[i]*(UCHAR_MAX/2.0f)+128;
+        v = (v>UCHAR_MAX) ? UCHAR_MAX : v;
+        v = (v<0) ? 0 : v;
+        output[i] = v;
+    }
     //128 above is the correct value to add. In any other case a DC component
     //of at least -60 dB is shown on the FFT plot after convert_f_u8 -> convert_u8_f
+    //(it is 127.5 plus 0.5 for rounding, as v is never negative when it is truncated)
 }
 
+CSDR_TARGET_CLONES
 void convert_f_s8(float* input, signed char* output, int input_size)
 {
-    for(int i=0;i<input_size;i++) output[i]=input[i]*SCHAR_MAX; //@convert_f_s8
+    for(int i=0;i<input_size;i++) //@convert_f_s8
+    {
+        float v = input[i]*SCHAR_MAX;
+        v = (v>SCHAR_MAX) ? SCHAR_MAX : v;
+        v = (v<SCHAR_MIN) ? SCHAR_MIN : v;
+        output[i] = v+((v<0)?-0.5f:0.5f);
+    }
 }
 
+CSDR_TARGET_CLONES
 void convert_f_s16(float* input, short* output, int input_size)
 {
-    /*for(int i=0;i<input_size;i++)
+    for(int i=0;i<input_size;i++) //@convert_f_s16
     {
-        if(input[i]>1.0) input[i]=1.0;
-        if(input[i]<-1.0) input[i]=-1.0;
-    }*/
-    for(int i=0;i<input_size;i++) output[i]=input[i]*SHRT_MAX; //@convert_f_s16
+        float v = input[i]*SHRT_MAX;
+        v = (v>SHRT_MAX) ? SHRT_MAX : v;
+        v = (v<SHRT_MIN) ? SHRT_MIN : v;
+        output[i] = v+((v<0)?-0.5f:0.5f);
+    }
+}
+
+CSDR_TARGET_CLONES
+void convert_f_s32(float* input, int* output, int input_size)
+{
+    //float doesn't have enough precision near INT_MAX, so we clip in double
+    for(int i=0;i<input_size;i++) //@convert_f_s32
+    {
+        double v = input[i]*(double)INT_MAX;
+        v = (v>INT_MAX) ? INT_MAX : v;
+        v = (v<INT_MIN) ? INT_MIN : v;
+        output[i] = v+((v<0)?-0.5:0.5);
+    }
 }
 
 void convert_i16_f(short* input, float* output, int input_size) { convert_s16_f(input, output, input_size); }
 void convert_f_i16(float* input, short* output, int input_size) { convert_f_s16(input, output, input_size); }
 
-void convert_f_s24(float* input, unsigned char* output, int input_size, int bigendian)
+//s24 is 3 bytes per sample. As in the previous versions, if bigendian is set, the least significant byte comes first,
+//otherwise the most significant byte comes first.
+#define S24_MAX ((1<<23)-1)
+#define S24_MIN (-(1<<23))
+
+static inline void convert_f_s24_const(float* input, unsigned char* output, int input_size, const int lsb_index)
 {
-    int k=0;
-    if(bigendian) for(int i=0;i<input_size;i++)
+    //lsb_index is a constant in the callers below, so that the byte shuffling can be vectorized
+    for(int i=0;i<input_size;i++) //@convert_f_s24
     {
-        int temp=input[i]*(INT_MAX>>8);
-        unsigned char* ptemp=(unsigned char*)&temp;
-        output[k++]=*ptemp;
-        output[k++]=*(ptemp+1);
-        output[k++]=*(ptemp+2);
+        float v = input[i]*S24_MAX;
+        v = (v>S24_MAX) ? S24_MAX : v;
+        v = (v<S24_MIN) ? S24_MIN : v;
+        int temp = v+((v<0)?-0.5f:0.5f);
+        output[3*i+lsb_index]=temp;
+        output[3*i+1]=temp>>8;
+        output[3*i+2-lsb_index]=temp>>16;
     }
-    else for(int i=0;i<input_size;i++)
+}
+
+CSDR_TARGET_CLONES
+void convert_f_s24(float* input, unsigned char* output, int input_size, int bigendian)
+{
+    if(bigendian) convert_f_s24_const(input, output, input_size, 0);
+    else convert_f_s24_const(input, output, input_size, 2);
+}
+
+static inline void convert_s24_f_const(unsigned char* input, float* output, int input_size, const int lsb_index)
+{
+    for(int i=0;i<input_size;i++) //@convert_s24_f
     {
-        int temp=input[i]*(INT_MAX>>8);
-        unsigned char* ptemp=(unsigned char*)&temp;
-        output[k++]=*(ptemp+2);
-        output[k++]=*(ptemp+1);
-        output[k++]=*ptemp;
+        //we put the sample into the upper 24 bits, and shift it back to get the sign extended
+        int temp=(int)(((unsigned)input[3*i+2-lsb_index]<<24)|((unsigned)input[3*i+1]<<16)|((unsigned)input[3*i+lsb_index]<<8))>>8;
+        output[i]=(float)temp/S24_MAX;
     }
 }
 
+CSDR_TARGET_CLONES
 void convert_s24_f(unsigned char* input, float* output, int input_size, int bigendian)
+{
+    if(bigendian) convert_s24_f_const(input, output, input_size, 0);
+    else convert_s24_f_const(input, output, input_size, 2);
+}
+
+void convert_u8_f_novect(unsigned char* input, float* output, int input_size)
+{
+    for(int i=0;i<input_size;i++) output[i]=((float)input[i])/(UCHAR_MAX/2.0f)-1.0f;
+}
+
+void convert_s8_f_novect(signed char* input, float* output, int input_size)
+{
+    for(int i=0;i<input_size;i++) output[i]=((float)input[i])/SCHAR_MAX;
+}
+
+void convert_s16_f_novect(short* input, float* output, int input_size)
+{
+    for(int i=0;i<input_size;i++) output[i]=(float)input[i]/SHRT_MAX;
+}
+
+void convert_s32_f_novect(int* input, float* output, int input_size)
+{
+    for(int i=0;i<input_size;i++) output[i]=(float)input[i]/INT_MAX;
+}
+
+void convert_f_u8_novect(float* input, unsigned char* output, int input_size)
+{
+    for(int i=0;i<input_size;i++)
+    {
+        float v = input[i]*(UCHAR_MAX/2.0f)+128;
+        if(v>UCHAR_MAX) output[i]=UCHAR_MAX;
+        else if(v<0) output[i]=0;
+        else output[i]=v;
+    }
+}
+
+void convert_f_s8_novect(float* input, signed char* output, int input_size)
+{
+    for(int i=0;i<input_size;i++)
+    {
+        float v = input[i]*SCHAR_MAX;
+        if(v>SCHAR_MAX) output[i]=SCHAR_MAX;
+        else if(v<SCHAR_MIN) output[i]=SCHAR_MIN;
+        else if(v<0) output[i]=v-0.5f;
+        else output[i]=v+0.5f;
+    }
+}
+
+void convert_f_s16_novect(float* input, short* output, int input_size)
+{
+    for(int i=0;i<input_size;i++)
+    {
+        float v = input[i]*SHRT_MAX;
+        if(v>SHRT_MAX) output[i]=SHRT_MAX;
+        else if(v<SHRT_MIN) output[i]=SHRT_MIN;
+        else if(v<0) output[i]=v-0.5f;
+        else output[i]=v+0.5f;
+    }
+}
+
+void convert_f_s32_novect(float* input, int* output, int input_size)
+{
+    for(int i=0;i<input_size;i++)
+    {
+        double v = input[i]*(double)INT_MAX;
+        if(v>INT_MAX) output[i]=INT_MAX;
+        else if(v<INT_MIN) output[i]=INT_MIN;
+        else if(v<0) output[i]=v-0.5;
+        else output[i]=v+0.5;
+    }
+}
+
+void convert_f_s24_novect(float* input, unsigned char* output, int input_size, int bigendian)
 {
     int k=0;
-    if(bigendian) for(int i=0;i<input_size*3;i+=3)
+    for(int i=0;i<input_size;i++)
     {
-        int temp=(input[i+2]<<24)|(input[i+1]<<16)|(input[i]<<8);
-        output[k++]=temp/(float)(INT_MAX-256);
+        float v = input[i]*S24_MAX;
+        int temp;
+        if(v>S24_MAX) temp=S24_MAX;
+        else if(v<S24_MIN) temp=S24_MIN;
+        else if(v<0) temp=v-0.5f;
+        else temp=v+0.5f;
+        unsigned char lsb=temp, mid=temp>>8, msb=temp>>16;
+        if(bigendian) { output[k++]=lsb; output[k++]=mid; output[k++]=msb; }
+        else { output[k++]=msb; output[k++]=mid; output[k++]=lsb; }
     }
-    else for(int i=0;i<input_size*3;i+=3)
+}
+
+void convert_s24_f_novect(unsigned char* input, float* output, int input_size, int bigendian)
+{
+    int k=0;
+    for(int i=0;i<input_size*3;i+=3)
     {
-        int temp=(input[i+2]<<8)|(input[i+1]<<16)|(input[i]<<24);
-        output[k++]=temp/(float)(INT_MAX-256);
+        unsigned char lsb, mid=input[i+1], msb;
+        if(bigendian) { lsb=input[i]; msb=input[i+2]; }
+        else { lsb=input[i+2]; msb=input[i]; }
+        int temp=(msb<<16)|(mid<<8)|lsb;
+        if(temp&0x800000) temp-=0x1000000;
+        output[k++]=(float)temp/S24_MAX;
     }
 }
 
+CSDR_TARGET_CLONES
+unsigned int dither_tpdf_ff(float* input, float* output, int input_size, float lsb, unsigned int dither_index)
+{
+    //It adds triangular (TPDF) dither of +-1 LSB to the input of a convert_f_* function, so that the quantization error
+    //doesn't depend on the signal. lsb is the step size of the output format on the float scale, e.g. 1.0/SHRT_MAX for s16.
+    //The random numbers are a hash of the sample index (instead of a PRNG with a state), so that the loop can be vectorized.
+    //It returns the dither_index for the next call.
+    float scale = lsb/65536;
+    for(int i=0;i<input_size;i++) //@dither_tpdf_ff
+    {
+        unsigned int h = dither_index+i;
+        h ^= h>>16; h *= 0x7feb352d;
+        h ^= h>>15; h *= 0x846ca68b;
+        h ^= h>>16;
+        //the difference of two uniform random numbers has triangular distribution
+        output[i] = input[i]+((int)(h&0xffff)-(int)(h>>16))*scale;
+    }
+    return dither_index+input_size;
+}
+
 FILE* init_get_random_samples_f()
 {
     return fopen("/dev/urandom", "r");
@@ -2780,6 +4286,407 @@ float* add_const_cc(complexf* input, complexf* output, int input_size, complexf
     }
 }
 
+/*
+  Sub-band ADPCM audio codec, similar to G.722.
+
+  A 2-band QMF bank (with the 24 tap filter of G.722) splits the input into a low and a high half band,
+  both at half the sample rate. Each band is coded by an IMA style ADPCM coder with a configurable number of bits,
+  so the bitrate is (low_bits+high_bits)*sample_rate/2. If high_bits is 0, the high band is not sent at all.
+  It is not compatible with G.722, the ADPCM is much simpler (the same step size table and adaptation as IMA ADPCM).
+
+  Every SBADPCM_BLOCK input samples are coded into exactly low_bits+high_bits bytes (the codes are packed LSB first).
+*/
+
+static const float sbadpcm_qmf_taps[SBADPCM_QMF_TAPS] = {
+    3, -11, -11, 53, 12, -156, 32, 362, -210, -805, 951, 3876,
+    3876, 951, -805, -210, 362, 32, -156, 12, 53, -11, -11, 3
+};
+#define SBADPCM_QMF_SCALE (1.0f/8192) //the sum of the taps
+
+//The same as _stepSizeTable in ima_adpcm.c, copied because that file is only built with USE_IMA_ADPCM.
+static const int sbadpcm_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34,
+    37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+    157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494,
+    544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552,
+    1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026,
+    4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623,
+    27086, 29794, 32767
+};
+
+//step index adjustment by the magnitude part of the code, for 2..5 bits
+static const int sbadpcm_index_table_2[2] = { -1, 2 };
+static const int sbadpcm_index_table_3[4] = { -1, -1, 2, 4 };
+static const int sbadpcm_index_table_4[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+static const int sbadpcm_index_table_5[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 1, 2, 4, 6, 8, 10, 13, 16 };
+static const int* sbadpcm_index_tables[6] = { NULL, NULL, sbadpcm_index_table_2, sbadpcm_index_table_3, sbadpcm_index_table_4, sbadpcm_index_table_5 };
+
+static inline int sbadpcm_decode_sample(sbadpcm_band_t* band, int code, int bits)
+{
+    int sign = code>>(bits-1);
+    int magnitude = code&((1<<(bits-1))-1);
+    int step = sbadpcm_step_table[band->index];
+    //the middle of the quantization interval: (magnitude+0.5)*step/2^(bits-2)
+    int difference = ((2*magnitude+1)*step)>>(bits-1);
+    if(sign) difference = -difference;
+    band->value = MAX_M(MIN_M(band->prediction + difference, SHRT_MAX), SHRT_MIN);
+    band->index = MAX_M(MIN_M(band->index+sbadpcm_index_tables[bits][magnitude], 88), 0);
+
+    //The prediction is the last value plus the output of an adaptive FIR on the past differences (like the zero section
+    //of the G.722 predictor). The coefficients are updated by sign-sign LMS with leakage, in Q14 fixed point.
+    //The coefficients settle around +-2^15 and the differences can exceed SHRT_MAX, so the sum doesn't fit into an int.
+    int64_t zero_section = 0;
+    for(int i=SBADPCM_PREDICTOR_ZEROS-1;i>=0;i--)
+    {
+        int correlation = (band->differences[i]^difference)<0 ? -1 : 1;
+        band->coefficients[i] += -(band->coefficients[i]>>8) + ((band->differences[i]&&difference) ? correlation*128 : 0);
+        band->differences[i] = i ? band->differences[i-1] : difference;
+        zero_section += (int64_t)band->coefficients[i] * band->differences[i];
+    }
+    band->prediction = MAX_M(MIN_M(band->value + (zero_section>>14), SHRT_MAX), SHRT_MIN);
+    return band->value;
+}
+
+static inline int sbadpcm_encode_sample(sbadpcm_band_t* band, int sample, int bits)
+{
+    int diff = sample - band->prediction;
+    int sign = diff<0;
+    if(sign) diff = -diff;
+    int magnitude = (diff<<(bits-2))/sbadpcm_step_table[band->index];
+    magnitude = MIN_M(magnitude, (1<<(bits-1))-1);
+    int code = (sign<<(bits-1)) | magnitude;
+    sbadpcm_decode_sample(band, code, bits); //update state
+    return code;
+}
+
+sbadpcm_t sbadpcm_init(int low_bits, int high_bits, int max_input_size)
+{
+    sbadpcm_t s;
+    s.low_bits = low_bits;
+    s.high_bits = high_bits;
+    memset(&s.low, 0, sizeof(sbadpcm_band_t));
+    memset(&s.high, 0, sizeof(sbadpcm_band_t));
+    //encoder: input samples; decoder: sum and difference of the bands, with the QMF history before them
+    s.buffer = (float*)calloc(SBADPCM_QMF_TAPS+max_input_size, sizeof(float));
+    s.buffer_2 = (float*)calloc(SBADPCM_QMF_TAPS+max_input_size, sizeof(float));
+    s.bands = (short*)malloc(sizeof(short)*max_input_size);
+    return s;
+}
+
+int sbadpcm_init_check_bits(int low_bits, int high_bits)
+{
+    return low_bits>=2 && low_bits<=5 && (high_bits==0 || (high_bits>=2 && high_bits<=5));
+}
+
+void sbadpcm_free(sbadpcm_t* s)
+{
+    free(s->buffer);
+    free(s->buffer_2);
+    free(s->bands);
+}
+
+CSDR_TARGET_CLONES
+static void sbadpcm_qmf_analysis(float* input, short* output, int output_size)
+{
+    //input[0] is the oldest sample of the history, output is low band and high band samples interleaved
+    for(int k=0;k<output_size;k++)
+    {
+        float even = 0, odd = 0;
+        for(int j=0;j<SBADPCM_QMF_TAPS;j+=2) //@sbadpcm_qmf_analysis
+        {
+            even += sbadpcm_qmf_taps[j] * input[2*k+SBADPCM_QMF_TAPS-1-j];
+            odd += sbadpcm_qmf_taps[j+1] * input[2*k+SBADPCM_QMF_TAPS-2-j];
+        }
+        float low = (even+odd)*SBADPCM_QMF_SCALE;
+        float high = (even-odd)*SBADPCM_QMF_SCALE;
+        output[2*k] = MAX_M(MIN_M(lrintf(low), SHRT_MAX), SHRT_MIN);
+        output[2*k+1] = MAX_M(MIN_M(lrintf(high), SHRT_MAX), SHRT_MIN);
+    }
+}
+
+CSDR_TARGET_CLONES
+static void sbadpcm_qmf_synthesis(float* difference, float* sum, short* output, int input_size)
+{
+    //difference[] and sum[] start with SBADPCM_QMF_TAPS/2 samples of history
+    for(int k=0;k<input_size;k++)
+    {
+        float even = 0, odd = 0;
+        for(int j=0;j<SBADPCM_QMF_TAPS/2;j++) //@sbadpcm_qmf_synthesis
+        {
+            even += sbadpcm_qmf_taps[2*j] * difference[k+SBADPCM_QMF_TAPS/2-j];
+            odd += sbadpcm_qmf_taps[2*j+1] * sum[k+SBADPCM_QMF_TAPS/2-j];
+        }
+        output[2*k] = MAX_M(MIN_M(lrintf(2*even*SBADPCM_QMF_SCALE), SHRT_MAX), SHRT_MIN);
+        output[2*k+1] = MAX_M(MIN_M(lrintf(2*odd*SBADPCM_QMF_SCALE), SHRT_MAX), SHRT_MIN);
+    }
+}
+
+int sbadpcm_encode_s16_u8(sbadpcm_t* s, short* input, unsigned char* output, int input_size)
+{
+    //input_size should be a multiple of SBADPCM_BLOCK, at most max_input_size. It returns the number of bytes written.
+    input_size -= input_size%SBADPCM_BLOCK;
+    for(int i=0;i<input_size;i++) s->buffer[SBADPCM_QMF_TAPS+i] = input[i];
+    sbadpcm_qmf_analysis(s->buffer+1, s->bands, input_size/2);
+    memmove(s->buffer, s->buffer+input_size, sizeof(float)*SBADPCM_QMF_TAPS);
+
+    int output_size = 0;
+    unsigned int bits = 0, bit_count = 0;
+    for(int i=0;i<input_size/2;i++)
+    {
+        bits |= sbadpcm_encode_sample(&s->low, s->bands[2*i], s->low_bits) << bit_count;
+        bit_count += s->low_bits;
+        if(s->high_bits)
+        {
+            bits |= sbadpcm_encode_sample(&s->high, s->bands[2*i+1], s->high_bits) << bit_count;
+            bit_count += s->high_bits;
+        }
+        for(;bit_count>=8;bit_count-=8,bits>>=8) output[output_size++] = bits&0xff;
+    }
+    return output_size;
+}
+
+int sbadpcm_decode_u8_s16(sbadpcm_t* s, unsigned char* input, short* output, int input_size)
+{
+    //input_size should be a multiple of low_bits+high_bits. It returns the number of samples written.
+    int pairs = (input_size/(s->low_bits+s->high_bits))*SBADPCM_BLOCK/2;
+    float* difference = s->buffer+SBADPCM_QMF_TAPS/2;
+    float* sum = s->buffer_2+SBADPCM_QMF_TAPS/2;
+    unsigned int bits = 0;
+    int bit_count = 0, input_pointer = 0;
+    for(int i=0;i<pairs;i++)
+    {
+        for(;bit_count<s->low_bits+s->high_bits;bit_count+=8) bits |= input[input_pointer++] << bit_count;
+        int low = sbadpcm_decode_sample(&s->low, bits&((1<<s->low_bits)-1), s->low_bits);
+        bits >>= s->low_bits;
+        bit_count -= s->low_bits;
+        int high = 0;
+        if(s->high_bits)
+        {
+            high = sbadpcm_decode_sample(&s->high, bits&((1<<s->high_bits)-1), s->high_bits);
+            bits >>= s->high_bits;
+            bit_count -= s->high_bits;
+        }
+        difference[i] = low-high;
+        sum[i] = low+high;
+    }
+    sbadpcm_qmf_synthesis(s->buffer, s->buffer_2, output, pairs);
+    memmove(s->buffer, s->buffer+pairs, sizeof(float)*SBADPCM_QMF_TAPS/2);
+    memmove(s->buffer_2, s->buffer_2+pairs, sizeof(float)*SBADPCM_QMF_TAPS/2);
+    return 2*pairs;
+}
+
+/*
+  Waterfall compression with delta coding between lines.
+
+  Every FFT line (in dB) is quantized to step_db, and the quantized value is predicted from the same bin of the previous lines.
+  The prediction is an average over the last few lines rather than just the previous one, because in the noise
+  the difference of two lines would have twice the variance of a single one.
+  Every keyframe_interval-th line is a keyframe, where the prediction is from the previous bin of the same line instead,
+  so that a client can start decoding from there.
+  The zigzag coded prediction residual is coded by an adaptive range coder (the carryless one by Dmitry Subbotin).
+  The context of a symbol is the magnitude of the previous residual in the line, and the models are only reset on keyframes.
+
+  An output packet is:
+    4 bytes: length of the rest of the packet (little endian)
+    1 byte: flags (FFT_DELTA_FLAG_*)
+    2 bytes: step_db*100 (little endian)
+    range coded residuals
+*/
+
+#define FFT_DELTA_RC_TOP (1u<<24)
+#define FFT_DELTA_RC_BOTTOM (1u<<16)
+#define FFT_DELTA_MAX_TOTAL (1<<15)
+#define FFT_DELTA_INCREMENT 32
+#define FFT_DELTA_MAX_QUANTIZED 16383
+#define FFT_DELTA_HEADER_SIZE 7
+//The prediction for a bin is the exponential average of the quantized values of the previous lines, kept in fixed point.
+#define FFT_DELTA_AVERAGE_BITS 6
+#define FFT_DELTA_AVERAGE_SCALE (1<<FFT_DELTA_AVERAGE_BITS)
+#define FFT_DELTA_AVERAGE_SHIFT 2 //the weight of the new line is 1/4
+#define FFT_DELTA_PREDICTION(average) (((average)+FFT_DELTA_AVERAGE_SCALE/2)>>FFT_DELTA_AVERAGE_BITS)
+#define FFT_DELTA_AVERAGE(average, quantized) ((average)+(((quantized)*FFT_DELTA_AVERAGE_SCALE-(average))>>FFT_DELTA_AVERAGE_SHIFT))
+
+typedef struct fft_delta_rc_s
+{
+    unsigned int low, range, code;
+    unsigned char* buffer;
+    int pointer, size;
+} fft_delta_rc_t;
+
+static inline void fft_delta_rc_encode(fft_delta_rc_t* c, unsigned int cumulative, unsigned int freq, unsigned int total)
+{
+    c->range /= total;
+    c->low += cumulative*c->range;
+    c->range *= freq;
+    while((c->low ^ (c->low+c->range))<FFT_DELTA_RC_TOP || (c->range<FFT_DELTA_RC_BOTTOM && ((c->range = -c->low & (FFT_DELTA_RC_BOTTOM-1)),1)))
+    {
+        c->buffer[c->pointer++] = c->low>>24;
+        c->low <<= 8;
+        c->range <<= 8;
+    }
+}
+
+static inline unsigned char fft_delta_rc_next_byte(fft_delta_rc_t* c)
+{
+    return (c->pointer<c->size) ? c->buffer[c->pointer++] : 0;
+}
+
+static inline unsigned int fft_delta_rc_get_freq(fft_delta_rc_t* c, unsigned int total)
+{
+    c->range /= total;
+    unsigned int value = (c->code-c->low)/c->range;
+    return (value<total) ? value : total-1; //only on corrupt input
+}
+
+static inline void fft_delta_rc_decode(fft_delta_rc_t* c, unsigned int cumulative, unsigned int freq)
+{
+    c->low += cumulative*c->range;
+    c->range *= freq;
+    while((c->low ^ (c->low+c->range))<FFT_DELTA_RC_TOP || (c->range<FFT_DELTA_RC_BOTTOM && ((c->range = -c->low & (FFT_DELTA_RC_BOTTOM-1)),1)))
+    {
+        c->code = (c->code<<8) | fft_delta_rc_next_byte(c);
+        c->low <<= 8;
+        c->range <<= 8;
+    }
+}
+
+static void fft_delta_reset_models(fft_compress_delta_t* job)
+{
+    for(int m=0;m<FFT_DELTA_CONTEXTS;m++)
+    {
+        for(int i=0;i<FFT_DELTA_SYMBOLS;i++) job->models[m].freq[i] = 1;
+        job->models[m].total = FFT_DELTA_SYMBOLS;
+    }
+}
+
+static inline void fft_delta_update_model(fft_delta_model_t* model, int symbol)
+{
+    model->freq[symbol] += FFT_DELTA_INCREMENT;
+    model->total += FFT_DELTA_INCREMENT;
+    if(model->total <= FFT_DELTA_MAX_TOTAL) return;
+    model->total = 0;
+    for(int i=0;i<FFT_DELTA_SYMBOLS;i++) model->total += (model->freq[i] = (model->freq[i]+1)/2);
+}
+
+static inline int fft_delta_context(unsigned int zigzag)
+{
+    return (zigzag==0) ? 0 : ((zigzag<3) ? 1 : 2);
+}
+
+fft_compress_delta_t fft_compress_delta_init(int size, float step_db, int keyframe_interval)
+{
+    fft_compress_delta_t job;
+    job.size = size;
+    job.step_db = step_db;
+    job.keyframe_interval = MAX_M(keyframe_interval, 1);
+    job.line_counter = 0;
+    job.have_keyframe = 0;
+    job.previous = (int*)calloc(size, sizeof(int));
+    fft_delta_reset_models(&job);
+    return job;
+}
+
+void fft_compress_delta_free(fft_compress_delta_t* job)
+{
+    free(job->previous);
+}
+
+int fft_compress_delta_f_u8(fft_compress_delta_t* job, float* input, unsigned char* output)
+{
+    //The input is job->size values in dB, the output buffer should be at least FFT_COMPRESS_DELTA_MAX_OUTPUT(job->size) bytes.
+    //It returns the size of the packet written to the output.
+    int keyframe = (job->line_counter++ % job->keyframe_interval) == 0;
+    if(keyframe) fft_delta_reset_models(job);
+    int step_code = MIN_M(lrintf(job->step_db*100), 65535);
+    float step_db = step_code/100.0f; //the decoder will only know this value
+    output[4] = keyframe ? FFT_DELTA_FLAG_KEYFRAME : 0;
+    output[5] = step_code&0xff;
+    output[6] = step_code>>8;
+
+    fft_delta_rc_t c = { .low = 0, .range = 0xffffffff, .buffer = output, .pointer = FFT_DELTA_HEADER_SIZE };
+    int context = 0;
+    short last = 0;
+    float limit_db = FFT_DELTA_MAX_QUANTIZED*step_db;
+    for(int i=0;i<job->size;i++)
+    {
+        //we clamp before lrintf(), which would turn -inf (e.g. the log of an empty bin), NaN or huge values into LONG_MIN
+        float value = is_nan(input[i]) ? -limit_db : MAX_M(MIN_M(input[i], limit_db), -limit_db);
+        int quantized = lrintf(value/step_db);
+        int residual = quantized - (keyframe ? last : FFT_DELTA_PREDICTION(job->previous[i]));
+        unsigned int zigzag = (residual<<1) ^ (residual>>31);
+        last = quantized;
+        job->previous[i] = keyframe ? quantized*FFT_DELTA_AVERAGE_SCALE : FFT_DELTA_AVERAGE(job->previous[i], quantized);
+        fft_delta_model_t* model = &job->models[context];
+        int symbol = MIN_M(zigzag, FFT_DELTA_ESCAPE);
+        unsigned int cumulative = 0;
+        for(int j=0;j<symbol;j++) cumulative += model->freq[j];
+        fft_delta_rc_encode(&c, cumulative, model->freq[symbol], model->total);
+        fft_delta_update_model(model, symbol);
+        if(symbol == FFT_DELTA_ESCAPE)
+        {
+            fft_delta_rc_encode(&c, zigzag&0xff, 1, 256);
+            fft_delta_rc_encode(&c, zigzag>>8, 1, 256);
+        }
+        context = fft_delta_context(zigzag);
+    }
+    for(int i=0;i<4;i++) //flush
+    {
+        output[c.pointer++] = c.low>>24;
+        c.low <<= 8;
+    }
+    int length = c.pointer-4;
+    for(int i=0;i<4;i++) output[i] = (length>>(8*i))&0xff;
+    return c.pointer;
+}
+
+int fft_decompress_delta_u8_f(fft_compress_delta_t* job, unsigned char* input, int input_size, float* output)
+{
+    //It decodes a whole packet written by fft_compress_delta_f_u8 into job->size values in dB.
+    //It returns 0 on success, and -1 if the packet is incomplete, or it is not a keyframe and we haven't got one yet.
+    if(input_size<FFT_DELTA_HEADER_SIZE) return -1;
+    int length = input[0] | (input[1]<<8) | (input[2]<<16) | (input[3]<<24);
+    if(length+4>input_size) return -1;
+    int keyframe = input[4] & FFT_DELTA_FLAG_KEYFRAME;
+    if(keyframe)
+    {
+        fft_delta_reset_models(job);
+        job->have_keyframe = 1;
+    }
+    else if(!job->have_keyframe) return -1;
+    float step_db = (input[5] | (input[6]<<8))/100.0f;
+
+    fft_delta_rc_t c = { .low = 0, .range = 0xffffffff, .code = 0, .buffer = input, .pointer = FFT_DELTA_HEADER_SIZE, .size = length+4 };
+    for(int i=0;i<4;i++) c.code = (c.code<<8) | fft_delta_rc_next_byte(&c);
+    int context = 0;
+    short last = 0;
+    for(int i=0;i<job->size;i++)
+    {
+        fft_delta_model_t* model = &job->models[context];
+        unsigned int value = fft_delta_rc_get_freq(&c, model->total);
+        int symbol = 0;
+        unsigned int cumulative = 0;
+        while(cumulative+model->freq[symbol]<=value) cumulative += model->freq[symbol++];
+        fft_delta_rc_decode(&c, cumulative, model->freq[symbol]);
+        fft_delta_update_model(model, symbol);
+        unsigned int zigzag = symbol;
+        if(symbol == FFT_DELTA_ESCAPE)
+        {
+            zigzag = fft_delta_rc_get_freq(&c, 256);
+            fft_delta_rc_decode(&c, zigzag, 1);
+            unsigned int high = fft_delta_rc_get_freq(&c, 256);
+            fft_delta_rc_decode(&c, high, 1);
+            zigzag |= high<<8;
+        }
+        int residual = (zigzag>>1) ^ -(int)(zigzag&1);
+        last = (keyframe ? last : FFT_DELTA_PREDICTION(job->previous[i])) + residual;
+        job->previous[i] = keyframe ? last*FFT_DELTA_AVERAGE_SCALE : FFT_DELTA_AVERAGE(job->previous[i], last);
+        output[i] = last*step_db;
+        context = fft_delta_context(zigzag);
+    }
+    return 0;
+}
+
 int trivial_vectorize()
 {
     //this function is trivial to vectorize and should pass on both NEON and SSE
@@ -85,6 +85,7 @@ typedef struct fft_plan_s fft_plan_t;
 //filter design
 void firdes_lowpass_f(float *output, int length, float cutoff_rate, window_t window);
 void firdes_bandpass_c(complexf *output, int length, float lowcut, float highcut, window_t window);
+void firdes_hilbert_f(float *output, int length, window_t window);
 float firdes_wkernel_blackman(float input);
 float firdes_wkernel_hamming(float input);
 float firdes_wkernel_boxcar(float input);
@@ -92,10 +93,40 @@ window_t firdes_get_window_from_string(char* input);
 char* firdes_get_string_from_window(window_t window);
 int firdes_filter_len(float transition_bw);
 
+typedef struct biquad_s
+{
+    float b0, b1, b2; //numerator
+    float a1, a2; //denominator, a0 = 1
+} biquad_t;
+
+typedef enum iir_filter_type_e
+{
+    IIR_LOWPASS, IIR_HIGHPASS, IIR_BANDPASS, IIR_BANDSTOP
+} iir_filter_type_t;
+
+typedef struct sos_filter_s
+{
+    biquad_t* sections;
+    int num_sections;
+    int channels; //number of interleaved channels
+    float* state; //2 per section per channel
+} sos_filter_t;
+
+int iirdes_num_sections(int order, iir_filter_type_t type);
+int iirdes_butterworth(biquad_t* output, int order, iir_filter_type_t type, float cutoff1, float cutoff2);
+int iirdes_chebyshev1(biquad_t* output, int order, iir_filter_type_t type, float cutoff1, float cutoff2, float ripple_db);
+int iirdes_notch(biquad_t* output, float rate, float bandwidth);
+sos_filter_t sos_filter_init(biquad_t* sections, int num_sections, int channels);
+void sos_filter_ff(sos_filter_t* f, float* input, float* output, int input_size);
+void sos_filter_channels_ff(sos_filter_t* f, float* input, float* output, int input_size);
+void sos_filter_cc(sos_filter_t* f, complexf* input, complexf* output, int input_size);
+
 //demodulators
 complexf fmdemod_quadri_cf(complexf* input, float* output, int input_size, float *temp, complexf last_sample);
 complexf fmdemod_quadri_novect_cf(complexf* input, float* output, int input_size, complexf last_sample);
 float fmdemod_atan_cf(complexf* input, float *output, int input_size, float last_phase);
+float fast_atan2f(float y, float x);
+complexf fmdemod_atan_fast_cf(complexf* input, float *output, int input_size, complexf last_sample);
 void amdemod_cf(complexf* input, float *output, int input_size);
 void amdemod_estimator_cf(complexf* input, float *output, int input_size, float alpha, float beta);
 void limit_ff(float* input, float* output, int input_size, float max_amplitude);
@@ -128,19 +159,23 @@ typedef struct dcblock_preserve_s
 dcblock_preserve_t dcblock_ff(float* input, float* output, int input_size, float a, dcblock_preserve_t preserved);
 float fastdcblock_ff(float* input, float* output, int input_size, float last_dc_level);
 
-typedef struct fastagc_ff_s
+typedef struct fastagc_ff_s //create it with fastagc_init(), it replaces the buffer_1/buffer_2/peak_1/peak_2 fields of older versions
 {
-    float* buffer_1;
-    float* buffer_2;
-    float* buffer_input; //it is the actual input buffer to fill
-    float peak_1;
-    float peak_2;
-    int input_size;
+    float** buffers; //circular list of num_blocks blocks, the oldest one is output next
+    float* peaks; //peak of each block
+    int num_blocks;
+    int oldest; //index of the oldest block in buffers
+    float* buffer_input; //it is the actual input buffer to fill (the newest block)
+    int input_size; //in samples
+    int floats_per_sample; //1 for fastagc_ff, 2 for fastagc_cc
     float reference;
     float last_gain;
 } fastagc_ff_t;
 
+fastagc_ff_t fastagc_init(int input_size, int num_blocks, float reference, int floats_per_sample);
+void fastagc_free(fastagc_ff_t* input);
 void fastagc_ff(fastagc_ff_t* input, float* output);
+void fastagc_cc(fastagc_ff_t* input, complexf* output);
 
 typedef struct rational_resampler_ff_s
 {
@@ -222,6 +257,20 @@ shift_addfast_data_t shift_addfast_init(float rate);
 shift_addfast_data_t shift_addfast_init(float rate);
 float shift_addfast_cc(complexf *input, complexf* output, int input_size, shift_addfast_data_t* d, float starting_phase);
 
+typedef struct frontend_s
+{
+    shift_addfast_data_t shift;
+    float starting_phase;
+    fir_decimate_t decimator;
+    complexf* buffer; //converted and shifted samples waiting for fir_decimate_cc
+    int buffer_size;
+    int buffer_fill;
+} frontend_t;
+frontend_t frontend_init(float shift_rate, int decimation, float transition_bw, window_t window);
+void frontend_set_shift_rate(frontend_t* f, float shift_rate);
+int frontend_u8_cc(frontend_t* f, unsigned char* input, complexf* output, int input_size);
+int frontend_s16_cc(frontend_t* f, short* input, complexf* output, int input_size);
+
 typedef struct shift_unroll_data_s
 {
     float* dsin;
@@ -240,6 +289,63 @@ void apply_fir_fft_cc(fft_plan_t* plan, fft_plan_t* plan_inverse, complexf* taps
 void gain_ff(float* input, float* output, int input_size, float gain);
 float get_power_f(float* input, int input_size, int decimation);
 float get_power_c(complexf* input, int input_size, int decimation);
+float get_peak_power_c(complexf* input, int input_size);
+
+typedef struct squelch_s
+{
+    float hysteresis; //ratio of the opening and closing power levels
+    int tail_blocks; //number of blocks the squelch stays open after the power drops below the closing level
+    int tail_counter;
+    int open;
+} squelch_t;
+squelch_t squelch_init(float hysteresis_db, int tail_blocks);
+int squelch_update(squelch_t* s, float squelch_level, float power);
+
+//CTCSS and DCS tone squelch
+typedef struct subaudio_decimator_s
+{
+    int decimation;
+    float output_rate;
+    float* taps;
+    int taps_length;
+    float* buffer; //the last taps_length-1 input samples, followed by the new input
+    int buffer_fill;
+} subaudio_decimator_t;
+subaudio_decimator_t subaudio_decimator_init(float input_rate, int max_input_size);
+int subaudio_decimator_ff(subaudio_decimator_t* d, float* input, float* output, int input_size);
+
+#define CTCSS_NUM_TONES 50
+extern const float ctcss_tones[CTCSS_NUM_TONES];
+
+typedef struct ctcss_detector_s
+{
+    float coeff[CTCSS_NUM_TONES]; //2*cos(omega) for each Goertzel filter
+    float s1[CTCSS_NUM_TONES];
+    float s2[CTCSS_NUM_TONES];
+    float energy;
+    int window_size;
+    int counter;
+    float threshold; //minimum ratio of the tone power to the total power
+    int tone; //index into ctcss_tones of the detected tone, -1 if there is none
+} ctcss_detector_t;
+ctcss_detector_t ctcss_detector_init(float sample_rate, float window_length, float threshold);
+int ctcss_detector_ff(ctcss_detector_t* d, float* input, int input_size);
+int ctcss_tone_index(float frequency);
+
+typedef struct dcs_decoder_s
+{
+    uint32_t codeword; //the 23 bit codeword we look for
+    float bit_step; //bit rate relative to the sample rate
+    float bit_phase;
+    float high, low, decay; //peak detectors for the slicing level
+    float last_level;
+    uint32_t shift_register;
+    int bits_since_match;
+    int matches;
+} dcs_decoder_t;
+uint32_t dcs_codeword(int code);
+dcs_decoder_t dcs_decoder_init(float sample_rate, int code, int inverted);
+int dcs_decoder_ff(dcs_decoder_t* d, float* input, int input_size);
 
 void add_dcoffset_cc(complexf* input, complexf* output, int input_size);
 float fmmod_fc(float* input, complexf* output, int input_size, float last_phase);
@@ -255,6 +361,19 @@ void convert_f_i16(float* input, short* output, int input_size);
 void convert_i16_f(short* input, float* output, int input_size);
 void convert_f_s24(float* input, unsigned char* output, int input_size, int bigendian);
 void convert_s24_f(unsigned char* input, float* output, int input_size, int bigendian);
+void convert_s32_f(int* input, float* output, int input_size);
+void convert_f_s32(float* input, int* output, int input_size);
+void convert_u8_f_novect(unsigned char* input, float* output, int input_size);
+void convert_f_u8_novect(float* input, unsigned char* output, int input_size);
+void convert_s8_f_novect(signed char* input, float* output, int input_size);
+void convert_f_s8_novect(float* input, signed char* output, int input_size);
+void convert_s16_f_novect(short* input, float* output, int input_size);
+void convert_f_s16_novect(float* input, short* output, int input_size);
+void convert_s24_f_novect(unsigned char* input, float* output, int input_size, int bigendian);
+void convert_f_s24_novect(float* input, unsigned char* output, int input_size, int bigendian);
+void convert_s32_f_novect(int* input, float* output, int input_size);
+void convert_f_s32_novect(float* input, int* output, int input_size);
+unsigned int dither_tpdf_ff(float* input, float* output, int input_size, float lsb, unsigned int dither_index);
 
 
 int is_nan(float f);
@@ -289,6 +408,7 @@ typedef struct rtty_baudot_decoder_s
 
 char rtty_baudot_decoder_lookup(unsigned char* fig_mode, unsigned char c);
 char rtty_baudot_decoder_push(rtty_baudot_decoder_t* s, unsigned char symbol);
+int rtty_baudot_decoder_u8_u8(rtty_baudot_decoder_t* s, unsigned char* input, char* output, int input_size);
 
 //PSK31
 
@@ -299,7 +419,10 @@ typedef struct psk31_varicode_item_s
     unsigned char ascii;
 } psk31_varicode_item_t;
 
+#define PSK31_VARICODE_TABLE_BITS 12 //the longest code is 10 bits, plus the "00" before it
+
 char psk31_varicode_decoder_push(unsigned long long* status_shr, unsigned char symbol);
+int psk31_varicode_decoder_u8_u8(unsigned long long* status_shr, unsigned char* input, char* output, int input_size);
 
 //Serial
 
@@ -339,10 +462,66 @@ void pll_cc_init_pi_controller(pll_t* p, float bandwidth, float ko, float kd, fl
 void pll_cc_init_p_controller(pll_t* p, float alpha);
 void pll_cc(pll_t* p, complexf* input, float* output_dphase, complexf* output_nco, int input_size);
 
+typedef struct wfm_stereo_s
+{
+    int input_rate;
+    int output_rate;
+    float tau; //de-emphasis time constant
+    complexf last_sample; //for the FM demodulator
+    float* mpx; //demodulated multiplex signal, with the history needed by the pilot filter at its beginning
+    float* pilot_taps_i; //complex bandpass filter around the 19 kHz pilot, stored as separate I and Q taps so that it can be vectorized
+    float* pilot_taps_q;
+    int pilot_taps_length;
+    complexf* pilot;
+    complexf* pilot_nco; //output of the PLL locked on the pilot
+    pll_t pilot_pll;
+    float pilot_lock; //lowpass filtered cosine of the phase error between the pilot and the PLL
+    int stereo; //whether the pilot is detected
+    float* audio_taps; //anti-aliasing filter for the resampler
+    int audio_taps_length;
+    fractional_decimator_ff_t decimator_left;
+    fractional_decimator_ff_t decimator_right;
+    float* left; //left and right channels at input rate, waiting for the resampler
+    float* right;
+    int lr_size; //number of samples in left and right
+    float* output_left;
+    float* output_right;
+    float deemphasis_last_left;
+    float deemphasis_last_right;
+    int output_size; //number of stereo sample pairs written by the last call
+} wfm_stereo_t;
+
+wfm_stereo_t wfm_stereo_init(int input_rate, int output_rate, float tau, int max_input_size);
+void wfm_stereo_cf(complexf* input, short* output, int input_size, wfm_stereo_t* s);
+
+typedef enum samdemod_sideband_e
+{
+    SAMDEMOD_DSB=0,
+    SAMDEMOD_USB=1,
+    SAMDEMOD_LSB=2
+} samdemod_sideband_t;
+
+typedef struct samdemod_s
+{
+    samdemod_sideband_t sideband;
+    pll_t pll; //locks on the carrier
+    complexf* nco;
+    float* hilbert_taps;
+    int hilbert_taps_length;
+    float* buffer_i; //demodulated I and Q, with the history needed by the Hilbert filter at their beginning
+    float* buffer_q;
+} samdemod_t;
+
+samdemod_t samdemod_init(samdemod_sideband_t sideband, float pll_bandwidth, float transition_bw, int max_input_size);
+void samdemod_cf(complexf* input, float* output, int input_size, samdemod_t* s);
+
 typedef enum timing_recovery_algorithm_e
 {
     TIMING_RECOVERY_ALGORITHM_GARDNER, 
-    TIMING_RECOVERY_ALGORITHM_EARLYLATE 
+    TIMING_RECOVERY_ALGORITHM_EARLYLATE,
+    //these sample between the input samples with a Farrow interpolator, so they work with as low as 2 samples per symbol:
+    TIMING_RECOVERY_ALGORITHM_GARDNER_FARROW,
+    TIMING_RECOVERY_ALGORITHM_MUELLER_MULLER
 } timing_recovery_algorithm_t;
 
 #define TIMING_RECOVERY_ALGORITHM_DEFAULT TIMING_RECOVERY_ALGORITHM_GARDNER
@@ -361,10 +540,17 @@ typedef struct timing_recovery_state_s
     float earlylate_ratio;
     float loop_gain;
     float max_error;
+    //for the fractional algorithms:
+    float samples_per_symbol;
+    float symbol_index; //fractional index of the next symbol in the input buffer
+    float rate_correction; //samples per symbol, added to samples_per_symbol by the loop filter
+    complexf last_symbol;
 } timing_recovery_state_t;
 
 timing_recovery_state_t timing_recovery_init(timing_recovery_algorithm_t algorithm, int decimation_rate, int use_q, float loop_gain, float max_error, int debug_every_nth, char* debug_writefiles_path);
 void timing_recovery_cc(complexf* input, complexf* output, int input_size, float* timing_error, int* sampled_indexes,  timing_recovery_state_t* state);
+timing_recovery_state_t timing_recovery_fractional_init(timing_recovery_algorithm_t algorithm, float samples_per_symbol, int use_q, float loop_gain, float max_error);
+int timing_recovery_is_fractional(timing_recovery_algorithm_t algorithm);
 timing_recovery_algorithm_t timing_recovery_get_algorithm_from_string(char* input);
 char* timing_recovery_get_string_from_algorithm(timing_recovery_algorithm_t algorithm);
 void octave_plot_point_on_cplxsig(complexf* signal, int signal_size, float error, int index, int correction_offset, char* writefiles_path, int points_size, ...);
@@ -439,6 +625,59 @@ unsigned char pack_bits_8to1_u8_u8(unsigned char* input);
 void dbpsk_decoder_c_u8(complexf* input, unsigned char* output, int input_size);
 int bfsk_demod_cf(complexf* input, float* output, int input_size, complexf* mark_filter, complexf* space_filter, int taps_length);
 
+#ifdef USE_FFTW
+//PSK31 skimmer: it finds and decodes all PSK31 signals in the audio passband.
+typedef struct psk31_channel_s
+{
+    float frequency; //Hz
+    float* taps_i; //channel filter, shifted to the frequency of the channel
+    float* taps_q;
+    double phase; //to shift the filter output to baseband
+    double dphase;
+    float amplitude; //average amplitude for the AGC
+    timing_recovery_state_t timing;
+    complexf* baseband; //input of timing recovery
+    int baseband_size;
+    complexf* symbols;
+    complexf last_symbol;
+    unsigned long long varicode_status;
+    int frames_since_detected; //number of FFT frames since the signal was last seen
+    int frames_since_flush;
+    char* text; //decoded text that has not been output yet
+    int text_length;
+} psk31_channel_t;
+
+typedef struct psk31_skimmer_s
+{
+    float sample_rate;
+    int decimation; //the channels run at sample_rate/decimation
+    int max_input_size;
+    float low_frequency, high_frequency;
+    float threshold; //minimum power of a signal relative to the noise floor
+    int taps_length;
+    float* lowpass_taps;
+    float* buffer; //the last taps_length-1 input samples, followed by the new input
+    int buffer_fill;
+    int max_channels;
+    psk31_channel_t* channels;
+    int fft_size;
+    fft_plan_t* fft_plan;
+    float* fft_input;
+    complexf* fft_output;
+    int fft_input_fill;
+    float* window;
+    float* average_power;
+    float* signal_power; //average_power summed over the bandwidth of a signal
+    float* sort_temp;
+} psk31_skimmer_t;
+
+#define PSK31_SKIMMER_MIN_SAMPLE_RATE 2000
+#define PSK31_SKIMMER_MAX_SAMPLE_RATE 1000000
+
+psk31_skimmer_t psk31_skimmer_init(float sample_rate, float low_frequency, float high_frequency, float threshold_db, int max_channels, int max_input_size);
+int psk31_skimmer_f_u8(psk31_skimmer_t* s, float* input, int input_size, char* output, int output_max_size);
+#endif
+
 #ifdef USE_IMA_ADPCM
 
 typedef struct ImaState {
@@ -449,6 +688,10 @@ typedef struct ImaState {
 ima_adpcm_state_t encode_ima_adpcm_i16_u8(short* input, unsigned char* output, int input_length, ima_adpcm_state_t state);
 ima_adpcm_state_t decode_ima_adpcm_u8_i16(unsigned char* input, short* output, int input_length, ima_adpcm_state_t state);
 
+#define IMA_ADPCM_BATCH_LANES 32
+void encode_ima_adpcm_i16_u8_batch(short** input, unsigned char** output, int input_length, ima_adpcm_state_t* states, int stream_count);
+void decode_ima_adpcm_u8_i16_batch(unsigned char** input, short** output, int input_length, ima_adpcm_state_t* states, int stream_count);
+
 //We will pad the FFT at the beginning, with the first value of the input data, COMPRESS_FFT_PAD_N times.
 //No, this is not advanced DSP, just the ADPCM codec produces some gabarge samples at the beginning,
 //so we just add data to become garbage and get skipped.
@@ -467,5 +710,60 @@ void fft_compress_ima_adpcm_init(fft_compress_ima_adpcm_t* job, uint32_t size);
 void fft_compress_ima_adpcm_free(fft_compress_ima_adpcm_t* job);
 float* fft_compress_ima_adpcm_get_write_pointer(fft_compress_ima_adpcm_t* job);
 void fft_compress_ima_adpcm(fft_compress_ima_adpcm_t* job, unsigned char* output);
+void fft_compress_ima_adpcm_batch(fft_compress_ima_adpcm_t** jobs, unsigned char** outputs, int job_count);
 
 #endif
+
+#define SBADPCM_QMF_TAPS 24
+#define SBADPCM_BLOCK 16 //input samples, coded into exactly low_bits+high_bits bytes
+
+#define SBADPCM_PREDICTOR_ZEROS 6
+
+typedef struct sbadpcm_band_s {
+    int index;
+    int value;
+    int prediction;
+    int differences[SBADPCM_PREDICTOR_ZEROS];
+    int coefficients[SBADPCM_PREDICTOR_ZEROS];
+} sbadpcm_band_t;
+
+typedef struct sbadpcm_s {
+    int low_bits;
+    int high_bits;
+    sbadpcm_band_t low, high;
+    float* buffer;
+    float* buffer_2;
+    short* bands;
+} sbadpcm_t;
+
+sbadpcm_t sbadpcm_init(int low_bits, int high_bits, int max_input_size);
+int sbadpcm_init_check_bits(int low_bits, int high_bits);
+void sbadpcm_free(sbadpcm_t* s);
+int sbadpcm_encode_s16_u8(sbadpcm_t* s, short* input, unsigned char* output, int input_size);
+int sbadpcm_decode_u8_s16(sbadpcm_t* s, unsigned char* input, short* output, int input_size);
+
+#define FFT_DELTA_ESCAPE 16 //residuals from here are sent as 16 bits
+#define FFT_DELTA_SYMBOLS (FFT_DELTA_ESCAPE+1)
+#define FFT_DELTA_CONTEXTS 3
+#define FFT_DELTA_FLAG_KEYFRAME 1
+#define FFT_COMPRESS_DELTA_MAX_OUTPUT(size) (5*(size)+16)
+
+typedef struct fft_delta_model_s {
+    unsigned short freq[FFT_DELTA_SYMBOLS];
+    unsigned int total;
+} fft_delta_model_t;
+
+typedef struct fft_compress_delta_s {
+    int size;
+    float step_db;
+    int keyframe_interval;
+    int line_counter;
+    int have_keyframe; //decoder only
+    int* previous; //the average of the previous lines, quantized, in fixed point
+    fft_delta_model_t models[FFT_DELTA_CONTEXTS];
+} fft_compress_delta_t;
+
+fft_compress_delta_t fft_compress_delta_init(int size, float step_db, int keyframe_interval);
+void fft_compress_delta_free(fft_compress_delta_t* job);
+int fft_compress_delta_f_u8(fft_compress_delta_t* job, float* input, unsigned char* output);
+int fft_decompress_delta_u8_f(fft_compress_delta_t* job, unsigned char* input, int input_size, float* output);
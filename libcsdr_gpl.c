@@ -20,7 +20,9 @@ This file is part of libcsdr.
 
 */
 
+#include <string.h>
 #include "libcsdr_gpl.h"
+#include "fmv.h"
 
 #ifdef LIBCSDR_GPL
 
@@ -364,4 +366,142 @@ agc_state* agc_s16(short* input, short* output, int input_size, agc_params* para
 	return state;
 }
 
+/*
+	agc_block_ff / agc_block_s16 behave like agc_ff with the same attack/decay/hang parameters,
+	but they run the AGC state machine once per sub-block instead of once per sample:
+		- the envelope is the peak of the sub-block (and the following sub-blocks within the lookahead),
+		- the gain is linearly interpolated across the sub-block instead of the alpha-beta filter
+		  (so gain_filter_alpha is not used),
+		- the signal is delayed by lookahead samples, so that the gain can be reduced before a peak arrives.
+	The inner loops have no branches, so they can be vectorized.
+	input_size should be a multiple of block_size: a shorter sub-block at the end would take a whole place in the lookahead window.
+*/
+
+agc_block_state* agc_block_init(agc_params* params, int block_size, int lookahead)
+{
+	agc_block_state* block = malloc(sizeof(agc_block_state));
+	block->block_size = block_size;
+	block->lookahead = ((lookahead + block_size - 1) / block_size) * block_size;
+	block->delay = (block->lookahead) ? calloc(block->lookahead, sizeof(float)) : NULL;
+	block->delay_pos = 0;
+	block->peaks_size = block->lookahead / block_size + 1;
+	block->peaks = calloc(block->peaks_size, sizeof(float));
+	block->peaks_pos = 0;
+	block->buffer = malloc(sizeof(float) * block_size);
+	block->input_f = malloc(sizeof(float) * block_size);
+	block->output_f = malloc(sizeof(float) * block_size);
+	block->attack_factor = powf(1 - params->attack_rate, block_size);
+	block->decay_factor = powf(1 + params->decay_rate, block_size);
+	return block;
+}
+
+CSDR_TARGET_CLONES
+static float agc_block_peak(float* input, int input_size)
+{
+	float peak = 0;
+	for (int i = 0; i < input_size; i++) peak = fmaxf(peak, fabsf(input[i])); //@agc_block_peak
+	return peak;
+}
+
+CSDR_TARGET_CLONES
+static void agc_block_apply_gain(float* input, float* output, int input_size, float gain_start, float gain_end)
+{
+	float dgain = (gain_end - gain_start) / input_size;
+	for (int i = 0; i < input_size; i++) { //@agc_block_apply_gain
+		float sample = (gain_start + dgain * (i + 1)) * input[i];
+		output[i] = fminf(fmaxf(sample, -1.0f), 1.0f);
+	}
+}
+
+static void agc_block_delay(agc_block_state* block, float* input, float* output, int input_size)
+{
+	//output gets the samples from lookahead samples before, and input goes into their place
+	if (!block->lookahead) {
+		memcpy(output, input, sizeof(float) * input_size);
+		return;
+	}
+	int first = block->lookahead - block->delay_pos;
+	if (first > input_size) first = input_size;
+	memcpy(output, block->delay + block->delay_pos, sizeof(float) * first);
+	memcpy(block->delay + block->delay_pos, input, sizeof(float) * first);
+	memcpy(output + first, block->delay, sizeof(float) * (input_size - first));
+	memcpy(block->delay, input + first, sizeof(float) * (input_size - first));
+	block->delay_pos = (block->delay_pos + input_size) % block->lookahead;
+}
+
+static float agc_block_gain(float peak, float gain, float* last_peak, int size, agc_params* params, agc_state* state, agc_block_state* block)
+{
+	//This is the state machine of agc_ff, stepping size samples at once.
+	//The gain doesn't go beyond the value that would exactly bring the peak to the reference level.
+	if (peak == 0) return gain; //we skip silence, as agc_ff does
+	float target_gain = params->reference / peak;
+	if (peak * gain > params->reference) {
+		//INCREASE IN SIGNAL LEVEL
+		if (*last_peak < peak) {
+			state->attack_wait_counter = params->attack_wait_time;
+			*last_peak = peak;
+		}
+		if (state->attack_wait_counter > 0) {
+			state->attack_wait_counter = (state->attack_wait_counter > size) ? state->attack_wait_counter - size : 0;
+		} else {
+			float factor = (size == block->block_size) ? block->attack_factor : powf(1 - params->attack_rate, size);
+			gain = fmaxf(gain * factor, target_gain);
+			state->hang_counter = params->hang_time;
+		}
+	} else {
+		//DECREASE IN SIGNAL LEVEL
+		if (state->hang_counter > 0) {
+			state->hang_counter = (state->hang_counter > size) ? state->hang_counter - size : 0;
+		} else {
+			float factor = (size == block->block_size) ? block->decay_factor : powf(1 + params->decay_rate, size);
+			gain = fminf(gain * factor, target_gain);
+		}
+	}
+	if (gain > params->max_gain) gain = params->max_gain;
+	if (gain < 0) gain = 0;
+	return gain;
+}
+
+static void agc_block_process(float* input, float* output, int size, float* gain, float* last_peak, agc_params* params, agc_state* state, agc_block_state* block)
+{
+	block->peaks[block->peaks_pos] = agc_block_peak(input, size);
+	block->peaks_pos = (block->peaks_pos + 1) % block->peaks_size;
+	//the envelope is the maximum over the sub-block going out now and the ones in the lookahead window
+	float peak = 0;
+	for (int j = 0; j < block->peaks_size; j++) peak = fmaxf(peak, block->peaks[j]);
+	float new_gain = agc_block_gain(peak, *gain, last_peak, size, params, state, block);
+	agc_block_delay(block, input, block->buffer, size);
+	agc_block_apply_gain(block->buffer, output, size, *gain, new_gain);
+	*gain = new_gain;
+}
+
+agc_state* agc_block_ff(float* input, float* output, int input_size, agc_params* params, agc_state* state, agc_block_state* block)
+{
+	float gain = state->last_gain;
+	float last_peak = params->reference / state->last_gain; //approx.
+	for (int i = 0; i < input_size; i += block->block_size) {
+		int size = (input_size - i < block->block_size) ? input_size - i : block->block_size;
+		agc_block_process(input + i, output + i, size, &gain, &last_peak, params, state, block);
+	}
+	state->last_gain = gain;
+	return state;
+}
+
+agc_state* agc_block_s16(short* input, short* output, int input_size, agc_params* params, agc_state* state, agc_block_state* block)
+{
+	//We convert to float sub-block by sub-block, and do the same as agc_block_ff.
+	float gain = state->last_gain;
+	float last_peak = params->reference / state->last_gain; //approx.
+	float* input_f = block->input_f;
+	float* output_f = block->output_f;
+	for (int i = 0; i < input_size; i += block->block_size) {
+		int size = (input_size - i < block->block_size) ? input_size - i : block->block_size;
+		for (int j = 0; j < size; j++) input_f[j] = input[i + j] / 32767.0f; //@agc_block_s16: convert input
+		agc_block_process(input_f, output_f, size, &gain, &last_peak, params, state, block);
+		for (int j = 0; j < size; j++) output[i + j] = output_f[j] * SHRT_MAX; //@agc_block_s16: convert output
+	}
+	state->last_gain = gain;
+	return state;
+}
+
 #endif
@@ -61,6 +61,25 @@ agc_state* agc_ff(float* input, float* output, int input_size, agc_params* param
 
 agc_state* agc_s16(short* input, short* output, int input_size, agc_params* params, agc_state* state);
 
+typedef struct {
+    int block_size; //the envelope is the peak of each sub-block of this size
+    int lookahead; //in samples, rounded up to a multiple of block_size
+    float* delay; //circular buffer delaying the signal by lookahead samples
+    int delay_pos;
+    float* peaks; //peaks of the sub-blocks within the lookahead window
+    int peaks_size;
+    int peaks_pos;
+    float* buffer; //holds one sub-block
+    float* input_f; //one sub-block converted from s16 in agc_block_s16
+    float* output_f;
+    float attack_factor; //gain change over a full sub-block
+    float decay_factor;
+} agc_block_state;
+
+agc_block_state* agc_block_init(agc_params* params, int block_size, int lookahead);
+agc_state* agc_block_ff(float* input, float* output, int input_size, agc_params* params, agc_state* state, agc_block_state* block);
+agc_state* agc_block_s16(short* input, short* output, int input_size, agc_params* params, agc_state* state, agc_block_state* block);
+
 typedef struct decimating_shift_addition_status_s
 {
 	int decimation_remain;
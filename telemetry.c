@@ -0,0 +1,147 @@
+/*
+This software is part of libcsdr, a set of simple DSP routines for
+Software Defined Radio.
+
+Copyright (c) 2014, Andras Retzler <randras@sdr.hu>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL ANDRAS RETZLER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "telemetry.h"
+
+//The ring is a seqlock per record: the writer clears the sequence number of the record, fills it, then sets the sequence number.
+//A reader accepts the record only if it sees the same, expected sequence number before and after copying it.
+
+static size_t telemetry_file_size(int num_records)
+{
+    return sizeof(telemetry_header_t)+sizeof(telemetry_record_t)*num_records;
+}
+
+int telemetry_create(telemetry_t* t, const char* path, int num_records)
+{
+    //Returns 0 on success, -1 on error (see errno).
+    memset(t, 0, sizeof(telemetry_t));
+    if(num_records<=0) return -1;
+    size_t size = telemetry_file_size(num_records);
+    //A reader may still have the file of a previous run mapped, truncating it would crash the reader with SIGBUS.
+    unlink(path);
+    t->fd = open(path, O_RDWR|O_CREAT|O_EXCL, 0644);
+    if(t->fd==-1) return -1;
+    if(ftruncate(t->fd, size)==-1) { close(t->fd); return -1; }
+    void* map = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, t->fd, 0);
+    if(map==MAP_FAILED) { close(t->fd); return -1; }
+    t->header = (telemetry_header_t*)map;
+    t->records = (telemetry_record_t*)(t->header+1);
+    t->header->version = TELEMETRY_VERSION;
+    t->header->record_size = sizeof(telemetry_record_t);
+    t->header->num_records = num_records;
+    t->header->write_index = 0;
+    //readers check the magic last, so we write it last
+    __atomic_store_n(&t->header->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int telemetry_open(telemetry_t* t, const char* path)
+{
+    //Opens the ring for reading. Returns 0 on success, -1 on error (e.g. the writer hasn't created the file yet).
+    memset(t, 0, sizeof(telemetry_t));
+    t->fd = open(path, O_RDONLY);
+    if(t->fd==-1) return -1;
+    struct stat st;
+    telemetry_header_t header;
+    if(fstat(t->fd, &st)==-1 || (size_t)st.st_size<sizeof(telemetry_header_t) || pread(t->fd, &header, sizeof(header), 0)!=sizeof(header) ||
+        header.magic!=TELEMETRY_MAGIC || header.version!=TELEMETRY_VERSION || header.record_size!=sizeof(telemetry_record_t) ||
+        (size_t)st.st_size<telemetry_file_size(header.num_records)) { close(t->fd); return -1; }
+    void* map = mmap(NULL, telemetry_file_size(header.num_records), PROT_READ, MAP_SHARED, t->fd, 0);
+    if(map==MAP_FAILED) { close(t->fd); return -1; }
+    t->header = (telemetry_header_t*)map;
+    t->records = (telemetry_record_t*)(t->header+1);
+    uint64_t write_index = __atomic_load_n(&t->header->write_index, __ATOMIC_ACQUIRE);
+    t->read_index = (write_index>0) ? write_index-1 : 0; //we start with the latest record
+    return 0;
+}
+
+void telemetry_close(telemetry_t* t)
+{
+    if(!t->header) return;
+    munmap(t->header, telemetry_file_size(t->header->num_records));
+    close(t->fd);
+    t->header = NULL;
+    t->records = NULL;
+}
+
+void telemetry_write(telemetry_t* t, float power, float peak, float squelch_level, int squelch_open)
+{
+    uint64_t index = t->header->write_index;
+    telemetry_record_t* r = t->records+index%t->header->num_records;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    __atomic_store_n(&r->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->timestamp_ns = (uint64_t)now.tv_sec*1000000000+now.tv_nsec;
+    r->power = power;
+    r->peak = peak;
+    r->squelch_level = squelch_level;
+    r->squelch_open = squelch_open;
+    __atomic_store_n(&r->sequence, index+1, __ATOMIC_RELEASE);
+    __atomic_store_n(&t->header->write_index, index+1, __ATOMIC_RELEASE);
+}
+
+int telemetry_read(telemetry_t* t, telemetry_record_t* record)
+{
+    //Returns 1 if a new record was copied to *record, 0 if there is no new record yet.
+    //Returns -1 if the reader has fallen behind, and some records were lost: it continues with the oldest record available on the next call.
+    uint64_t num_records = t->header->num_records;
+    uint64_t write_index = __atomic_load_n(&t->header->write_index, __ATOMIC_ACQUIRE);
+    if(t->read_index>=write_index) return 0;
+    if(write_index-t->read_index>num_records)
+    {
+        t->read_index = write_index-num_records;
+        return -1;
+    }
+    telemetry_record_t* r = t->records+t->read_index%num_records;
+    uint64_t sequence = __atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE);
+    record->timestamp_ns = r->timestamp_ns;
+    record->power = r->power;
+    record->peak = r->peak;
+    record->squelch_level = r->squelch_level;
+    record->squelch_open = r->squelch_open;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(sequence==t->read_index+1 && __atomic_load_n(&r->sequence, __ATOMIC_RELAXED)==sequence)
+    {
+        record->sequence = sequence;
+        t->read_index++;
+        return 1;
+    }
+    //The writer is overwriting this record meanwhile, so we skip to the oldest record that it won't touch soon.
+    t->read_index = (write_index+1>num_records) ? write_index+1-num_records : write_index;
+    return -1;
+}
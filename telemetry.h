@@ -0,0 +1,74 @@
+/*
+This software is part of libcsdr, a set of simple DSP routines for
+Software Defined Radio.
+
+Copyright (c) 2014, Andras Retzler <randras@sdr.hu>
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL ANDRAS RETZLER BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <stdint.h>
+
+//Binary telemetry (S-meter) side channel.
+//One writer (the DSP process) appends fixed size records to a ring in a memory mapped file (typically in /dev/shm).
+//Any number of readers can map the same file and poll it. The writer never waits for the readers: if a reader is too slow, it loses the oldest records and knows about it.
+//The file starts with telemetry_header_t, followed by num_records times telemetry_record_t. Fields are in host byte order.
+
+#define TELEMETRY_MAGIC 0x6d6c6574 //"telm"
+#define TELEMETRY_VERSION 1
+
+typedef struct telemetry_header_s
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t num_records;
+    uint64_t write_index; //number of records written so far, record n is at n%num_records
+    uint8_t padding[40]; //to 64 bytes, so that the records don't share a cache line with write_index
+} telemetry_header_t;
+
+typedef struct telemetry_record_s
+{
+    uint64_t sequence; //n+1 for record n, 0 while the record is being written
+    uint64_t timestamp_ns; //CLOCK_REALTIME
+    float power; //average power of the last block
+    float peak; //peak power of a single sample since the previous record
+    float squelch_level;
+    int32_t squelch_open;
+} telemetry_record_t;
+
+typedef struct telemetry_s
+{
+    int fd;
+    telemetry_header_t* header;
+    telemetry_record_t* records;
+    uint64_t read_index; //for readers: the next record to read
+} telemetry_t;
+
+int telemetry_create(telemetry_t* t, const char* path, int num_records);
+int telemetry_open(telemetry_t* t, const char* path);
+void telemetry_close(telemetry_t* t);
+void telemetry_write(telemetry_t* t, float power, float peak, float squelch_level, int squelch_open);
+int telemetry_read(telemetry_t* t, telemetry_record_t* record);